@@ -1,6 +1,7 @@
 #ifndef _PLATFROM_FIBERS_FIBER_CONTEXT_H
 #define _PLATFROM_FIBERS_FIBER_CONTEXT_H
 
+#include <stdint.h>
 #include <immintrin.h>
 
 struct FiberContext
@@ -29,8 +30,16 @@ struct FiberContext
     __m128i xmm15;
 
     void *data;
+
+    // Floating point control words. Only the System V switch (FiberContext.S) saves and
+    // loads them, a new context must start with the defaults below.
+    uint32_t mxcsr;
+    uint16_t fpu_control;
 };
 
+constexpr uint32_t FIBER_DEFAULT_MXCSR       = 0x1F80; // all exceptions masked, round to nearest
+constexpr uint16_t FIBER_DEFAULT_FPU_CONTROL = 0x037F;
+
 extern "C" void save_fiber_ctx(FiberContext *ctx);
 extern "C" void restore_fiber_ctx(FiberContext *ctx);
 extern "C" void swap_fiber_ctx(FiberContext *save_ctx, FiberContext *restore_ctx);
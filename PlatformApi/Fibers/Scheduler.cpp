@@ -0,0 +1,2071 @@
+// Included into a unity build after Platform.cpp, which brings in the core types and the
+// OS headers. The context switch is assembled separately: FiberContext.asm (MASM) on
+// Windows, FiberContext.S (GAS) on Linux.
+
+#include "Scheduler.h"
+#include "FiberContext.h"
+
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <emmintrin.h>
+#include <atomic>
+
+#if defined(_WIN32)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#if !defined(_WIN32)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+//----------------------------------------------------------------------------------------------------------//
+// Various Macros
+//----------------------------------------------------------------------------------------------------------//
+
+#if defined(_WIN32)
+#define SCHED_NOINLINE  __declspec(noinline)
+#else
+#define SCHED_NOINLINE  __attribute__((noinline))
+#endif
+
+using spinlock = volatile uint32_t;
+
+static_assert(offsetof(FiberContext, mxcsr) == 8*10 + 16*10 + 8, "FiberContext.S expects mxcsr after data");
+
+constexpr u32 MAX_INJECTED_JOBS = 1024;   // per priority, for threads the scheduler does not own
+constexpr u32 JOB_DEQUE_INITIAL_SIZE = 256; // per worker and priority, grows as needed
+constexpr u32 MAX_WORKER_THREADS = 64;
+
+constexpr u32 MAX_FIBERS = 32768;
+constexpr u32 MAX_READY_FIBERS = MAX_FIBERS; // power of two, not below MAX_FIBERS
+
+static struct Scheduler *scheduler = 0;
+
+//----------------------------------------------------------------------------------------------------------//
+// Synchronization Helpers
+//----------------------------------------------------------------------------------------------------------//
+
+// The counters handed to the public API are plain volatile u32, so the helpers view the
+// memory through std::atomic. A lock-free std::atomic<T> has the size and alignment of T
+// on every compiler we build with.
+template<typename T>
+FORCE_INLINE std::atomic<T>*
+as_atomic(volatile T *ptr)
+{
+    static_assert(sizeof(std::atomic<T>) == sizeof(T), "std::atomic<T> must be layout compatible with T");
+    return (std::atomic<T>*)ptr;
+}
+
+FORCE_INLINE b8 
+compare_and_swap_32(volatile u32 *ptr, u32 comparand, u32 replacement)
+{
+    Assert(ptr);
+    return as_atomic(ptr)->compare_exchange_strong(comparand, replacement);
+}
+
+FORCE_INLINE b8 
+compare_and_swap_64(volatile u64 *ptr, u64 comparand, u64 replacement)
+{
+    return as_atomic(ptr)->compare_exchange_strong(comparand, replacement);
+}
+
+template<typename T>
+FORCE_INLINE b8 
+compare_and_swap_ptr(T *volatile *ptr, T *comparand, T *replacement)
+{
+    return as_atomic(ptr)->compare_exchange_strong(comparand, replacement);
+}
+
+// Increment and decrement return the new value, exchange returns the old one
+FORCE_INLINE u32
+atomic_increment_32(volatile u32 *ptr)
+{
+    return as_atomic(ptr)->fetch_add(1) + 1;
+}
+
+FORCE_INLINE u32
+atomic_decrement_32(volatile u32 *ptr)
+{
+    return as_atomic(ptr)->fetch_sub(1) - 1;
+}
+
+FORCE_INLINE u32
+atomic_exchange_32(volatile u32 *ptr, u32 value)
+{
+    return as_atomic(ptr)->exchange(value);
+}
+
+//----------------------------------------------------------------------------------------------------------//
+// Spinlock
+//----------------------------------------------------------------------------------------------------------//
+
+// NOTE(Dustin): Latency: 140 cycles. Is there a better approach?
+// Maybe spin for a short period before pausing?
+static void 
+spinlock_enter(spinlock *lock)
+{
+    Assert(lock);
+    while (!compare_and_swap_32(lock, 0, 1))
+        _mm_pause();
+}
+
+static void 
+spinlock_leave(spinlock *lock)
+{
+    as_atomic(lock)->store(0, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------------------------------------//
+// Futex
+//----------------------------------------------------------------------------------------------------------//
+
+// sched_futex_wait sleeps while *addr == value, and may return early for no reason.
+#if defined(_WIN32)
+
+#pragma comment(lib, "Synchronization.lib")
+
+static void
+sched_futex_wait(volatile u32 *addr, u32 value)
+{
+    WaitOnAddress(addr, &value, sizeof(value), INFINITE);
+}
+
+static void
+sched_futex_wake(volatile u32 *addr, u32 count)
+{
+    if (count >= MAX_WORKER_THREADS)
+    {
+        WakeByAddressAll((PVOID)addr);
+        return;
+    }
+    for (u32 i = 0; i < count; ++i)
+        WakeByAddressSingle((PVOID)addr);
+}
+
+static u64
+sched_now_ns()
+{
+    static LARGE_INTEGER frequency = {};
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (u64)((r64)counter.QuadPart * (1e9 / (r64)frequency.QuadPart));
+}
+
+#else
+
+static void
+sched_futex_wait(volatile u32 *addr, u32 value)
+{
+    syscall(SYS_futex, (u32*)addr, FUTEX_WAIT_PRIVATE, value, 0, 0, 0);
+}
+
+static void
+sched_futex_wake(volatile u32 *addr, u32 count)
+{
+    syscall(SYS_futex, (u32*)addr, FUTEX_WAKE_PRIVATE, (count > INT_MAX) ? INT_MAX : (int)count, 0, 0, 0);
+}
+
+static u64
+sched_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+#endif
+
+//----------------------------------------------------------------------------------------------------------//
+// Tagged Heap
+//----------------------------------------------------------------------------------------------------------//
+
+// Jobs allocate from 2MB blocks claimed under a tag, each worker bumping through its own
+// block per tag. Nothing is freed on its own: freeing a tag hands every block claimed
+// under it back at once, e.g. at the end of the frame the tag belonged to.
+
+template<u64 size>
+struct BitmapTemplate
+{
+    volatile u64 bitset[size];
+};
+
+constexpr u64 TAGGED_HEAP_MEMORY_SIZE = _1GB;
+constexpr u64 TAGGED_HEAP_BLOCK_SIZE  = _2MB;
+constexpr u32 TAGGED_HEAP_BLOCK_COUNT = TAGGED_HEAP_MEMORY_SIZE / TAGGED_HEAP_BLOCK_SIZE;
+constexpr u32 TAGGED_HEAP_TAG_COUNT   = (u32)SchedulerMemoryTag::Count;
+using Bitmap = BitmapTemplate<TAGGED_HEAP_BLOCK_COUNT / 64>;
+
+static void
+bitmap_init(Bitmap *bitmap)
+{
+    u32 len = ARRAYCOUNT(bitmap->bitset);
+    Assert(len * 64 == TAGGED_HEAP_BLOCK_COUNT);
+    for (u32 i = 0; i < len; ++i)
+        bitmap->bitset[i] = 0;
+}
+
+// Sets the first clear bit, returns its index or -1 when every bit is set
+static i32
+bitmap_acquire(Bitmap *bitmap)
+{
+    for (u32 i = 0; i < ARRAYCOUNT(bitmap->bitset); ++i)
+    {
+        u64 bits = as_atomic(&bitmap->bitset[i])->load(std::memory_order_relaxed);
+        while (bits != ~0ull)
+        {
+            u32 bit = PlatformCtzl(~bits);
+            // On failure bits is reloaded, try again with whatever bit is clear now
+            if (as_atomic(&bitmap->bitset[i])->compare_exchange_weak(bits, bits | (1ull << bit)))
+                return (i32)(i * 64 + bit);
+        }
+    }
+    return -1;
+}
+
+#if defined(_WIN32)
+
+static void*
+tagged_heap_reserve(u64 size)
+{
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+static void
+tagged_heap_commit(void *ptr, u64 size)
+{
+    // Committing a committed range again is fine
+    if (!VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE))
+        LogFatal("Failed to commit a tagged heap block!");
+}
+
+static void
+tagged_heap_release(void *ptr, u64 size)
+{
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+#else
+
+static void*
+tagged_heap_reserve(u64 size)
+{
+    // Pages are backed on first touch, there is nothing left to commit
+    void *ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (ptr == MAP_FAILED) ? 0 : ptr;
+}
+
+static void
+tagged_heap_commit(void *ptr, u64 size)
+{
+}
+
+static void
+tagged_heap_release(void *ptr, u64 size)
+{
+    munmap(ptr, size);
+}
+
+#endif
+
+struct TaggedHeap
+{
+    char        *memory;
+    Bitmap       bitmap;                            // blocks in use
+    Bitmap       tag_blocks[TAGGED_HEAP_TAG_COUNT]; // blocks in use, by tag
+    // Bumped when a tag is freed, a worker's block for the tag is stale after that
+    volatile u32 generations[TAGGED_HEAP_TAG_COUNT];
+};
+
+// A worker's current block for one tag
+struct TaggedHeapCursor
+{
+    char *block;
+    u64   used;
+    u32   generation;
+};
+
+static void
+tagged_heap_init(TaggedHeap *heap)
+{
+    heap->memory = (char*)tagged_heap_reserve(TAGGED_HEAP_MEMORY_SIZE);
+    if (!heap->memory) LogFatal("Failed to reserve the tagged heap!");
+
+    bitmap_init(&heap->bitmap);
+    for (u32 i = 0; i < TAGGED_HEAP_TAG_COUNT; ++i)
+    {
+        bitmap_init(&heap->tag_blocks[i]);
+        heap->generations[i] = 0;
+    }
+}
+
+static void
+tagged_heap_free(TaggedHeap *heap)
+{
+    tagged_heap_release(heap->memory, TAGGED_HEAP_MEMORY_SIZE);
+    heap->memory = 0;
+}
+
+static char*
+tagged_heap_acquire_block(TaggedHeap *heap, u32 tag)
+{
+    i32 index = bitmap_acquire(&heap->bitmap);
+    if (index < 0) return 0;
+
+    as_atomic(&heap->tag_blocks[tag].bitset[index / 64])->fetch_or(1ull << (index % 64));
+
+    char *block = heap->memory + (u64)index * TAGGED_HEAP_BLOCK_SIZE;
+    tagged_heap_commit(block, TAGGED_HEAP_BLOCK_SIZE);
+    return block;
+}
+
+// Hands back every block of the tag, a word of the bitmap at a time
+static void
+tagged_heap_free_tag(TaggedHeap *heap, u32 tag)
+{
+    atomic_increment_32(&heap->generations[tag]);
+    for (u32 i = 0; i < ARRAYCOUNT(heap->bitmap.bitset); ++i)
+    {
+        u64 blocks = as_atomic(&heap->tag_blocks[tag].bitset[i])->exchange(0);
+        if (blocks) as_atomic(&heap->bitmap.bitset[i])->fetch_and(~blocks);
+    }
+}
+
+static void*
+tagged_heap_alloc(TaggedHeap *heap, TaggedHeapCursor *cursor, u32 tag, u64 size, u64 alignment)
+{
+    u32 generation = as_atomic(&heap->generations[tag])->load(std::memory_order_relaxed);
+    if (cursor->generation != generation)
+    {
+        cursor->block      = 0;
+        cursor->generation = generation;
+    }
+
+    if (cursor->block)
+    {
+        u64 offset = (cursor->used + alignment - 1) & ~(alignment - 1);
+        if (offset + size <= TAGGED_HEAP_BLOCK_SIZE)
+        {
+            cursor->used = offset + size;
+            return cursor->block + offset;
+        }
+    }
+
+    // The rest of the old block is wasted until the tag is freed
+    char *block = tagged_heap_acquire_block(heap, tag);
+    if (!block) return 0;
+    cursor->block = block;
+    cursor->used  = size;
+    return block;
+}
+
+//----------------------------------------------------------------------------------------------------------//
+// Stack Allocations
+//----------------------------------------------------------------------------------------------------------//
+
+// Every fiber has its own reservation: a guard page at the bottom, the stack, and the
+// SchedFiber itself at the top. Running off the end of a stack faults on the guard page
+// instead of writing into a neighbour. Memory is only backed once it is touched, so the
+// large classes mostly cost address space.
+constexpr u64 FIBER_STACK_SIZES[FiberStackSize_Count] = { _KB(64), _KB(512), _MB(8) };
+
+#if defined(_WIN32)
+
+static u64
+fiber_page_size()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+}
+
+// Committing only charges the commit limit, pages get memory on first touch
+static void*
+fiber_stack_reserve(u64 size, u64 page_size)
+{
+    char *base = (char*)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (!base) return 0;
+    if (!VirtualAlloc(base + page_size, size - page_size, MEM_COMMIT, PAGE_READWRITE))
+    {
+        VirtualFree(base, 0, MEM_RELEASE);
+        return 0;
+    }
+    return base;
+}
+
+static void
+fiber_stack_release(void *base, u64 size)
+{
+    VirtualFree(base, 0, MEM_RELEASE);
+}
+
+#else
+
+static u64
+fiber_page_size()
+{
+    return (u64)sysconf(_SC_PAGESIZE);
+}
+
+static void*
+fiber_stack_reserve(u64 size, u64 page_size)
+{
+    void *base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED) return 0;
+    if (mprotect(base, page_size, PROT_NONE) != 0)
+    {
+        munmap(base, size);
+        return 0;
+    }
+    return base;
+}
+
+static void
+fiber_stack_release(void *base, u64 size)
+{
+    munmap(base, size);
+}
+
+#endif
+
+//----------------------------------------------------------------------------------------------------------//
+// Job Queue
+//----------------------------------------------------------------------------------------------------------//
+
+/* Bounded multi producer and consumer FIFO queue, after Dmitry Vyukov's
+ * https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ *
+ * Each cell carries a sequence number that says whose turn it is: a producer may fill the
+ * cell when it equals the enqueue position, a consumer may empty it when it equals the
+ * dequeue position + 1. Positions only grow, so a thread preempted for a whole trip
+ * around the ring cannot mistake a reused cell for the one it read before.
+ */
+template<typename T, u32 N>
+struct ConcurrentQueue
+{
+    static_assert((N & (N - 1)) == 0, "Queue size must be a power of two");
+    static constexpr u32 MASK = N - 1;
+
+    struct Cell
+    {
+        volatile u32 sequence;
+        T           *item;
+    };
+
+    Cell                     cells[N];
+    alignas(64) volatile u32 head; // next position to dequeue
+    alignas(64) volatile u32 tail; // next position to enqueue
+};
+
+using JobQueue   = ConcurrentQueue<FiberJob, MAX_INJECTED_JOBS>;
+// Holds every fiber at most once, so it never fills up
+using FiberQueue = ConcurrentQueue<struct SchedFiber, MAX_READY_FIBERS>;
+
+template<typename T, u32 N>
+static void 
+concurrent_queue_init(ConcurrentQueue<T, N> *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+    for (u32 i = 0; i < N; ++i)
+        queue->cells[i].sequence = i;
+}
+
+// A push that claimed a position counts, even before its item is stored
+template<typename T, u32 N>
+FORCE_INLINE b8
+concurrent_queue_is_empty(ConcurrentQueue<T, N> *q)
+{
+    return as_atomic(&q->head)->load() == as_atomic(&q->tail)->load();
+}
+
+// Returns 0 if the queue was full
+template<typename T, u32 N>
+static int 
+concurrent_queue_push(ConcurrentQueue<T, N> *q, T *item)
+{
+    typename ConcurrentQueue<T, N>::Cell *cell;
+    u32 pos = as_atomic(&q->tail)->load(std::memory_order_relaxed);
+    while (1)
+    {
+        cell = &q->cells[pos & q->MASK];
+        u32 seq = as_atomic(&cell->sequence)->load(std::memory_order_acquire);
+        i32 diff = (i32)(seq - pos);
+        if (diff == 0)
+        {
+            if (as_atomic(&q->tail)->compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return 0; // the cell still holds the item from one trip ago
+        }
+        else
+        {
+            pos = as_atomic(&q->tail)->load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->item = item;
+    as_atomic(&cell->sequence)->store(pos + 1, std::memory_order_release);
+    return 1;
+}
+
+// Returns 0 if the queue was empty
+template<typename T, u32 N>
+static int
+concurrent_queue_pop(T **item, ConcurrentQueue<T, N> *q)
+{
+    typename ConcurrentQueue<T, N>::Cell *cell;
+    u32 pos = as_atomic(&q->head)->load(std::memory_order_relaxed);
+    while (1)
+    {
+        cell = &q->cells[pos & q->MASK];
+        u32 seq = as_atomic(&cell->sequence)->load(std::memory_order_acquire);
+        i32 diff = (i32)(seq - (pos + 1));
+        if (diff == 0)
+        {
+            if (as_atomic(&q->head)->compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return 0; // nothing was pushed to the cell yet
+        }
+        else
+        {
+            pos = as_atomic(&q->head)->load(std::memory_order_relaxed);
+        }
+    }
+
+    *item = cell->item;
+    as_atomic(&cell->sequence)->store(pos + N, std::memory_order_release);
+    return 1;
+}
+
+//----------------------------------------------------------------------------------------------------------//
+// Job Deque
+//----------------------------------------------------------------------------------------------------------//
+
+/* Chase-Lev work stealing deque, following "Correct and Efficient Work-Stealing for Weak
+ * Memory Models" (Le et al. 2013). The owning worker pushes and pops at the bottom, so the
+ * jobs it queued last run first while their data is still in its cache. Other workers
+ * steal from the top.
+ *
+ * A push into a full buffer moves the jobs into one twice the size. A thief may still be
+ * reading the old buffer, so replaced buffers are kept until the deque is freed.
+ */
+struct JobDequeBuffer
+{
+    i64              capacity; // power of two
+    JobDequeBuffer  *prev;     // the buffer this one replaced
+    FiberJob *volatile jobs[1];
+};
+
+struct JobDeque
+{
+    // Thieves only touch top, keep it off the owner's cache line
+    alignas(64) volatile i64 top;
+    alignas(64) volatile i64 bottom;
+    JobDequeBuffer *volatile buffer;
+};
+
+static JobDequeBuffer*
+job_deque_buffer_alloc(i64 capacity)
+{
+    JobDequeBuffer *buffer = (JobDequeBuffer*)PlatformAlloc(sizeof(JobDequeBuffer) + sizeof(FiberJob*) * (capacity - 1));
+    buffer->capacity = capacity;
+    buffer->prev = 0;
+    return buffer;
+}
+
+static void
+job_deque_init(JobDeque *deque)
+{
+    deque->top    = 0;
+    deque->bottom = 0;
+    deque->buffer = job_deque_buffer_alloc(JOB_DEQUE_INITIAL_SIZE);
+}
+
+static void
+job_deque_free(JobDeque *deque)
+{
+    JobDequeBuffer *buffer = deque->buffer;
+    while (buffer)
+    {
+        JobDequeBuffer *prev = buffer->prev;
+        PlatformFree(buffer);
+        buffer = prev;
+    }
+    deque->buffer = 0;
+}
+
+// Owner only
+static void
+job_deque_push(JobDeque *deque, FiberJob *job)
+{
+    i64 b = as_atomic(&deque->bottom)->load(std::memory_order_relaxed);
+    i64 t = as_atomic(&deque->top)->load(std::memory_order_acquire);
+    JobDequeBuffer *buffer = as_atomic(&deque->buffer)->load(std::memory_order_relaxed);
+
+    if (b - t >= buffer->capacity)
+    {
+        JobDequeBuffer *grown = job_deque_buffer_alloc(buffer->capacity * 2);
+        for (i64 i = t; i < b; ++i)
+            grown->jobs[i & (grown->capacity - 1)] = buffer->jobs[i & (buffer->capacity - 1)];
+        grown->prev = buffer;
+        as_atomic(&deque->buffer)->store(grown, std::memory_order_release);
+        buffer = grown;
+    }
+
+    as_atomic(&buffer->jobs[b & (buffer->capacity - 1)])->store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    as_atomic(&deque->bottom)->store(b + 1, std::memory_order_relaxed);
+}
+
+// Owner only, takes the newest job
+static FiberJob*
+job_deque_pop(JobDeque *deque)
+{
+    i64 b = as_atomic(&deque->bottom)->load(std::memory_order_relaxed) - 1;
+    JobDequeBuffer *buffer = as_atomic(&deque->buffer)->load(std::memory_order_relaxed);
+    as_atomic(&deque->bottom)->store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 t = as_atomic(&deque->top)->load(std::memory_order_relaxed);
+
+    FiberJob *job = 0;
+    if (t <= b)
+    {
+        job = as_atomic(&buffer->jobs[b & (buffer->capacity - 1)])->load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // Last job, race the thieves for it
+            if (!as_atomic(&deque->top)->compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = 0;
+            as_atomic(&deque->bottom)->store(b + 1, std::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        as_atomic(&deque->bottom)->store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+// Any thread, takes the oldest job
+static FiberJob*
+job_deque_steal(JobDeque *deque)
+{
+    i64 t = as_atomic(&deque->top)->load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 b = as_atomic(&deque->bottom)->load(std::memory_order_acquire);
+    if (t >= b) return 0;
+
+    JobDequeBuffer *buffer = as_atomic(&deque->buffer)->load(std::memory_order_acquire);
+    FiberJob *job = as_atomic(&buffer->jobs[t & (buffer->capacity - 1)])->load(std::memory_order_relaxed);
+    if (!as_atomic(&deque->top)->compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return 0; // lost the race to the owner or another thief
+    return job;
+}
+
+FORCE_INLINE b8
+job_deque_is_empty(JobDeque *deque)
+{
+    return as_atomic(&deque->top)->load() >= as_atomic(&deque->bottom)->load();
+}
+
+//----------------------------------------------------------------------------------------------------------//
+// Fiber
+//----------------------------------------------------------------------------------------------------------//
+
+struct SchedFiber
+{
+    SchedFiber       *next_fiber; // these are for the free list right?
+    SchedFiber       *prev_fiber;
+    SchedFiber       *all_next;   // every fiber created, to release them
+    struct Scheduler *sched;
+    void             *stack_base; // start of the reservation, the guard page
+    FiberStackSize    stack_class;
+    FiberContext      ctx;
+    FiberJob          job;
+    // Job the fiber runs first, when the job needed a larger stack than the worker had
+    FiberJob         *start_job;
+    // Set while the fiber is on wait_counter's waiter list
+    JobCounter       *wait_counter;
+    u32               wait_value;
+    // Set for the fiber standing in for a worker thread's own stack, which only ever
+    // resumes on that thread
+    struct SchedWorker *home_worker;
+};
+
+
+//----------------------------------------------------------------------------------------------------------//
+// Threads
+//----------------------------------------------------------------------------------------------------------//
+
+// Pin each worker to one logical processor, in the order the OS lists the processors this
+// process may run on.
+constexpr b8 SCHED_PIN_WORKERS = true;
+
+#if defined(_WIN32)
+
+using SchedThread = HANDLE;
+
+static u32
+sched_processor_list(u32 *processors, u32 max_count)
+{
+    Win32ProcessorInfo processor_info;
+    Win32GetProcessorInfo(&processor_info);
+
+    u32 count = (processor_info.logical_processor_count < max_count) ? processor_info.logical_processor_count : max_count;
+    for (u32 i = 0; i < count; ++i)
+        processors[i] = i;
+    return count;
+}
+
+static void
+sched_thread_create(SchedThread *thread, LPTHREAD_START_ROUTINE proc, void *arg)
+{
+    *thread = CreateThread(NULL, 0, proc, arg, 0, NULL);
+    if (!*thread) LogFatal("Failed to create a worker thread!");
+}
+
+static void
+sched_thread_join(SchedThread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+static void
+sched_thread_pin(u32 processor)
+{
+    DWORD_PTR ret = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << processor);
+    AssertCustom(ret != 0, "Failed to set a thread's affinity!");
+}
+
+#else
+
+using SchedThread = pthread_t;
+
+static u32
+sched_processor_list(u32 *processors, u32 max_count)
+{
+    u32 count = 0;
+
+    // Respects taskset and container cpusets, unlike the online processor count
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (u32 cpu = 0; cpu < CPU_SETSIZE && count < max_count; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set)) processors[count++] = cpu;
+        }
+    }
+
+    if (count == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        count = (online > 0 && (u32)online < max_count) ? (u32)online : ((online > 0) ? max_count : 1);
+        for (u32 i = 0; i < count; ++i)
+            processors[i] = i;
+    }
+
+    return count;
+}
+
+static void
+sched_thread_create(SchedThread *thread, void *(*proc)(void*), void *arg)
+{
+    if (pthread_create(thread, 0, proc, arg) != 0)
+        LogFatal("Failed to create a worker thread!");
+}
+
+static void
+sched_thread_join(SchedThread thread)
+{
+    pthread_join(thread, 0);
+}
+
+static void
+sched_thread_pin(u32 processor)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(processor, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        LogWarn("Failed to pin a worker to processor %d", processor);
+}
+
+#endif
+
+//----------------------------------------------------------------------------------------------------------//
+// Profiler
+//----------------------------------------------------------------------------------------------------------//
+
+// Every worker records into its own ring, which keeps the newest events once it wraps.
+// Outside of scheduler_profile_begin/end a hook is a load and a branch, building with
+// SCHED_PROFILE 0 removes the hooks.
+#ifndef SCHED_PROFILE
+#define SCHED_PROFILE 1
+#endif
+
+constexpr u32 SCHED_PROFILE_EVENTS = 1 << 16; // per worker, power of two
+
+enum SchedEventType : u32
+{
+    SchedEvent_JobBegin,  // data is the job's callback
+    SchedEvent_JobEnd,
+    SchedEvent_Suspend,   // the job awaits a counter, its fiber leaves the worker
+    SchedEvent_Resume,    // data is the job's callback
+    SchedEvent_Steal,     // data is the index of the worker the job was taken from
+    SchedEvent_Park,
+    SchedEvent_Unpark,
+    SchedEvent_Switch,    // the work loop hands the worker to another fiber, data is the fiber
+};
+
+struct SchedEvent
+{
+    u64 tsc;   // rdtsc
+    u64 data;
+    u32 type;
+};
+
+struct SchedEventRing
+{
+    SchedEvent *events;
+    u64         head;   // events recorded since scheduler_profile_begin
+};
+
+FORCE_INLINE void
+sched_profile_record(SchedEventRing *ring, u32 type, u64 data)
+{
+    SchedEvent *event = &ring->events[ring->head & (SCHED_PROFILE_EVENTS - 1)];
+    event->tsc  = __rdtsc();
+    event->data = data;
+    event->type = type;
+    ++ring->head;
+}
+
+#if SCHED_PROFILE
+#define SCHED_PROFILE_EVENT(worker, type, data)                                                        \
+    do {                                                                                               \
+        if (as_atomic(&(worker)->scheduler->profile_recording)->load(std::memory_order_acquire))       \
+            sched_profile_record(&(worker)->profile, (type), (u64)(data));                             \
+    } while (0)
+#else
+#define SCHED_PROFILE_EVENT(worker, type, data)
+#endif
+
+//----------------------------------------------------------------------------------------------------------//
+// Scheduler
+//----------------------------------------------------------------------------------------------------------//
+
+struct SchedWorker
+{
+    u32          tindex;       // index into thread pool
+    u32          processor;    // logical processor the thread is pinned to
+    SchedThread  handle;       // thread handle, unset for the thread that called scheduler_init
+    b8           spawned;      // false for the thread that called scheduler_init
+    SchedFiber  *active_fiber; // Active fiber, home_fiber while the thread runs on its own stack
+    Scheduler   *scheduler;    // Back ptr to scheduler
+
+    // The thread's own stack. Spawned workers only go back to it to exit, the thread that
+    // called scheduler_init awaits on it like any other fiber. Once its counter is reached,
+    // home_ready is set instead of pushing it on the ready queue.
+    SchedFiber    home_fiber;
+    volatile u32  home_ready;
+
+    // The context a switch leaves is only saved once the switch is done, so whatever runs
+    // next on the thread hands the fiber over to the wait or free list
+    SchedFiber  *switch_wait;
+    SchedFiber  *switch_free;
+
+    // Jobs queued by this worker, one deque per priority
+    JobDeque     deques[SchedulerPriority_Count];
+    u32          steal_seed;   // picks the first victim to steal from
+
+    // Pauses before parking, grows when spinning finds work and shrinks when it does not
+    u32          spin_limit;
+    // Only written by the worker's own thread
+    SchedulerStats stats;
+
+    // Where this worker's tagged allocations go next
+    TaggedHeapCursor heap_cursors[TAGGED_HEAP_TAG_COUNT];
+
+    SchedEventRing profile;
+};
+
+// An eventcount: a worker that runs out of work registers as a sleeper and reads the epoch,
+// looks for work one last time, then sleeps on the epoch. Submitters bump the epoch when
+// anyone sleeps, so a worker that read the epoch before the bump does not go to sleep.
+struct SchedParking
+{
+    volatile u32 epoch;
+    volatile u32 sleepers;
+    volatile u64 wake_ns;  // when the last wake was issued
+};
+
+struct Scheduler
+{
+    volatile u32 active;
+
+    // Jobs submitted by threads that are not workers, one queue per priority
+    JobQueue     injectors[SchedulerPriority_Count];
+    // Fibers whose counter was reached, they run before any new job is picked up
+    FiberQueue   ready_fibers;
+    
+    SchedParking parking;  // Idle workers sleep here
+    volatile u32 active_threads;
+    u32          thread_count;
+    SchedWorker  workers[MAX_WORKER_THREADS];
+
+    // Fibers are created as they are needed and go back to the free list of their stack
+    // class once they are done
+    volatile u32 fiber_count;
+    volatile u32 free_list_lock;
+    SchedFiber  *free_lists[FiberStackSize_Count];
+    SchedFiber  *all_fibers;
+    u64          page_size;
+
+    TaggedHeap   tagged_heap;
+
+    // Set by scheduler_profile_begin once every worker has a ring
+    volatile u32 profile_recording;
+    u64          profile_begin_tsc;
+    u64          profile_begin_ns;
+};
+
+static thread_local SchedWorker *tls_sched_worker = 0;
+
+// Never inlined: a fiber that awaited can resume on another thread, and must not keep
+// using a thread local address computed before the switch
+static SCHED_NOINLINE SchedWorker* 
+get_sched_worker()
+{
+    return tls_sched_worker;
+}
+
+// Wakes up to count parked workers, call after publishing the work they should pick up
+static void
+sched_wake_workers(Scheduler *sched, u32 count)
+{
+    SchedParking *parking = &sched->parking;
+
+    // Orders the publish before reading sleepers, sched_idle does the opposite
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    u32 sleepers = as_atomic(&parking->sleepers)->load(std::memory_order_relaxed);
+    if (sleepers == 0) return;
+
+    parking->wake_ns = sched_now_ns();
+    atomic_increment_32(&parking->epoch);
+    sched_futex_wake(&parking->epoch, (count < sleepers) ? count : sleepers);
+}
+
+FORCE_INLINE b8
+sched_has_work(SchedWorker *worker)
+{
+    Scheduler *sched = worker->scheduler;
+    if (worker->spawned ? !sched->active : worker->home_ready) return true;
+    if (!concurrent_queue_is_empty(&sched->ready_fibers)) return true;
+    for (u32 i = 0; i < SchedulerPriority_Count; ++i)
+    {
+        if (!concurrent_queue_is_empty(&sched->injectors[i])) return true;
+    }
+    for (u32 w = 0; w < sched->thread_count; ++w)
+    {
+        for (u32 i = 0; i < SchedulerPriority_Count; ++i)
+        {
+            if (!job_deque_is_empty(&sched->workers[w].deques[i])) return true;
+        }
+    }
+    return false;
+}
+
+constexpr u32 MIN_SPIN_COUNT = 64;
+constexpr u32 MAX_SPIN_COUNT = 4096;
+
+// Called when the worker found nothing to do. Spins for a while in case work shows up
+// soon, then sleeps until a submitter wakes it.
+static void
+sched_idle(SchedWorker *worker)
+{
+    Scheduler *sched = worker->scheduler;
+    SchedParking *parking = &sched->parking;
+
+    // Thread Sleep Loop 
+    // https://software.intel.com/content/www/us/en/develop/articles/benefitting-power-and-performance-sleep-loops.html
+    u64 spin_start = sched_now_ns();
+    for (u32 i = 0; i < worker->spin_limit; ++i)
+    {
+        _mm_pause();
+        if (sched_has_work(worker))
+        {
+            worker->stats.spin_ns += sched_now_ns() - spin_start;
+            if (worker->spin_limit < MAX_SPIN_COUNT) worker->spin_limit <<= 1;
+            return;
+        }
+    }
+    worker->stats.spin_ns += sched_now_ns() - spin_start;
+    if (worker->spin_limit > MIN_SPIN_COUNT) worker->spin_limit >>= 1;
+
+    atomic_increment_32(&parking->sleepers);
+    u32 epoch = as_atomic(&parking->epoch)->load();
+    if (!sched_has_work(worker))
+    {
+        ++worker->stats.park_count;
+        SCHED_PROFILE_EVENT(worker, SchedEvent_Park, 0);
+        sched_futex_wait(&parking->epoch, epoch);
+        SCHED_PROFILE_EVENT(worker, SchedEvent_Unpark, 0);
+        if (as_atomic(&parking->epoch)->load() != epoch)
+        {
+            u64 latency = sched_now_ns() - parking->wake_ns;
+            ++worker->stats.wake_count;
+            worker->stats.wake_latency_ns += latency;
+            if (latency > worker->stats.wake_latency_max_ns) worker->stats.wake_latency_max_ns = latency;
+        }
+    }
+    atomic_decrement_32(&parking->sleepers);
+}
+
+static void 
+sched_add_to_list(SchedFiber **list, SchedFiber *fiber, spinlock *lock)
+{
+    Assert(lock);
+    spinlock_enter(lock);
+    
+    if (!*list)
+    {
+        *list = fiber;
+        fiber->prev_fiber = 0;
+        fiber->next_fiber = 0;
+    }
+    else
+    {
+        fiber->prev_fiber = 0;
+        fiber->next_fiber = *list;
+        (*list)->prev_fiber = fiber;
+        *list = fiber;
+    }
+    
+    spinlock_leave(lock);
+}
+
+static void 
+sched_remove_from_list(SchedFiber **list, SchedFiber *fiber, spinlock *lock)
+{
+    if (lock) spinlock_enter(lock);
+
+    if (fiber->next_fiber)
+        fiber->next_fiber->prev_fiber = fiber->prev_fiber;
+    if (fiber->prev_fiber)
+        fiber->prev_fiber->next_fiber = fiber->next_fiber;
+    if (*list == fiber)
+        *list = fiber->next_fiber;
+
+    fiber->next_fiber = 0;
+    fiber->prev_fiber = 0;
+
+    if (lock) spinlock_leave(lock);
+}
+
+static SchedFiber* 
+sched_wake_fiber(Scheduler *sched)
+{
+    SchedFiber *fiber = 0;
+    concurrent_queue_pop(&fiber, &sched->ready_fibers);
+    return fiber;
+}
+
+static void
+sched_ready_fiber(Scheduler *sched, SchedFiber *fiber)
+{
+    fiber->wait_counter = 0;
+    if (fiber->home_worker)
+    {
+        // Sleepers share one futex, so the home worker cannot be woken on its own
+        atomic_exchange_32(&fiber->home_worker->home_ready, 1);
+        sched_wake_workers(sched, MAX_WORKER_THREADS);
+    }
+    else
+    {
+        int pushed = concurrent_queue_push(&sched->ready_fibers, fiber);
+        AssertCustom(pushed, "Ready fiber queue is full!");
+        sched_wake_workers(sched, 1);
+    }
+}
+
+// Waiters are added and the value is decremented under the counter lock, so a decrement
+// either sees the new waiter or the waiter sees the decremented value. Fibers are only
+// ever made ready once, by whoever holds the counter lock.
+static void
+sched_counter_add_waiter(Scheduler *sched, SchedFiber *fiber)
+{
+    JobCounter *counter = fiber->wait_counter;
+
+    spinlock_enter(&counter->lock);
+    fiber->next_fiber = counter->waiters;
+    as_atomic(&counter->waiters)->store(fiber);
+    b8 reached = (as_atomic(&counter->value)->load() == fiber->wait_value);
+    if (reached) as_atomic(&counter->waiters)->store(fiber->next_fiber);
+    spinlock_leave(&counter->lock);
+
+    if (reached) sched_ready_fiber(sched, fiber);
+}
+
+static void
+sched_counter_decrement(Scheduler *sched, JobCounter *counter)
+{
+    // The decrement may release the last awaiter, which is then free to return and drop
+    // the counter. The counter is not touched once the lock is released.
+    SchedFiber *ready = 0;
+    spinlock_enter(&counter->lock);
+    u32 value = atomic_decrement_32(&counter->value);
+    SchedFiber *keep = 0;
+    SchedFiber *iter = counter->waiters;
+    while (iter)
+    {
+        SchedFiber *next = iter->next_fiber;
+        SchedFiber **list = (iter->wait_value == value) ? &ready : &keep;
+        iter->next_fiber = *list;
+        *list = iter;
+        iter = next;
+    }
+    as_atomic(&counter->waiters)->store(keep);
+    spinlock_leave(&counter->lock);
+
+    while (ready)
+    {
+        SchedFiber *next = ready->next_fiber;
+        ready->next_fiber = 0;
+        sched_ready_fiber(sched, ready);
+        ready = next;
+    }
+}
+
+static void sched_fiber_work_proc();
+
+static void 
+fiber_stack_reset(SchedFiber *fiber)
+{
+    // The stack starts right below the fiber
+    char *iter = (char*)fiber;
+    iter = (char*)((uptr)iter & -16L);
+    AssertCustom(((uptr)iter % 16L) == 0, "Allocated stack should be aligned to 16L");
+    // Make 128 byte scratch space for the Red Zone. This arithmetic will not unalign
+    // our stack pointer because 128 is a multiple of 16. The Red Zone must also be
+    // 16-byte aligned.
+    iter -= 128;
+    // Functions are entered with rsp + 8 aligned, as if a call had just pushed the
+    // return address
+    iter -= sizeof(void*);
+
+    memset(&fiber->ctx, 0, sizeof(fiber->ctx));
+    fiber->ctx.rsp         = iter;
+    fiber->ctx.rip         = (void*)sched_fiber_work_proc;
+    fiber->ctx.mxcsr       = FIBER_DEFAULT_MXCSR;
+    fiber->ctx.fpu_control = FIBER_DEFAULT_FPU_CONTROL;
+}
+
+static SchedFiber*
+sched_create_fiber(Scheduler *sched, FiberStackSize stack_class)
+{
+    u32 count = atomic_increment_32(&sched->fiber_count);
+    AssertCustom(count <= MAX_FIBERS, "Ran out of fibers!");
+
+    u64 size = FIBER_STACK_SIZES[stack_class];
+    char *base = (char*)fiber_stack_reserve(size, sched->page_size);
+    if (!base) LogFatal("Failed to reserve a fiber stack!");
+
+    SchedFiber *fiber = (SchedFiber*)((uptr)(base + size - sizeof(SchedFiber)) & ~(uptr)63);
+    memset(fiber, 0, sizeof(SchedFiber));
+    fiber->stack_base  = base;
+    fiber->stack_class = stack_class;
+
+    spinlock_enter(&sched->free_list_lock);
+    fiber->all_next = sched->all_fibers;
+    sched->all_fibers = fiber;
+    spinlock_leave(&sched->free_list_lock);
+    return fiber;
+}
+
+// Returns a fiber that starts on the work loop when switched to
+static SchedFiber*
+sched_get_fiber(Scheduler *sched, FiberStackSize stack_class = FiberStackSize_Small)
+{
+    AssertCustom(stack_class < FiberStackSize_Count, "Invalid stack size. Possible values {Small (0), Medium (1), Large (2)}");
+
+    // Fibers on the free list already own a stack
+    SchedFiber *result = 0;
+    spinlock_enter(&sched->free_list_lock);
+    if (sched->free_lists[stack_class])
+    {
+        result = sched->free_lists[stack_class];
+        sched_remove_from_list(&sched->free_lists[stack_class], result, 0);
+    }
+    spinlock_leave(&sched->free_list_lock);
+    if (!result) result = sched_create_fiber(sched, stack_class);
+
+    result->sched = sched;
+    fiber_stack_reset(result);
+    return result;
+}
+
+// Runs first on whatever context a switch lands on
+static void
+sched_finish_switch(SchedWorker *worker)
+{
+    Scheduler *sched = worker->scheduler;
+    if (worker->switch_wait)
+    {
+        sched_counter_add_waiter(sched, worker->switch_wait);
+        worker->switch_wait = 0;
+    }
+    if (worker->switch_free)
+    {
+        SchedFiber *fiber = worker->switch_free;
+        sched_add_to_list(&sched->free_lists[fiber->stack_class], fiber, &sched->free_list_lock);
+        worker->switch_free = 0;
+    }
+}
+
+// Higher priorities first. Within a priority the worker's own jobs come first, then
+// the injected ones, then jobs stolen from the other workers starting at a random one.
+static FiberJob*
+sched_get_job(SchedWorker *worker)
+{
+    Scheduler *sched = worker->scheduler;
+    u32 count = sched->thread_count;
+
+    // xorshift32
+    u32 seed = worker->steal_seed;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    worker->steal_seed = seed;
+
+    FiberJob *job = 0;
+    for (u32 p = 0; p < SchedulerPriority_Count; ++p)
+    {
+        if ((job = job_deque_pop(&worker->deques[p])) != 0) return job;
+        if (concurrent_queue_pop(&job, &sched->injectors[p])) return job;
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            SchedWorker *victim = &sched->workers[(seed + i) % count];
+            if (victim == worker) continue;
+            if ((job = job_deque_steal(&victim->deques[p])) != 0)
+            {
+                SCHED_PROFILE_EVENT(worker, SchedEvent_Steal, victim->tindex);
+                return job;
+            }
+        }
+    }
+    return 0;
+}
+
+static void
+sched_run_job(Scheduler *sched, SchedFiber *fiber, FiberJob *job)
+{
+    Assert(job->callback);
+    JobCounter *job_count = job->job_count;
+    fiber->job = *job;
+    SCHED_PROFILE_EVENT(get_sched_worker(), SchedEvent_JobBegin, job->callback);
+    job->callback(sched, job->data);
+    // The job may have awaited and moved to another worker
+    SCHED_PROFILE_EVENT(get_sched_worker(), SchedEvent_JobEnd, 0);
+    fiber->job.callback = 0; // no longer in a job, scheduler_await goes by it
+    if (job_count) sched_counter_decrement(sched, job_count);
+}
+
+// Every fiber starts here. A fiber leaves the loop for good when it hands its worker to a
+// woken fiber or to the thread's own stack, and is reused from the free list after that.
+static void 
+sched_fiber_work_proc()
+{
+    SchedWorker *start_worker = get_sched_worker();
+    sched_finish_switch(start_worker);
+
+    SchedFiber *self = start_worker->active_fiber;
+    if (self->start_job)
+    {
+        FiberJob *job = self->start_job;
+        self->start_job = 0;
+        sched_run_job(start_worker->scheduler, self, job);
+    }
+
+    while (1)
+    {
+        // The previous job may have awaited and resumed this fiber on another thread
+        SchedWorker *worker = get_sched_worker();
+        Scheduler   *sched  = worker->scheduler;
+        SchedFiber  *fiber  = worker->active_fiber;
+
+        b8 go_home = (worker->spawned) ? !sched->active : worker->home_ready;
+        if (go_home)
+        {
+            worker->home_ready   = 0;
+            worker->switch_free  = fiber;
+            worker->active_fiber = &worker->home_fiber;
+            swap_fiber_ctx(&fiber->ctx, &worker->home_fiber.ctx);
+        }
+
+        fiber = sched_wake_fiber(sched);
+        if (fiber)
+        {
+            SCHED_PROFILE_EVENT(worker, SchedEvent_Switch, fiber);
+            worker->switch_free  = worker->active_fiber;
+            worker->active_fiber = fiber;
+            
+            Assert(fiber->ctx.rip);
+            swap_fiber_ctx(&worker->switch_free->ctx, &fiber->ctx);
+        }
+
+        FiberJob *job = sched_get_job(worker);
+        if (!job)
+        {
+            sched_idle(worker);
+            continue;
+        }
+
+        fiber = worker->active_fiber;
+        if (job->stack_size > fiber->stack_class)
+        {
+            // Hand the job to a fiber with a deep enough stack, this one goes back to the pool
+            SchedFiber *next = sched_get_fiber(sched, job->stack_size);
+            next->start_job = job;
+            SCHED_PROFILE_EVENT(worker, SchedEvent_Switch, next);
+
+            worker->switch_free  = fiber;
+            worker->active_fiber = next;
+            swap_fiber_ctx(&fiber->ctx, &next->ctx);
+        }
+
+        sched_run_job(sched, fiber, job);
+    }
+}
+
+static void
+sched_thread_entry(SchedWorker *worker)
+{
+    tls_sched_worker = worker;
+    if (SCHED_PIN_WORKERS) sched_thread_pin(worker->processor);
+
+    Scheduler *sched = worker->scheduler;
+    atomic_increment_32(&sched->active_threads);
+
+    // The work loop runs on fibers, the thread's own stack only waits for shutdown
+    worker->active_fiber = sched_get_fiber(sched);
+    swap_fiber_ctx(&worker->home_fiber.ctx, &worker->active_fiber->ctx);
+    sched_finish_switch(worker);
+
+    atomic_decrement_32(&sched->active_threads);
+}
+
+#if defined(_WIN32)
+DWORD WINAPI 
+sched_thread_proc(_In_ LPVOID lpParameter)
+{
+    sched_thread_entry((SchedWorker*)lpParameter);
+    return 0;
+}
+#else
+static void*
+sched_thread_proc(void *arg)
+{
+    sched_thread_entry((SchedWorker*)arg);
+    return 0;
+}
+#endif
+
+void
+scheduler_init(Scheduler **_scheduler)
+{
+    scheduler = (Scheduler*)malloc(sizeof(Scheduler));
+    memset(scheduler, 0, sizeof(Scheduler));
+    scheduler->free_list_lock = 0;
+    scheduler->active_threads = 0;
+    scheduler->page_size = fiber_page_size();
+    tagged_heap_init(&scheduler->tagged_heap);
+
+    for (u32 i = 0; i < SchedulerPriority_Count; ++i)
+    {
+        concurrent_queue_init(scheduler->injectors + i);
+    }
+    concurrent_queue_init(&scheduler->ready_fibers);
+
+    atomic_exchange_32(&scheduler->active, 1);
+
+    u32 processors[MAX_WORKER_THREADS];
+    u32 thread_count = sched_processor_list(processors, MAX_WORKER_THREADS);
+    scheduler->thread_count = thread_count;
+
+    // Every worker is set up before the first thread starts reading them
+    for (u32 i = 0; i < thread_count; ++i)
+    {
+        SchedWorker *worker = scheduler->workers + i;
+        worker->tindex       = i;
+        worker->processor    = processors[i];
+        worker->spawned      = (i < thread_count - 1);
+        worker->active_fiber = &worker->home_fiber;
+        worker->scheduler    = scheduler;
+        worker->spin_limit   = MAX_SPIN_COUNT;
+        worker->steal_seed   = 0x9E3779B9u * (i + 1);
+        for (u32 p = 0; p < SchedulerPriority_Count; ++p)
+            job_deque_init(&worker->deques[p]);
+        worker->home_fiber.sched       = scheduler;
+        worker->home_fiber.home_worker = worker;
+    }
+
+    // Initialize the main thread as a worker thread. It runs jobs while it is waiting in
+    // scheduler_await, and only ever resumes on this thread.
+    SchedWorker *main_worker = scheduler->workers + thread_count - 1;
+    tls_sched_worker = main_worker;
+    if (SCHED_PIN_WORKERS) sched_thread_pin(main_worker->processor);
+
+    for (u32 i = 0; i < thread_count - 1; ++i)
+    {
+        sched_thread_create(&scheduler->workers[i].handle, sched_thread_proc, scheduler->workers + i);
+    }
+
+    LogInfo("Fiber scheduler: %d workers", thread_count);
+    if (_scheduler) *_scheduler = scheduler;
+}
+
+void 
+scheduler_free(Scheduler **_scheduler)
+{
+    Scheduler *sched = scheduler;
+
+    // Disallow picking up new jobs. Each worker finishes the job it is running and exits
+    // from its own stack, fibers still waiting are dropped.
+    atomic_exchange_32(&sched->active, 0);
+    sched_wake_workers(sched, MAX_WORKER_THREADS);
+    for (u32 i = 0; i < sched->thread_count - 1; ++i)
+    {
+        sched_thread_join(sched->workers[i].handle);
+    }
+
+    for (u32 i = 0; i < sched->thread_count; ++i)
+    {
+        for (u32 p = 0; p < SchedulerPriority_Count; ++p)
+            job_deque_free(&sched->workers[i].deques[p]);
+    }
+    SchedFiber *fiber = sched->all_fibers;
+    while (fiber)
+    {
+        SchedFiber *next = fiber->all_next;
+        fiber_stack_release(fiber->stack_base, FIBER_STACK_SIZES[fiber->stack_class]);
+        fiber = next;
+    }
+    tagged_heap_free(&sched->tagged_heap);
+    for (u32 i = 0; i < sched->thread_count; ++i)
+    {
+        if (sched->workers[i].profile.events) PlatformFree(sched->workers[i].profile.events);
+    }
+
+    tls_sched_worker = 0;
+    free(sched);
+    scheduler = 0;
+    if (_scheduler) *_scheduler = 0;
+}
+
+void
+scheduler_get_stats(Scheduler *_scheduler, SchedulerStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (u32 i = 0; i < scheduler->thread_count; ++i)
+    {
+        SchedulerStats *w = &scheduler->workers[i].stats;
+        stats->spin_ns         += w->spin_ns;
+        stats->park_count      += w->park_count;
+        stats->wake_count      += w->wake_count;
+        stats->wake_latency_ns += w->wake_latency_ns;
+        if (w->wake_latency_max_ns > stats->wake_latency_max_ns) stats->wake_latency_max_ns = w->wake_latency_max_ns;
+    }
+}
+
+void
+scheduler_profile_begin(Scheduler *_scheduler)
+{
+    for (u32 i = 0; i < scheduler->thread_count; ++i)
+    {
+        SchedEventRing *ring = &scheduler->workers[i].profile;
+        if (!ring->events) ring->events = (SchedEvent*)PlatformAlloc(sizeof(SchedEvent) * SCHED_PROFILE_EVENTS);
+        ring->head = 0;
+    }
+
+    scheduler->profile_begin_ns  = sched_now_ns();
+    scheduler->profile_begin_tsc = __rdtsc();
+    as_atomic(&scheduler->profile_recording)->store(1, std::memory_order_release);
+}
+
+// Longest line a single event turns into, the trace buffer is sized up front
+constexpr u32 SCHED_TRACE_LINE_SIZE = 160;
+
+bool
+scheduler_profile_end(Scheduler *_scheduler, const char *file_path)
+{
+    as_atomic(&scheduler->profile_recording)->store(0);
+
+    // rdtsc runs at a fixed rate that is not known up front, measure it over the recording
+    u64 elapsed_tsc = __rdtsc() - scheduler->profile_begin_tsc;
+    u64 elapsed_ns  = sched_now_ns() - scheduler->profile_begin_ns;
+    r64 us_per_tick = (elapsed_tsc > 0) ? ((r64)elapsed_ns / 1000.0) / (r64)elapsed_tsc : 0.0;
+
+    u64 capacity = 64 + (u64)scheduler->thread_count * SCHED_TRACE_LINE_SIZE;
+    for (u32 w = 0; w < scheduler->thread_count; ++w)
+    {
+        u64 head = scheduler->workers[w].profile.head;
+        capacity += ((head < SCHED_PROFILE_EVENTS) ? head : SCHED_PROFILE_EVENTS) * SCHED_TRACE_LINE_SIZE;
+    }
+    char *trace = (char*)PlatformAlloc(capacity);
+    u64 size = 0;
+
+#define SCHED_TRACE(...) size += (u64)snprintf(trace + size, capacity - size, __VA_ARGS__)
+
+    SCHED_TRACE("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (u32 w = 0; w < scheduler->thread_count; ++w)
+    {
+        SchedWorker *worker = &scheduler->workers[w];
+        if (worker->spawned) SCHED_TRACE("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}", w ? ",\n" : "", w, w);
+        else                 SCHED_TRACE("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"main\"}}", w ? ",\n" : "", w);
+        if (!worker->profile.events) continue;
+
+        // A wrapped ring lost the oldest events, ends of spans whose start is gone are dropped
+        u64 head  = worker->profile.head;
+        u64 start = (head > SCHED_PROFILE_EVENTS) ? head - SCHED_PROFILE_EVENTS : 0;
+        u32 depth = 0;
+        for (u64 e = start; e < head; ++e)
+        {
+            SchedEvent *event = &worker->profile.events[e & (SCHED_PROFILE_EVENTS - 1)];
+            r64 ts = (r64)(i64)(event->tsc - scheduler->profile_begin_tsc) * us_per_tick;
+
+            switch (event->type)
+            {
+                case SchedEvent_JobBegin:
+                case SchedEvent_Resume:
+                {
+                    ++depth;
+                    SCHED_TRACE(",\n{\"name\":\"job 0x%llx\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":0,\"tid\":%u}",
+                                (unsigned long long)event->data, ts, w);
+                } break;
+
+                case SchedEvent_Park:
+                {
+                    ++depth;
+                    SCHED_TRACE(",\n{\"name\":\"parked\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":0,\"tid\":%u}", ts, w);
+                } break;
+
+                case SchedEvent_JobEnd:
+                case SchedEvent_Suspend:
+                case SchedEvent_Unpark:
+                {
+                    if (depth == 0) break;
+                    --depth;
+                    SCHED_TRACE(",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,\"tid\":%u}", ts, w);
+                } break;
+
+                case SchedEvent_Steal:
+                {
+                    SCHED_TRACE(",\n{\"name\":\"steal\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"victim\":%llu}}",
+                                ts, w, (unsigned long long)event->data);
+                } break;
+
+                case SchedEvent_Switch:
+                {
+                    SCHED_TRACE(",\n{\"name\":\"switch\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"fiber\":\"0x%llx\"}}",
+                                ts, w, (unsigned long long)event->data);
+                } break;
+            }
+        }
+    }
+    SCHED_TRACE("\n]}\n");
+
+#undef SCHED_TRACE
+
+    PlatformErrorType err = PlatformWriteBufferToFile(file_path, (u8*)trace, size);
+    PlatformFree(trace);
+    return err == PlatformError_Success;
+}
+
+void*
+scheduler_tagged_alloc(Scheduler *_scheduler, SchedulerMemoryTag tag, uint64_t size, uint64_t alignment)
+{
+    AssertCustom(tag < SchedulerMemoryTag::Count, "Invalid memory tag!");
+    AssertCustom(size <= TAGGED_HEAP_BLOCK_SIZE, "Tagged allocations must fit in a 2MB block!");
+    AssertCustom(alignment && (alignment & (alignment - 1)) == 0, "Alignment must be a power of two!");
+
+    SchedWorker *worker = get_sched_worker();
+    AssertCustom(worker, "scheduler_tagged_alloc called from a thread the scheduler does not own!");
+
+    u32 t = (u32)tag;
+    void *result = tagged_heap_alloc(&scheduler->tagged_heap, &worker->heap_cursors[t], t, size, alignment);
+    AssertCustom(result, "Tagged heap is out of blocks!");
+    return result;
+}
+
+void
+scheduler_tagged_free(Scheduler *_scheduler, SchedulerMemoryTag tag)
+{
+    AssertCustom(tag < SchedulerMemoryTag::Count, "Invalid memory tag!");
+    tagged_heap_free_tag(&scheduler->tagged_heap, (u32)tag);
+}
+
+void 
+scheduler_run_jobs(
+    Scheduler            *_scheduler, 
+    SchedulerPriority     priority, 
+    FiberJob             *jobs, 
+    int                   jobs_count, 
+    JobCounter           *counter) 
+{
+    AssertCustom(priority < SchedulerPriority_Count, "Invalid priority. Possible priority values {Low (0), Normal (1), High (2)}");
+
+    SchedWorker *worker = get_sched_worker();
+    if (worker)
+    {
+        // The worker's own deque grows, it never turns a job away
+        JobDeque *deque = &worker->deques[priority];
+        for (int i = 0; i < jobs_count; ++i)
+        {
+            jobs[i].job_count = counter;
+            job_deque_push(deque, jobs + i);
+        }
+    }
+    else
+    {
+        // Another thread, the injector is bounded. While it is full the submitter waits for
+        // the workers to drain it.
+        JobQueue *queue = &scheduler->injectors[priority];
+        for (int i = 0; i < jobs_count; ++i)
+        {
+            jobs[i].job_count = counter;
+            while (!concurrent_queue_push(queue, jobs + i))
+            {
+                sched_wake_workers(scheduler, scheduler->thread_count);
+                _mm_pause();
+            }
+        }
+    }
+    sched_wake_workers(scheduler, (u32)jobs_count);
+}
+
+// Allows a fiber to sleep until the counter reaches the expected value. When the fiber wakens,
+// it runs before any job that is still queued.
+// Counters often live on the awaiter's stack, so it only returns once the decrement that
+// released it let go of the counter lock.
+void scheduler_await(Scheduler *_sched, JobCounter *counter, uint32_t expected_value)
+{
+    if (counter->value == expected_value)
+    {
+        spinlock_enter(&counter->lock);
+        spinlock_leave(&counter->lock);
+        return;
+    }
+
+    SchedWorker *worker = get_sched_worker();
+    AssertCustom(worker, "scheduler_await called from a thread the scheduler does not own!");
+    Scheduler *sched = worker->scheduler;
+
+    // Hand the worker to a fiber that is ready, or to a new one on the work loop
+    SchedFiber *next = sched_wake_fiber(sched);
+    if (!next) next = sched_get_fiber(sched);
+
+    // Outside of a job this is the thread's own stack, which is only resumed by this
+    // thread's work loop
+    SchedFiber *old = worker->active_fiber;
+    old->wait_value   = expected_value;
+    old->wait_counter = counter;
+
+    // Outside of a job only the wait shows up, as the work loop running other jobs
+    job_callback in_job = old->job.callback;
+    if (in_job) SCHED_PROFILE_EVENT(worker, SchedEvent_Suspend, in_job);
+
+    worker->switch_wait  = old;
+    worker->active_fiber = next;
+    swap_fiber_ctx(&old->ctx, &next->ctx);
+
+    // Resumed, possibly on another worker
+    worker = get_sched_worker();
+    sched_finish_switch(worker);
+    spinlock_enter(&counter->lock);
+    spinlock_leave(&counter->lock);
+    if (in_job) SCHED_PROFILE_EVENT(worker, SchedEvent_Resume, in_job);
+}
+
+//----------------------------------------------------------------------------------------------------------//
+// Job Graph
+//----------------------------------------------------------------------------------------------------------//
+
+template<typename T>
+static void
+job_graph_grow(T **items, u32 count, u32 *capacity)
+{
+    if (count < *capacity) return;
+
+    u32 grown = (*capacity) ? *capacity * 2 : 16;
+    T *result = (T*)PlatformAlloc(sizeof(T) * grown);
+    if (*items)
+    {
+        memcpy(result, *items, sizeof(T) * count);
+        PlatformFree(*items);
+    }
+    *items = result;
+    *capacity = grown;
+}
+
+void
+job_graph_init(JobGraph *graph)
+{
+    memset(graph, 0, sizeof(*graph));
+    job_counter_init(&graph->done, 0);
+}
+
+void
+job_graph_free(JobGraph *graph)
+{
+    AssertCustom(graph->done.value == 0, "Job graph is still running!");
+    if (graph->nodes)      PlatformFree(graph->nodes);
+    if (graph->edges)      PlatformFree(graph->edges);
+    if (graph->successors) PlatformFree(graph->successors);
+    if (graph->roots)      PlatformFree(graph->roots);
+    memset(graph, 0, sizeof(*graph));
+}
+
+uint32_t
+job_graph_add_node(JobGraph *graph, FiberJob job)
+{
+    AssertCustom(graph->done.value == 0, "Job graph is still running!");
+    job_graph_grow(&graph->nodes, graph->nodes_count, &graph->nodes_capacity);
+
+    JobGraphNode *node = &graph->nodes[graph->nodes_count];
+    memset(node, 0, sizeof(*node));
+    node->job = job;
+    graph->dirty = true;
+    return graph->nodes_count++;
+}
+
+void
+job_graph_add_edge(JobGraph *graph, uint32_t before, uint32_t after)
+{
+    AssertCustom(graph->done.value == 0, "Job graph is still running!");
+    AssertCustom(before < graph->nodes_count && after < graph->nodes_count && before != after, "Invalid job graph edge!");
+    job_graph_grow(&graph->edges, graph->edges_count, &graph->edges_capacity);
+
+    graph->edges[graph->edges_count++] = { before, after };
+    graph->dirty = true;
+}
+
+// Sorts the edges into per node successor ranges and finds the roots
+static void
+job_graph_compile(JobGraph *graph)
+{
+    u32 needed = (graph->edges_count > graph->nodes_count) ? graph->edges_count : graph->nodes_count;
+    if (needed > graph->compiled_capacity)
+    {
+        if (graph->successors) PlatformFree(graph->successors);
+        if (graph->roots)      PlatformFree(graph->roots);
+        graph->successors = (u32*)PlatformAlloc(sizeof(u32) * needed);
+        graph->roots      = (u32*)PlatformAlloc(sizeof(u32) * needed);
+        graph->compiled_capacity = needed;
+    }
+
+    for (u32 i = 0; i < graph->nodes_count; ++i)
+    {
+        graph->nodes[i].successor_count   = 0;
+        graph->nodes[i].predecessor_count = 0;
+    }
+    for (u32 i = 0; i < graph->edges_count; ++i)
+    {
+        ++graph->nodes[graph->edges[i].before].successor_count;
+        ++graph->nodes[graph->edges[i].after].predecessor_count;
+    }
+
+    u32 offset = 0;
+    graph->roots_count = 0;
+    for (u32 i = 0; i < graph->nodes_count; ++i)
+    {
+        JobGraphNode *node = &graph->nodes[i];
+        node->first_successor = offset;
+        offset += node->successor_count;
+        node->successor_count = 0; // counts back up while the edges are placed
+        if (node->predecessor_count == 0) graph->roots[graph->roots_count++] = i;
+    }
+    for (u32 i = 0; i < graph->edges_count; ++i)
+    {
+        JobGraphNode *node = &graph->nodes[graph->edges[i].before];
+        graph->successors[node->first_successor + node->successor_count++] = graph->edges[i].after;
+    }
+
+#ifndef NDEBUG
+    // Release the nodes in order from the roots, a node on a cycle is never released and
+    // would keep the graph from ever finishing
+    u32 *order = (u32*)PlatformAlloc(sizeof(u32) * graph->nodes_count);
+    memcpy(order, graph->roots, sizeof(u32) * graph->roots_count);
+    for (u32 i = 0; i < graph->nodes_count; ++i)
+        graph->nodes[i].pending = graph->nodes[i].predecessor_count;
+
+    u32 released = graph->roots_count;
+    for (u32 i = 0; i < released; ++i)
+    {
+        JobGraphNode *node = &graph->nodes[order[i]];
+        for (u32 s = 0; s < node->successor_count; ++s)
+        {
+            u32 next = graph->successors[node->first_successor + s];
+            if (--graph->nodes[next].pending == 0) order[released++] = next;
+        }
+    }
+    PlatformFree(order);
+    AssertCustom(released == graph->nodes_count, "Job graph has a cycle!");
+#endif
+
+    graph->dirty = false;
+}
+
+JOB_ENTRY(job_graph_node_proc)
+{
+    JobGraphNode *node = (JobGraphNode*)arg;
+    JobGraph *graph = node->graph;
+
+    node->start_ns = sched_now_ns();
+    node->job.callback(sched, node->job.data);
+    node->end_ns = sched_now_ns();
+
+    for (u32 i = 0; i < node->successor_count; ++i)
+    {
+        JobGraphNode *next = &graph->nodes[graph->successors[node->first_successor + i]];
+        if (atomic_decrement_32(&next->pending) == 0)
+            scheduler_run_jobs(sched, graph->priority, &next->run_job, 1, &graph->done);
+    }
+}
+
+void
+scheduler_run_graph(Scheduler *_scheduler, JobGraph *graph, SchedulerPriority priority)
+{
+    AssertCustom(graph->done.value == 0, "Job graph is still running!");
+    if (graph->nodes_count == 0) return;
+    if (graph->dirty) job_graph_compile(graph);
+
+    graph->priority     = priority;
+    graph->run_start_ns = sched_now_ns();
+    job_counter_init(&graph->done, graph->nodes_count);
+
+    for (u32 i = 0; i < graph->nodes_count; ++i)
+    {
+        JobGraphNode *node = &graph->nodes[i];
+        node->pending  = node->predecessor_count;
+        node->graph    = graph;
+        node->start_ns = 0;
+        node->end_ns   = 0;
+
+        node->run_job.data       = node;
+        node->run_job.callback   = job_graph_node_proc;
+        node->run_job.stack_size = node->job.stack_size;
+    }
+
+    for (u32 i = 0; i < graph->roots_count; ++i)
+    {
+        JobGraphNode *node = &graph->nodes[graph->roots[i]];
+        scheduler_run_jobs(scheduler, priority, &node->run_job, 1, &graph->done);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------//
+// Parallel For
+//----------------------------------------------------------------------------------------------------------//
+
+constexpr u32 PARALLEL_CHUNKS_PER_WORKER = 32; // chunks of an automatic grain
+constexpr u32 PARALLEL_TASKS_PER_WORKER  = 64; // once out of tasks, ranges stop splitting
+
+struct ParallelTask
+{
+    struct ParallelLoop *loop;
+    u64                  first;  // where the range started, orders the partial results
+    u64                  begin;
+    u64                  end;    // shrinks as halves are split off
+    void                *partial;
+    FiberJob             job;
+};
+
+struct ParallelLoop
+{
+    SchedulerPriority priority;
+    u64               grain;
+    range_callback    range;
+    reduce_callback   reduce;
+    void             *arg;
+    void             *identity;
+    u64               partial_size;
+
+    ParallelTask     *tasks;
+    volatile u32      tasks_count;
+    u32               tasks_capacity;
+    JobCounter        counter;
+};
+
+static ParallelTask*
+parallel_acquire_task(ParallelLoop *loop)
+{
+    // May go past the capacity, the tasks that did not fit are never touched
+    if (as_atomic(&loop->tasks_count)->load(std::memory_order_relaxed) >= loop->tasks_capacity) return 0;
+    u32 index = atomic_increment_32(&loop->tasks_count) - 1;
+    if (index >= loop->tasks_capacity) return 0;
+
+    ParallelTask *task = &loop->tasks[index];
+    task->loop = loop;
+    if (loop->reduce) memcpy(task->partial, loop->identity, loop->partial_size);
+    return task;
+}
+
+FORCE_INLINE void
+parallel_run_range(Scheduler *sched, ParallelTask *task, u64 begin, u64 end)
+{
+    ParallelLoop *loop = task->loop;
+    if (loop->reduce) loop->reduce(sched, loop->arg, begin, end, task->partial);
+    else              loop->range(sched, loop->arg, begin, end);
+}
+
+JOB_ENTRY(parallel_task_proc);
+
+// Lazy binary splitting: an empty deque means the split off half would likely be stolen
+// right away, anything else means the workers are busy and the range runs a chunk locally
+static void
+parallel_run_task(Scheduler *sched, ParallelTask *task)
+{
+    ParallelLoop *loop = task->loop;
+    while (task->end - task->begin > loop->grain)
+    {
+        // The callback may await, the task can resume on another worker
+        SchedWorker  *worker = get_sched_worker();
+        ParallelTask *half   = 0;
+        if (job_deque_is_empty(&worker->deques[loop->priority])) half = parallel_acquire_task(loop);
+
+        if (half)
+        {
+            u64 mid = task->begin + (task->end - task->begin) / 2;
+            half->first = mid;
+            half->begin = mid;
+            half->end   = task->end;
+            task->end   = mid;
+
+            half->job.data       = half;
+            half->job.callback   = parallel_task_proc;
+            half->job.stack_size = FiberStackSize_Small;
+            atomic_increment_32(&loop->counter.value);
+            scheduler_run_jobs(sched, loop->priority, &half->job, 1, &loop->counter);
+        }
+        else
+        {
+            parallel_run_range(sched, task, task->begin, task->begin + loop->grain);
+            task->begin += loop->grain;
+        }
+    }
+
+    if (task->begin < task->end) parallel_run_range(sched, task, task->begin, task->end);
+}
+
+JOB_ENTRY(parallel_task_proc)
+{
+    parallel_run_task(sched, (ParallelTask*)arg);
+}
+
+static int
+parallel_task_compare(const void *a, const void *b)
+{
+    u64 first_a = ((ParallelTask*)a)->first;
+    u64 first_b = ((ParallelTask*)b)->first;
+    return (first_a < first_b) ? -1 : (first_a > first_b);
+}
+
+static void
+parallel_loop(ParallelLoop *loop, u64 begin, u64 end, u64 grain, void *result, join_callback join)
+{
+    AssertCustom(get_sched_worker(), "Parallel loops must run on a thread the scheduler owns!");
+    AssertCustom(loop->priority < SchedulerPriority_Count, "Invalid priority. Possible priority values {Low (0), Normal (1), High (2)}");
+    if (begin >= end) return;
+
+    u64 count = end - begin;
+    if (grain == 0) grain = count / ((u64)scheduler->thread_count * PARALLEL_CHUNKS_PER_WORKER);
+    if (grain == 0) grain = 1;
+    loop->grain = grain;
+
+    // Every task keeps at least half a grain of the range
+    u64 half_grain = (grain + 1) / 2;
+    u64 max_tasks  = count / half_grain + 1;
+    u64 capacity   = (u64)scheduler->thread_count * PARALLEL_TASKS_PER_WORKER;
+    loop->tasks_capacity = (u32)((max_tasks < capacity) ? max_tasks : capacity);
+
+    // The partials follow the tasks, both their start and their size are kept 16 byte aligned
+    u64 partial_size   = (loop->partial_size + 15) & ~15ull;
+    u64 partials_start = (sizeof(ParallelTask) * loop->tasks_capacity + 15) & ~15ull;
+    u8 *memory = (u8*)PlatformAlloc(partials_start + partial_size * loop->tasks_capacity);
+    loop->tasks = (ParallelTask*)memory;
+    for (u32 i = 0; i < loop->tasks_capacity; ++i)
+        loop->tasks[i].partial = memory + partials_start + partial_size * i;
+    loop->tasks_count = 0;
+    job_counter_init(&loop->counter, 0);
+
+    // The calling fiber takes the whole range and splits from there
+    ParallelTask *root = parallel_acquire_task(loop);
+    root->first = begin;
+    root->begin = begin;
+    root->end   = end;
+    parallel_run_task(scheduler, root);
+    scheduler_await(scheduler, &loop->counter, 0);
+
+    if (loop->reduce)
+    {
+        u32 tasks_count = (loop->tasks_count < loop->tasks_capacity) ? loop->tasks_count : loop->tasks_capacity;
+        qsort(loop->tasks, tasks_count, sizeof(ParallelTask), parallel_task_compare);
+        for (u32 i = 0; i < tasks_count; ++i)
+            join(loop->arg, result, loop->tasks[i].partial);
+    }
+
+    PlatformFree(memory);
+}
+
+void
+scheduler_parallel_for(
+    Scheduler        *_scheduler, 
+    SchedulerPriority priority, 
+    uint64_t          begin, 
+    uint64_t          end, 
+    uint64_t          grain, 
+    range_callback    callback, 
+    void             *arg)
+{
+    ParallelLoop loop = {};
+    loop.priority = priority;
+    loop.range    = callback;
+    loop.arg      = arg;
+    parallel_loop(&loop, begin, end, grain, 0, 0);
+}
+
+void
+scheduler_parallel_reduce(
+    Scheduler        *_scheduler, 
+    SchedulerPriority priority, 
+    uint64_t          begin, 
+    uint64_t          end, 
+    uint64_t          grain, 
+    void             *result, 
+    uint64_t          result_size,
+    reduce_callback   reduce, 
+    join_callback     join, 
+    void             *arg)
+{
+    ParallelLoop loop = {};
+    loop.priority     = priority;
+    loop.reduce       = reduce;
+    loop.arg          = arg;
+    loop.identity     = result;
+    loop.partial_size = result_size;
+    parallel_loop(&loop, begin, end, grain, result, join);
+}
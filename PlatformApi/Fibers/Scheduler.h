@@ -0,0 +1,202 @@
+#ifndef _FIBERS_SCHEDULER_H
+#define _FIBERS_SCHEDULER_H
+
+#include <stdint.h>
+
+typedef void (*job_callback)(struct Scheduler *sched, void *arg);
+#define JOB_ENTRY(fn) static void fn(struct Scheduler *sched, void *arg)
+
+// A counter keeps the fibers awaiting it, the decrement that reaches a fiber's expected
+// value makes it ready. Initialize with job_counter_init, the rest belongs to the scheduler.
+struct JobCounter
+{
+    volatile uint32_t           value;
+    volatile uint32_t           lock;
+    struct SchedFiber *volatile waiters;
+};
+
+inline void
+job_counter_init(JobCounter *counter, uint32_t value)
+{
+    counter->value   = value;
+    counter->lock    = 0;
+    counter->waiters = 0;
+}
+
+// Stack a job runs on. Only the pages a job touches get memory, the larger classes mostly
+// cost address space. A fiber that overflows its stack faults on a guard page.
+enum FiberStackSize
+{
+    FiberStackSize_Small,  // 64KB
+    FiberStackSize_Medium, // 512KB
+    FiberStackSize_Large,  // 8MB
+
+    FiberStackSize_Count,
+};
+
+struct FiberJob
+{
+    void              *data;
+    job_callback       callback;
+    // Useful for batching jobs together. 
+    // For example:
+    //   Let's say I wanted to batch 50 jobs together and sleep the
+    //   fiber until all 50 jobs are complete. job_count is set to job
+    //   for all jobs, and each job will do an atomic decrement when completed
+    //   The fiber will wake up (rescheduled) when job_count == 0 
+    JobCounter        *job_count;
+    FiberStackSize     stack_size;
+};
+enum SchedulerPriority 
+{
+    SchedulerPriority_High,
+    SchedulerPriority_Normal,
+    SchedulerPriority_Low,
+
+    SchedulerPriority_Count,
+    SchedulerPriority_Unknown = SchedulerPriority_Count,
+};
+
+enum class SchedulerMemoryTag : uint8_t
+{
+    Game,
+    Render,
+    GPU,
+    IO,
+
+    Count,
+    Unknown = Count,
+};
+
+// Summed over the workers. Idle workers spin for a while, then park until jobs are submitted.
+struct SchedulerStats
+{
+    uint64_t spin_ns;             // spent spinning for work before finding some or parking
+    uint64_t park_count;          // times a worker went to sleep
+    uint64_t wake_count;          // times a parked worker was woken for new work
+    uint64_t wake_latency_ns;     // summed over wake_count, from the submitter's wake to the worker running
+    uint64_t wake_latency_max_ns;
+};
+
+// Spawns a worker per logical processor but one, the calling thread is the last worker and
+// runs jobs while it waits in scheduler_await.
+void scheduler_init(struct Scheduler **scheduler);
+// Call from the thread that called scheduler_init, outside of any job.
+void scheduler_free(struct Scheduler **scheduler);
+// counter is not touched here, initialize it to the number of jobs to wait on before the call.
+// Jobs queued from inside the scheduler go to the calling worker's deque, which grows as
+// needed. Other threads block while the bounded queue for their priority is full.
+void scheduler_run_jobs(struct Scheduler *scheduler, SchedulerPriority priority, FiberJob *jobs, int jobs_count, JobCounter *counter);
+// Counters are updated by the workers as they go, read them while the scheduler is quiet
+// for exact numbers.
+void scheduler_get_stats(struct Scheduler *scheduler, SchedulerStats *stats);
+// Records job begin and end, steals, parking and fiber switches into a ring per worker. A
+// ring keeps its newest events once it wraps.
+void scheduler_profile_begin(struct Scheduler *scheduler);
+// Stops recording and writes the rings as a Chrome trace, for chrome://tracing or
+// ui.perfetto.dev. Call while no job runs. Returns false if the file could not be written.
+bool scheduler_profile_end(struct Scheduler *scheduler, const char *file_path);
+// Memory that lives until its tag is freed, for example for one frame. Allocations come out
+// of 2MB blocks owned by the calling worker, so they take no lock and are never freed on
+// their own. size may be at most 2MB. Only call from jobs or the thread that called
+// scheduler_init.
+void* scheduler_tagged_alloc(struct Scheduler *scheduler, SchedulerMemoryTag tag, uint64_t size, uint64_t alignment = 16);
+// Hands back every block allocated under the tag. No job may still use or allocate
+// memory of the tag.
+void scheduler_tagged_free(struct Scheduler *scheduler, SchedulerMemoryTag tag);
+// Allows a fiber to sleep until the counter reaches the expected value. When the fiber wakens,
+// it runs before any job that is still queued.
+void scheduler_await(struct Scheduler *scheduler, JobCounter *counter, uint32_t expected_value);
+
+//----------------------------------------------------------------------------------------------------------//
+// Job Graph
+//----------------------------------------------------------------------------------------------------------//
+
+// Jobs with ordering constraints between them. A node is queued once the last of its
+// predecessors finished, so running a graph never parks a fiber on the way. A graph is
+// built once and run every frame, only the first run after a change allocates.
+
+struct JobGraphNode
+{
+    FiberJob           job;               // job_count is not used, the graph tracks completion
+    uint32_t           first_successor;   // into JobGraph::successors
+    uint32_t           successor_count;
+    uint32_t           predecessor_count;
+    volatile uint32_t  pending;           // predecessors still to finish in this run
+    struct JobGraph   *graph;
+    FiberJob           run_job;           // what the scheduler queues for this node
+
+    // When the node's job started and finished in the last run, in nanoseconds
+    uint64_t           start_ns;
+    uint64_t           end_ns;
+};
+
+struct JobGraphEdge
+{
+    uint32_t before;
+    uint32_t after;
+};
+
+struct JobGraph
+{
+    JobGraphNode     *nodes;
+    uint32_t          nodes_count;
+    uint32_t          nodes_capacity;
+    JobGraphEdge     *edges;
+    uint32_t          edges_count;
+    uint32_t          edges_capacity;
+
+    // Built from the edges by the first run after the graph changed
+    uint32_t         *successors;
+    uint32_t         *roots;
+    uint32_t          roots_count;
+    uint32_t          compiled_capacity;
+    bool              dirty;
+
+    SchedulerPriority priority;
+    uint64_t          run_start_ns;
+    // Reaches 0 once every node of the run finished, await it with scheduler_await
+    JobCounter        done;
+};
+
+void     job_graph_init(JobGraph *graph);
+void     job_graph_free(JobGraph *graph);
+// Returns the node's index, nodes and edges may only be added while the graph is not running
+uint32_t job_graph_add_node(JobGraph *graph, FiberJob job);
+void     job_graph_add_edge(JobGraph *graph, uint32_t before, uint32_t after);
+// Queues the nodes without predecessors and returns, the rest follow as they become ready
+void     scheduler_run_graph(struct Scheduler *scheduler, JobGraph *graph, SchedulerPriority priority);
+
+//----------------------------------------------------------------------------------------------------------//
+// Parallel For
+//----------------------------------------------------------------------------------------------------------//
+
+// Runs the callback over subranges of [begin, end). A task splits its range in half only
+// when the worker's own deque is empty, the half it keeps runs in grain sized chunks while
+// the other half waits to be stolen. Idle workers steal large halves and busy ones split
+// rarely. A grain of 0 picks one from the range and the number of workers.
+
+typedef void (*range_callback)(struct Scheduler *sched, void *arg, uint64_t begin, uint64_t end);
+#define RANGE_ENTRY(fn) static void fn(struct Scheduler *sched, void *arg, uint64_t begin, uint64_t end)
+
+// Accumulates [begin, end) into partial, which starts out as a copy of the identity
+typedef void (*reduce_callback)(struct Scheduler *sched, void *arg, uint64_t begin, uint64_t end, void *partial);
+#define REDUCE_ENTRY(fn) static void fn(struct Scheduler *sched, void *arg, uint64_t begin, uint64_t end, void *partial)
+
+// Folds partial into result. Partials are joined in the order of their ranges, so the
+// operation only needs to be associative.
+typedef void (*join_callback)(void *arg, void *result, const void *partial);
+#define JOIN_ENTRY(fn) static void fn(void *arg, void *result, const void *partial)
+
+// Returns once the whole range ran, the calling fiber works on the range meanwhile. Only
+// call from jobs or the thread that called scheduler_init.
+void scheduler_parallel_for(struct Scheduler *scheduler, SchedulerPriority priority, 
+                            uint64_t begin, uint64_t end, uint64_t grain, 
+                            range_callback callback, void *arg);
+// result holds the identity on the way in and the reduced value on the way out.
+void scheduler_parallel_reduce(struct Scheduler *scheduler, SchedulerPriority priority, 
+                               uint64_t begin, uint64_t end, uint64_t grain, 
+                               void *result, uint64_t result_size,
+                               reduce_callback reduce, join_callback join, void *arg);
+
+#endif // _FIBERS_SCHEDULER_H
\ No newline at end of file
@@ -18,11 +18,14 @@
 #include <unistd.h>
 #include <signal.h>
 #include <ucontext.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "X11/X11Logger.c"
 #include "X11/X11Window.c"
 #include "X11/X11CoreUtils.c"
 #include "X11/X11File.c"
+#include "X11/X11JobSystem.c"
 #include "X11/X11OpenGL.c"
 #include "X11/X11Main.c"
 
@@ -16,6 +16,10 @@ void PlatformGetWindowDims(u32 *width, u32 *height);
 // Threading API 
 
 void PlatformAsyncTask(void (*fn)(void*), void *args);
+// Queues count tasks at once, task i receives (u8*)args + i * stride
+void PlatformAsyncTaskBatch(void (*fn)(void*), void *args, u64 stride, u32 count);
+// Runs queued tasks on the calling thread until *counter reaches zero
+void PlatformAwaitCounter(volatile u32 *counter);
 void PlatformAtomicInc(volatile u32*);
 void PlatformAtomicDec(volatile u32*);
 
@@ -0,0 +1,118 @@
+// Submits more tasks than the Win32 thread pool's queue holds, from the main thread and from
+// inside pool tasks, and checks that every task ran. A dropped task would leave its counter
+// above zero and hang the test. Standalone, it only pulls in the thread pool:
+//
+//   cl /nologo /O2 Win32ThreadPoolTest.cpp
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int8_t   b8;
+typedef int32_t  i32;
+typedef uint8_t  u8;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#define file_internal static
+#define file_global   static
+
+#define SysAlloc(size) malloc(size)
+#define SysFree(ptr)   free(ptr)
+#define Assert(x)      do { if (!(x)) { fprintf(stderr, "Assert failed: %s\n", #x); abort(); } } while (0)
+#define LogError(...)  (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#define LogWarn(...)   (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+
+#include "../Win32/Win32ThreadPool.cpp"
+
+#define TEST_THREADS    4
+#define TEST_QUEUE_SIZE 16   // far below every batch below
+#define TEST_TASKS      4096
+#define TEST_PARENTS    256
+#define TEST_LEAVES     64
+
+file_global Win32ThreadPool *g_pool = 0;
+file_global volatile LONG    g_ran  = 0;
+
+struct TestTask
+{
+    volatile LONG *counter;
+};
+
+struct TestParent
+{
+    volatile LONG *counter;
+    volatile LONG  inner;
+    TestTask       leaves[TEST_LEAVES];
+};
+
+file_internal void test_await(volatile LONG *counter)
+{
+    while (*counter != 0)
+    {
+        if (!Win32ThreadPoolTryRunTask(g_pool)) YieldProcessor();
+    }
+}
+
+file_internal void test_leaf(void *arg)
+{
+    TestTask *task = (TestTask*)arg;
+    InterlockedIncrement(&g_ran);
+    InterlockedDecrement(task->counter);
+}
+
+// Fills the queue from a worker, which then has to make room itself
+file_internal void test_parent(void *arg)
+{
+    TestParent *parent = (TestParent*)arg;
+    parent->inner = TEST_LEAVES;
+    for (u32 i = 0; i < TEST_LEAVES; ++i) parent->leaves[i].counter = &parent->inner;
+
+    Win32ThreadQueueTaskBatch(g_pool, test_leaf, parent->leaves, sizeof(TestTask), TEST_LEAVES);
+    test_await(&parent->inner);
+    InterlockedDecrement(parent->counter);
+}
+
+file_internal b8 test_check(const char *name, LONG expected)
+{
+    b8 ok = (g_ran == expected);
+    printf("%-24s %s (%ld of %ld tasks ran)\n", name, ok ? "ok" : "FAILED", (long)g_ran, (long)expected);
+    g_ran = 0;
+    return ok;
+}
+
+int main()
+{
+    Win32ThreadPoolInit(&g_pool, TEST_THREADS, TEST_QUEUE_SIZE);
+    if (!g_pool) return 1;
+
+    static TestTask   tasks[TEST_TASKS];
+    static TestParent parents[TEST_PARENTS];
+    volatile LONG counter;
+    b8 ok = true;
+
+    // One batch far larger than the queue
+    counter = TEST_TASKS;
+    for (u32 i = 0; i < TEST_TASKS; ++i) tasks[i].counter = &counter;
+    Win32ThreadQueueTaskBatch(g_pool, test_leaf, tasks, sizeof(TestTask), TEST_TASKS);
+    test_await(&counter);
+    ok &= test_check("batch", TEST_TASKS);
+
+    // The same through single submissions
+    counter = TEST_TASKS;
+    for (u32 i = 0; i < TEST_TASKS; ++i) Win32ThreadQueueTask(g_pool, test_leaf, &tasks[i]);
+    test_await(&counter);
+    ok &= test_check("single", TEST_TASKS);
+
+    // Batches submitted by tasks while the queue is already full
+    counter = TEST_PARENTS;
+    for (u32 i = 0; i < TEST_PARENTS; ++i) parents[i].counter = &counter;
+    Win32ThreadQueueTaskBatch(g_pool, test_parent, parents, sizeof(TestParent), TEST_PARENTS);
+    test_await(&counter);
+    ok &= test_check("nested batch", TEST_PARENTS * TEST_LEAVES);
+
+    Win32ThreadPoolFree(&g_pool);
+    return ok ? 0 : 1;
+}
@@ -28,6 +28,25 @@ PlatformAsyncTask(void (*fn)(void*), void *args)
     Win32ThreadQueueTask(g_thread_pool, fn, args);
 }
 
+void 
+PlatformAsyncTaskBatch(void (*fn)(void*), void *args, u64 stride, u32 count)
+{
+    Win32ThreadQueueTaskBatch(g_thread_pool, fn, args, stride, count);
+}
+
+void 
+PlatformAwaitCounter(volatile u32 *counter)
+{
+    // Help drain the queue rather than spinning on the counter
+    while (*counter != 0)
+    {
+        if (!Win32ThreadPoolTryRunTask(g_thread_pool))
+        {
+            YieldProcessor();
+        }
+    }
+}
+
 void 
 Win32ResizeCallback(u32 width, u32 height)
 {
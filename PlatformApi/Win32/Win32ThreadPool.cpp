@@ -25,6 +25,8 @@ struct Win32ThreadPool
 file_internal void Win32ThreadPoolInit(Win32ThreadPool **result, i32 thread_count, i32 queue_max);
 file_internal void Win32ThreadPoolFree(Win32ThreadPool **pool);
 file_internal void Win32ThreadQueueTask(Win32ThreadPool *pool, void (*fn)(void*), void *arg);
+file_internal void Win32ThreadQueueTaskBatch(Win32ThreadPool *pool, void (*fn)(void*), void *args, u64 stride, u32 count);
+file_internal bool Win32ThreadPoolTryRunTask(Win32ThreadPool *pool);
 file_internal DWORD WINAPI Win32ThreadPoolThread(LPVOID lp_param); 
 
 file_internal void Win32ThreadPoolInit(Win32ThreadPool **result, i32 thread_count, i32 queue_max)
@@ -137,40 +139,76 @@ file_internal void Win32ThreadPoolFree(Win32ThreadPool **pool)
 
 file_internal void Win32ThreadQueueTask(Win32ThreadPool *pool, void (*fn)(void*), void *arg)
 {
-    if (!pool || !fn) 
-    {
-        return;
-    }
-    
-    i32 next;
-    
-    EnterCriticalSection(&pool->cs_lock);
-    
-    next = (pool->tail + 1) % pool->queue_size;
+    Win32ThreadQueueTaskBatch(pool, fn, arg, 0, 1);
+}
+
+// Callers wait on a counter the tasks decrement, so a task is never dropped. While the
+// queue is full the calling thread runs the oldest queued task to make room, and once the
+// pool shuts down, or without a pool, the tasks run right here.
+file_internal void Win32ThreadQueueTaskBatch(Win32ThreadPool *pool, void (*fn)(void*), void *args, u64 stride, u32 count)
+{
+    Assert(fn);
+    u8 *arg = (u8*)args;
     
-    do {
-        if (pool->count == pool->queue_size) 
+    u32 i = 0;
+    while (i < count)
+    {
+        b8 shutdown = true;
+        if (pool)
         {
-            LogWarn("Win32ThreadPool::AddTask::Attempting to add tasks to Thread Pool work list, but pool is full!");
-            break;
+            // Take the lock and wake the workers once for as much of the batch as fits
+            EnterCriticalSection(&pool->cs_lock);
+            
+            shutdown = pool->shutdown;
+            u32 queued = 0;
+            while (!shutdown && i < count && pool->count < pool->queue_size)
+            {
+                pool->tasks[pool->tail].fn = fn;
+                pool->tasks[pool->tail].arg = arg + i * stride;
+                pool->tail = (pool->tail + 1) % pool->queue_size;
+                pool->count++;
+                ++queued;
+                ++i;
+            }
+            
+            if (queued > 0) WakeAllConditionVariable(&pool->notify);
+            LeaveCriticalSection(&pool->cs_lock);
         }
         
-        if (pool->shutdown)
+        if (i == count) break;
+        
+        if (shutdown)
         {
-            LogWarn("Win32ThreadPool::AddTask::Cannot add task after Pool has been shutdown");
-            break;
+            (*fn)(arg + i * stride);
+            ++i;
         }
-        
-        pool->tasks[pool->tail].fn = fn;
-        pool->tasks[pool->tail].arg = arg;
-        pool->tail = next;
-        pool->count++;
-        
-        WakeAllConditionVariable(&pool->notify);
-        
-    } while(0);
+        else if (!Win32ThreadPoolTryRunTask(pool))
+        {
+            // The workers emptied the queue in the meantime, go around and fill it
+            YieldProcessor();
+        }
+    }
+}
+
+// Runs one queued task on the calling thread. Returns false if the queue was empty.
+file_internal bool Win32ThreadPoolTryRunTask(Win32ThreadPool *pool)
+{
+    Win32ThreadPoolTask task;
+    bool found = false;
     
+    EnterCriticalSection(&pool->cs_lock);
+    if (pool->count > 0)
+    {
+        task.fn = pool->tasks[pool->head].fn;
+        task.arg = pool->tasks[pool->head].arg;
+        pool->head = (pool->head + 1) % pool->queue_size;
+        pool->count--;
+        found = true;
+    }
     LeaveCriticalSection(&pool->cs_lock);
+    
+    if (found) (*(task.fn))(task.arg);
+    return found;
 }
 
 file_internal DWORD WINAPI Win32ThreadPoolThread(LPVOID lp_param)
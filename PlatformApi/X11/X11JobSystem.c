@@ -0,0 +1,501 @@
+// Work-stealing job system. Every worker owns a Chase-Lev deque: the owner pushes and
+// pops at the bottom without taking a lock, idle workers steal from the top of a random
+// victim. Threads outside the pool submit through a small locked injection queue.
+// Workers that run out of work spin for a short while, then park on a condition
+// variable until something new is submitted.
+
+// A build that includes the JobProfiler (the Raytracer) gets its hooks, everyone else
+// compiles them out
+#ifdef _JOB_PROFILER_H
+#define X11_JOB_NAME_THREAD(name) job_profiler_name_thread(name)
+#else
+#define JOB_PROFILE(type, data)
+#define X11_JOB_NAME_THREAD(name)
+#endif
+
+#define X11_JOB_DEQUE_SIZE  4096 // jobs per worker deque, must be a power of two
+#define X11_JOB_INJECT_SIZE 512  // initial injection queue size, grows as needed
+#define X11_JOB_SPIN_COUNT  128  // failed attempts to find work before a worker parks
+
+typedef struct
+{
+    void (*fn)(void*);
+    void  *arg;
+} X11Job;
+
+typedef struct
+{
+    // Thieves only touch top, keep it off the owner's cache line
+    volatile i64 top    __attribute__((aligned(64)));
+    volatile i64 bottom __attribute__((aligned(64)));
+    X11Job      *jobs;
+} X11JobDeque;
+
+typedef struct X11JobSystem
+{
+    pthread_t       *threads;
+    X11JobDeque     *deques;
+    i32              worker_count;
+    i32              started;
+
+    // Submissions from threads that are not workers
+    pthread_mutex_t  inject_lock;
+    X11Job          *inject;
+    u32              inject_cap;
+    u32              inject_head;
+    volatile u32     inject_count;
+
+    pthread_mutex_t  park_lock;
+    pthread_cond_t   park_cond;
+    volatile i32     sleepers;
+    volatile b8      shutdown;
+} X11JobSystem;
+
+typedef struct
+{
+    X11JobSystem *system;
+    i32           index;
+} X11JobWorkerArgs;
+
+file_global __thread i32 tls_job_worker = -1;  // deque owned by this thread, -1 if none
+file_global __thread u32 tls_job_seed   = 0;   // victim selection
+
+file_internal void X11JobSystemInit(X11JobSystem **result, i32 worker_count);
+file_internal void X11JobSystemFree(X11JobSystem **system);
+file_internal void X11JobQueueTask(X11JobSystem *system, void (*fn)(void*), void *arg);
+file_internal void X11JobQueueTaskBatch(X11JobSystem *system, void (*fn)(void*), void *args, u64 stride, u32 count);
+file_internal void X11JobAwaitCounter(X11JobSystem *system, volatile u32 *counter);
+file_internal void* X11JobWorkerProc(void *arg);
+
+FORCE_INLINE void X11JobPause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    sched_yield();
+#endif
+}
+
+//------------------------------------------------------------------------------------
+// Chase-Lev deque, following "Correct and Efficient Work-Stealing for Weak Memory Models"
+// (Le et al. 2013). The buffer never grows: a push into a full deque fails and the
+// caller runs the job inline instead.
+
+file_internal b8 X11JobDequePush(X11JobDeque *deque, X11Job job)
+{
+    i64 b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    i64 t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if (b - t >= X11_JOB_DEQUE_SIZE) return false;
+
+    deque->jobs[b & (X11_JOB_DEQUE_SIZE - 1)] = job;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+file_internal b8 X11JobDequePop(X11JobDeque *deque, X11Job *job)
+{
+    i64 b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    i64 t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    b8 result = false;
+    if (t <= b)
+    {
+        *job = deque->jobs[b & (X11_JOB_DEQUE_SIZE - 1)];
+        result = true;
+
+        if (t == b)
+        {
+            // Last job, race the thieves for it
+            if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            {
+                result = false;
+            }
+            __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+    }
+    else
+    {
+        __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+
+    return result;
+}
+
+file_internal b8 X11JobDequeSteal(X11JobDeque *deque, X11Job *job)
+{
+    i64 t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    i64 b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (t >= b) return false;
+
+    X11Job stolen = deque->jobs[t & (X11_JOB_DEQUE_SIZE - 1)];
+    if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+        return false; // lost the race to the owner or another thief
+    }
+
+    *job = stolen;
+    return true;
+}
+
+//------------------------------------------------------------------------------------
+// Injection queue
+
+file_internal void X11JobInjectLocked(X11JobSystem *system, X11Job job)
+{
+    if (system->inject_count == system->inject_cap)
+    {
+        u32 cap = system->inject_cap * 2;
+        X11Job *jobs = (X11Job*)PlatformAlloc(sizeof(X11Job) * cap);
+        for (u32 i = 0; i < system->inject_count; ++i)
+        {
+            jobs[i] = system->inject[(system->inject_head + i) & (system->inject_cap - 1)];
+        }
+
+        PlatformFree(system->inject);
+        system->inject      = jobs;
+        system->inject_cap  = cap;
+        system->inject_head = 0;
+    }
+
+    u32 tail = (system->inject_head + system->inject_count) & (system->inject_cap - 1);
+    system->inject[tail] = job;
+    __atomic_store_n(&system->inject_count, system->inject_count + 1, __ATOMIC_SEQ_CST);
+}
+
+file_internal b8 X11JobInjectPop(X11JobSystem *system, X11Job *job)
+{
+    if (__atomic_load_n(&system->inject_count, __ATOMIC_ACQUIRE) == 0) return false;
+
+    b8 result = false;
+    pthread_mutex_lock(&system->inject_lock);
+    if (system->inject_count > 0)
+    {
+        *job = system->inject[system->inject_head];
+        system->inject_head = (system->inject_head + 1) & (system->inject_cap - 1);
+        __atomic_store_n(&system->inject_count, system->inject_count - 1, __ATOMIC_RELEASE);
+        result = true;
+    }
+    pthread_mutex_unlock(&system->inject_lock);
+
+    return result;
+}
+
+//------------------------------------------------------------------------------------
+// Scheduling
+
+file_internal b8 X11JobHasWork(X11JobSystem *system)
+{
+    if (__atomic_load_n(&system->inject_count, __ATOMIC_SEQ_CST) > 0) return true;
+
+    for (i32 i = 0; i < system->worker_count; ++i)
+    {
+        X11JobDeque *deque = &system->deques[i];
+        if (__atomic_load_n(&deque->top, __ATOMIC_SEQ_CST) < __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST))
+            return true;
+    }
+
+    return false;
+}
+
+file_internal b8 X11JobTryGet(X11JobSystem *system, X11Job *job)
+{
+    i32 self = tls_job_worker;
+    if (self >= 0 && X11JobDequePop(&system->deques[self], job)) return true;
+
+    if (X11JobInjectPop(system, job)) return true;
+    if (system->worker_count == 0) return false;
+
+    // Start at a random victim so thieves spread out over the workers
+    if (tls_job_seed == 0) tls_job_seed = (u32)(uptr)&tls_job_seed | 1;
+    tls_job_seed ^= tls_job_seed << 13;
+    tls_job_seed ^= tls_job_seed >> 17;
+    tls_job_seed ^= tls_job_seed << 5;
+
+    i32 start = (i32)(tls_job_seed % (u32)system->worker_count);
+    for (i32 i = 0; i < system->worker_count; ++i)
+    {
+        i32 victim = (start + i) % system->worker_count;
+        if (victim == self) continue;
+        if (X11JobDequeSteal(&system->deques[victim], job))
+        {
+            JOB_PROFILE(JobEvent_Steal, victim);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+file_internal void X11JobWake(X11JobSystem *system, u32 count)
+{
+    // Pairs with the sleepers increment in the worker: either the worker sees the new
+    // job when it re-checks, or we see it as a sleeper here
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&system->sleepers, __ATOMIC_SEQ_CST) == 0) return;
+
+    pthread_mutex_lock(&system->park_lock);
+    if (count >= (u32)system->sleepers)
+    {
+        pthread_cond_broadcast(&system->park_cond);
+    }
+    else
+    {
+        for (u32 i = 0; i < count; ++i) pthread_cond_signal(&system->park_cond);
+    }
+    pthread_mutex_unlock(&system->park_lock);
+}
+
+file_internal void* X11JobWorkerProc(void *arg)
+{
+    X11JobWorkerArgs *args = (X11JobWorkerArgs*)arg;
+    X11JobSystem *system = args->system;
+    tls_job_worker = args->index;
+    tls_job_seed   = 0x9E3779B9u * (u32)(args->index + 1);
+    PlatformFree(args);
+
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", tls_job_worker);
+    X11_JOB_NAME_THREAD(name);
+
+    i32 spins = 0;
+    for (;;)
+    {
+        X11Job job;
+        if (X11JobTryGet(system, &job))
+        {
+            JOB_PROFILE(JobEvent_Begin, job.fn);
+            job.fn(job.arg);
+            JOB_PROFILE(JobEvent_End, job.fn);
+            spins = 0;
+            continue;
+        }
+
+        // Will finish all queued jobs before exiting, same as the Win32 pool
+        if (__atomic_load_n(&system->shutdown, __ATOMIC_ACQUIRE)) break;
+
+        if (++spins < X11_JOB_SPIN_COUNT)
+        {
+            X11JobPause();
+            continue;
+        }
+
+        JOB_PROFILE(JobEvent_Park, 0);
+        pthread_mutex_lock(&system->park_lock);
+        __atomic_add_fetch(&system->sleepers, 1, __ATOMIC_SEQ_CST);
+        while (!__atomic_load_n(&system->shutdown, __ATOMIC_ACQUIRE) && !X11JobHasWork(system))
+        {
+            pthread_cond_wait(&system->park_cond, &system->park_lock);
+        }
+        __atomic_sub_fetch(&system->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&system->park_lock);
+        JOB_PROFILE(JobEvent_Unpark, 0);
+        spins = 0;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------------
+// Public interface
+
+file_internal void X11JobSystemInit(X11JobSystem **result, i32 worker_count)
+{
+    X11JobSystem *system = (X11JobSystem*)PlatformAlloc(sizeof(X11JobSystem));
+    memset(system, 0, sizeof(X11JobSystem));
+
+    // Zero workers is allowed, jobs then only run in X11JobAwaitCounter on the caller
+    system->worker_count = (worker_count > 0) ? worker_count : 0;
+    system->threads = (pthread_t*)PlatformAlloc(sizeof(pthread_t) * system->worker_count);
+    system->deques  = (X11JobDeque*)PlatformAlloc(sizeof(X11JobDeque) * system->worker_count);
+    for (i32 i = 0; i < system->worker_count; ++i)
+    {
+        system->deques[i].top    = 0;
+        system->deques[i].bottom = 0;
+        system->deques[i].jobs   = (X11Job*)PlatformAlloc(sizeof(X11Job) * X11_JOB_DEQUE_SIZE);
+    }
+
+    system->inject_cap = X11_JOB_INJECT_SIZE;
+    system->inject     = (X11Job*)PlatformAlloc(sizeof(X11Job) * system->inject_cap);
+
+    pthread_mutex_init(&system->inject_lock, NULL);
+    pthread_mutex_init(&system->park_lock, NULL);
+    pthread_cond_init(&system->park_cond, NULL);
+
+    for (i32 i = 0; i < system->worker_count; ++i)
+    {
+        X11JobWorkerArgs *args = (X11JobWorkerArgs*)PlatformAlloc(sizeof(X11JobWorkerArgs));
+        args->system = system;
+        args->index  = i;
+
+        if (pthread_create(&system->threads[i], NULL, X11JobWorkerProc, args) != 0)
+        {
+            LogError("X11JobSystem::Init::Failed to create all threads!");
+            PlatformFree(args);
+            goto GOTO_ERR;
+        }
+
+        system->started++;
+    }
+
+    *result = system;
+    return;
+
+    // @GOTO
+    GOTO_ERR:
+    X11JobSystemFree(&system);
+    *result = 0;
+}
+
+file_internal void X11JobSystemFree(X11JobSystem **system)
+{
+    X11JobSystem *local = *system;
+    if (!local) return;
+
+    pthread_mutex_lock(&local->park_lock);
+    __atomic_store_n(&local->shutdown, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&local->park_cond);
+    pthread_mutex_unlock(&local->park_lock);
+
+    for (i32 i = 0; i < local->started; ++i)
+    {
+        pthread_join(local->threads[i], NULL);
+    }
+
+    for (i32 i = 0; i < local->worker_count; ++i)
+    {
+        PlatformFree(local->deques[i].jobs);
+    }
+
+    pthread_cond_destroy(&local->park_cond);
+    pthread_mutex_destroy(&local->park_lock);
+    pthread_mutex_destroy(&local->inject_lock);
+
+    PlatformFree(local->inject);
+    PlatformFree(local->deques);
+    PlatformFree(local->threads);
+    PlatformFree(local);
+    *system = 0;
+}
+
+file_internal void X11JobQueueTask(X11JobSystem *system, void (*fn)(void*), void *arg)
+{
+    // Callers wait on a counter the job decrements, so a job is never dropped. Without a
+    // job system it runs right away.
+    Assert(fn);
+    if (!system)
+    {
+        fn(arg);
+        return;
+    }
+
+    X11Job job = { fn, arg };
+
+    i32 self = tls_job_worker;
+    if (self >= 0)
+    {
+        // Full deque, nothing sensible to queue it behind so run it now
+        if (!X11JobDequePush(&system->deques[self], job))
+        {
+            fn(arg);
+            return;
+        }
+    }
+    else
+    {
+        pthread_mutex_lock(&system->inject_lock);
+        X11JobInjectLocked(system, job);
+        pthread_mutex_unlock(&system->inject_lock);
+    }
+
+    X11JobWake(system, 1);
+}
+
+file_internal void X11JobQueueTaskBatch(X11JobSystem *system, void (*fn)(void*), void *args, u64 stride, u32 count)
+{
+    Assert(fn);
+    u8 *arg = (u8*)args;
+
+    if (!system)
+    {
+        for (u32 i = 0; i < count; ++i) fn(arg + i * stride);
+        return;
+    }
+    if (count == 0) return;
+
+    i32 self = tls_job_worker;
+    if (self >= 0)
+    {
+        for (u32 i = 0; i < count; ++i)
+        {
+            X11Job job = { fn, arg + i * stride };
+            if (!X11JobDequePush(&system->deques[self], job)) job.fn(job.arg);
+        }
+    }
+    else
+    {
+        // One lock and one wake up for the whole batch
+        pthread_mutex_lock(&system->inject_lock);
+        for (u32 i = 0; i < count; ++i)
+        {
+            X11Job job = { fn, arg + i * stride };
+            X11JobInjectLocked(system, job);
+        }
+        pthread_mutex_unlock(&system->inject_lock);
+    }
+
+    X11JobWake(system, count);
+}
+
+file_internal void X11JobAwaitCounter(X11JobSystem *system, volatile u32 *counter)
+{
+    // Run queued jobs on this thread instead of spinning until the counter drains
+    while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) != 0)
+    {
+        X11Job job;
+        if (system && X11JobTryGet(system, &job))
+        {
+            JOB_PROFILE(JobEvent_Begin, job.fn);
+            job.fn(job.arg);
+            JOB_PROFILE(JobEvent_End, job.fn);
+        }
+        else
+        {
+            X11JobPause();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Platform API
+
+file_global X11JobSystem *g_job_system = 0;
+
+void PlatformAsyncTask(void (*fn)(void*), void *args)
+{
+    X11JobQueueTask(g_job_system, fn, args);
+}
+
+void PlatformAsyncTaskBatch(void (*fn)(void*), void *args, u64 stride, u32 count)
+{
+    X11JobQueueTaskBatch(g_job_system, fn, args, stride, count);
+}
+
+void PlatformAwaitCounter(volatile u32 *counter)
+{
+    X11JobAwaitCounter(g_job_system, counter);
+}
+
+void PlatformAtomicInc(volatile u32* v)
+{
+    __atomic_add_fetch(v, 1, __ATOMIC_SEQ_CST);
+}
+
+void PlatformAtomicDec(volatile u32* v)
+{
+    __atomic_sub_fetch(v, 1, __ATOMIC_SEQ_CST);
+}
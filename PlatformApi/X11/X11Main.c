@@ -210,6 +210,8 @@ int main()
     X11RequestMemory(&app_backing_memory, app_backing_memory_size);
     SysMemoryInit(app_backing_memory, app_backing_memory_size);
     
+    X11JobSystemInit(&g_job_system, (i32)sysconf(_SC_NPROCESSORS_ONLN));
+    
     HostWnd *client = 0;
     host_wnd_init(&client, 1920, 1080, "Maple Genetics");
     host_wnd_set_active(client);
@@ -338,6 +340,7 @@ int main()
     //sample_free(&sample);
     renderer_free(&renderer);
     host_wnd_free(&client);
+    X11JobSystemFree(&g_job_system);
     SysMemoryFree();
     X11ReleaseMemory(&app_backing_memory, app_backing_memory_size);
     
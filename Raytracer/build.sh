@@ -1,7 +1,43 @@
 #!/bin/bash
 
-code="$PWD"
-opts=-g
-cd bin\debug > /dev/null
-g++ $opts $code/build.bat -o MapleTerrain.exe
-cd $code > /dev/null
+# Builds the headless batch renderer (src/Platform/X11/X11Main.c). The windowed DX11
+# demo is Windows only, see build.bat.
+
+# Get the directory, readlink -f is not available on every Mac
+LOCATION="$(cd "$(dirname "$0")" && pwd)"
+
+MODE=debug
+if [[ "$1" == "release" ]]; then
+	MODE=release
+fi
+
+if [ ! -d $LOCATION/bin/$MODE ];
+then
+	mkdir -p $LOCATION/bin/$MODE
+fi
+
+DEBUG_FLAGS="-O0 -g -rdynamic"
+RELEASE_FLAGS="-O2 -DNDEBUG"
+COMMON_FLAGS="-Wall -Wno-sequence-point -Wno-unused-function -Wno-unknown-pragmas -I../../src/ -I../../ext/"
+LINKER_FLAGS="-lm -lpthread"
+
+if [[ "$MODE" == "debug" ]]; then
+	FLAGS="$COMMON_FLAGS $DEBUG_FLAGS"
+else
+	FLAGS="$COMMON_FLAGS $RELEASE_FLAGS"
+fi
+
+echo "Building in $MODE mode."
+
+pushd $LOCATION/bin/$MODE > /dev/null
+	echo g++ $FLAGS -o MapleRaytracer ../../src/UnityBuild.cpp $LINKER_FLAGS
+	g++ $FLAGS -o MapleRaytracer ../../src/UnityBuild.cpp $LINKER_FLAGS
+	RESULT=$?
+popd > /dev/null
+
+if [ $RESULT -ne 0 ]; then
+	echo "Build failed!"
+	exit $RESULT
+fi
+
+echo "Build complete!"
@@ -1,18 +1,14 @@
 #!/bin/bash
 
-# Get the target machine
-MACHINE=$(./scripts/machine.sh)
+# Runs the headless batch renderer, all arguments are passed through (see --help)
 
-if [[ "$MACHINE" == "Linux" ]]; then
-	# Get the directory
-	ME="$(readlink -f "$0")"
-	LOCATION="$(dirname "$ME")"
-elif [[ "$MACHINE" == "Mac" ]]; then
-	# Get the directory
-	ME="$(greadlink -f "$0")"
-	LOCATION="$(dirname "$ME")"
-fi 
+# Get the directory, readlink -f is not available on every Mac
+LOCATION="$(cd "$(dirname "$0")" && pwd)"
 
-pushd $LOCATION/bin/debug
-	./MapleVk.exe
-popd
+MODE=debug
+if [[ "$1" == "release" ]]; then
+	MODE=release
+	shift
+fi
+
+$LOCATION/bin/$MODE/MapleRaytracer "$@"
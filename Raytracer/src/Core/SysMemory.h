@@ -5,6 +5,13 @@
 #define MemFree(p)       (SysMemoryRelease((void*)(p)), p = NULL)
 #define MemRealloc(p, s) MemReallocWrapperT((p), (s))
 
+void SysMemoryInit(void *ptr, u64 size);
+void SysMemoryFree();
+
+void* SysMemoryAlloc(u64 size);
+void  SysMemoryRelease(void *ptr);
+void* SysMemoryRealloc(void *ptr, u64 size);
+
 #ifdef __cplusplus
 
 template<typename T> T* MemReallocWrapperT(T* ptr, u64 size)
@@ -16,11 +23,4 @@ template<typename T> T* MemReallocWrapperT(T* ptr, u64 size)
 #define MemReallocWrapperT(p, s) ((p) = SysMemoryRealloc((p), (s)))
 #endif
 
-void SysMemoryInit(void *ptr, u64 size);
-void SysMemoryFree();
-
-void* SysMemoryAlloc(u64 size);
-void  SysMemoryRelease(void *ptr);
-void* SysMemoryRealloc(void *ptr, u64 size);
-
 #endif // _SYS_MEMORY_H
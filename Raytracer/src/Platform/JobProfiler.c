@@ -0,0 +1,185 @@
+
+#define JOB_PROFILER_FLUSH_SIZE _MB(1) // the trace is written out in chunks of this size
+
+typedef struct
+{
+    JobEvent     *events;   // allocated by the thread's first event
+    volatile u64  head;     // events recorded since job_profiler_begin
+    char          name[32];
+} JobProfilerRing;
+
+typedef struct
+{
+    volatile b8      recording;
+    volatile u32     rings_count;
+    JobProfilerRing  rings[JOB_PROFILER_MAX_THREADS];
+
+    // rdtsc is converted to time over the whole recording, the counter's rate is not
+    // known up front
+    u64              begin_tsc;
+    Timer            begin_timer;
+} JobProfiler;
+
+file_global JobProfiler g_job_profiler;
+file_global thread_local JobProfilerRing *tls_job_profiler_ring = 0;
+
+file_internal JobProfilerRing* job_profiler_ring()
+{
+    if (tls_job_profiler_ring) return tls_job_profiler_ring;
+
+#if defined(_WIN32)
+    u32 index = (u32)_InterlockedIncrement((volatile long*)&g_job_profiler.rings_count) - 1;
+#else
+    u32 index = __atomic_fetch_add(&g_job_profiler.rings_count, 1, __ATOMIC_SEQ_CST);
+#endif
+    // Threads past the limit are not recorded
+    if (index >= JOB_PROFILER_MAX_THREADS) return 0;
+
+    JobProfilerRing *ring = &g_job_profiler.rings[index];
+    snprintf(ring->name, sizeof(ring->name), "thread %u", index);
+    tls_job_profiler_ring = ring;
+    return ring;
+}
+
+// rings_count keeps counting threads that did not get a ring
+FORCE_INLINE u32 job_profiler_rings_count()
+{
+    u32 count = g_job_profiler.rings_count;
+    return (count < JOB_PROFILER_MAX_THREADS) ? count : JOB_PROFILER_MAX_THREADS;
+}
+
+FORCE_INLINE void job_profiler_record(u32 type, u64 data)
+{
+    JobProfilerRing *ring = job_profiler_ring();
+    if (!ring) return;
+    if (!ring->events) ring->events = (JobEvent*)PlatformAlloc(sizeof(JobEvent) * JOB_PROFILER_EVENTS_PER_THREAD);
+
+    u64 head = ring->head;
+    JobEvent *event = &ring->events[head & (JOB_PROFILER_EVENTS_PER_THREAD - 1)];
+    event->tsc  = __rdtsc();
+    event->data = data;
+    event->type = type;
+    ring->head  = head + 1;
+}
+
+void job_profiler_name_thread(const char *name)
+{
+    JobProfilerRing *ring = job_profiler_ring();
+    if (ring) snprintf(ring->name, sizeof(ring->name), "%s", name);
+}
+
+void job_profiler_begin()
+{
+    u32 count = job_profiler_rings_count();
+    for (u32 i = 0; i < count; ++i) g_job_profiler.rings[i].head = 0;
+
+    timer_begin(&g_job_profiler.begin_timer);
+    g_job_profiler.begin_tsc = __rdtsc();
+    g_job_profiler.recording = true;
+}
+
+typedef struct
+{
+    const char *file_path;
+    char       *buffer;
+    u64         size;
+    bool        appending;
+    bool        ok;
+} JobTraceWriter;
+
+file_internal void job_trace_flush(JobTraceWriter *writer)
+{
+    if (writer->size == 0) return;
+
+    PlatformErrorType err = PlatformWriteBufferToFile(writer->file_path, (u8*)writer->buffer, writer->size, writer->appending);
+    writer->ok &= (err == PlatformError_Success);
+    writer->appending = true;
+    writer->size = 0;
+}
+
+file_internal void job_trace_write(JobTraceWriter *writer, const char *fmt, ...)
+{
+    // A single event is far below the flush size
+    if (writer->size + 256 > JOB_PROFILER_FLUSH_SIZE) job_trace_flush(writer);
+
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(writer->buffer + writer->size, JOB_PROFILER_FLUSH_SIZE - writer->size, fmt, args);
+    va_end(args);
+    if (written > 0) writer->size += (u64)written;
+}
+
+bool job_profiler_end(const char *file_path)
+{
+    g_job_profiler.recording = false;
+
+    u64 elapsed_tsc = __rdtsc() - g_job_profiler.begin_tsc;
+    r64 elapsed_us  = (r64)timer_seconds_elapsed(&g_job_profiler.begin_timer) * 1000000.0;
+    r64 us_per_tick = (elapsed_tsc > 0) ? elapsed_us / (r64)elapsed_tsc : 0.0;
+
+    JobTraceWriter writer = {};
+    writer.file_path = file_path;
+    writer.buffer    = (char*)PlatformAlloc(JOB_PROFILER_FLUSH_SIZE);
+    writer.ok        = true;
+
+    job_trace_write(&writer, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    bool first = true;
+    u32 count = job_profiler_rings_count();
+    for (u32 t = 0; t < count; ++t)
+    {
+        JobProfilerRing *ring = &g_job_profiler.rings[t];
+        job_trace_write(&writer, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                        first ? "" : ",\n", t, ring->name);
+        first = false;
+        if (!ring->events) continue;
+
+        // Once the ring wrapped, only the newest events are left. An event that ends a
+        // span whose start was overwritten is dropped.
+        u64 head  = ring->head;
+        u64 start = (head > JOB_PROFILER_EVENTS_PER_THREAD) ? head - JOB_PROFILER_EVENTS_PER_THREAD : 0;
+        u32 depth = 0;
+        for (u64 e = start; e < head; ++e)
+        {
+            JobEvent *event = &ring->events[e & (JOB_PROFILER_EVENTS_PER_THREAD - 1)];
+            r64 ts = (r64)(i64)(event->tsc - g_job_profiler.begin_tsc) * us_per_tick;
+
+            switch (event->type)
+            {
+                case JobEvent_Begin:
+                {
+                    ++depth;
+                    job_trace_write(&writer, ",\n{\"name\":\"job 0x%llx\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":0,\"tid\":%u}",
+                                    (unsigned long long)event->data, ts, t);
+                } break;
+
+                case JobEvent_Park:
+                {
+                    ++depth;
+                    job_trace_write(&writer, ",\n{\"name\":\"parked\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":0,\"tid\":%u}", ts, t);
+                } break;
+
+                case JobEvent_End:
+                case JobEvent_Unpark:
+                {
+                    if (depth == 0) break;
+                    --depth;
+                    job_trace_write(&writer, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,\"tid\":%u}", ts, t);
+                } break;
+
+                case JobEvent_Steal:
+                {
+                    job_trace_write(&writer, ",\n{\"name\":\"steal\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"victim\":%llu}}",
+                                    ts, t, (unsigned long long)event->data);
+                } break;
+            }
+        }
+    }
+
+    job_trace_write(&writer, "\n]}\n");
+    job_trace_flush(&writer);
+    PlatformFree(writer.buffer);
+
+    if (!writer.ok) LogError("Unable to write the job trace to %s", file_path);
+    return writer.ok;
+}
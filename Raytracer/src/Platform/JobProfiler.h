@@ -0,0 +1,55 @@
+#ifndef _JOB_PROFILER_H
+#define _JOB_PROFILER_H
+
+// Records what the job system threads are doing: job begin and end, steals and parking.
+// Every thread writes into its own ring buffer, so recording takes no lock and only keeps
+// the most recent events once a ring wraps. job_profiler_end writes the rings out as a
+// Chrome trace, open it in chrome://tracing or ui.perfetto.dev.
+//
+// Nothing is recorded outside of job_profiler_begin/end, a hook then costs a load and a
+// branch. Build with -DJOB_PROFILER=0 to compile the hooks out.
+
+#ifndef JOB_PROFILER
+#define JOB_PROFILER 1
+#endif
+
+#if defined(_WIN32)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#define JOB_PROFILER_MAX_THREADS       128
+#define JOB_PROFILER_EVENTS_PER_THREAD (1 << 16) // power of two
+
+typedef enum
+{
+    JobEvent_Begin,  // data is the job's function
+    JobEvent_End,
+    JobEvent_Steal,  // data is the index of the worker the next job was taken from
+    JobEvent_Park,   // the thread ran out of work and goes to sleep
+    JobEvent_Unpark,
+} JobEventType;
+
+typedef struct
+{
+    u64 tsc;         // rdtsc
+    u64 data;
+    u32 type;
+} JobEvent;
+
+// Names the calling thread in the trace. Optional, threads that record without a name
+// show up by their index.
+void job_profiler_name_thread(const char *name);
+void job_profiler_begin();
+// Stops recording and writes the trace. Call once no job is running, events a job records
+// while the trace is written may be torn. Returns false if the file could not be written.
+bool job_profiler_end(const char *file_path);
+
+#if JOB_PROFILER
+#define JOB_PROFILE(type, data) do { if (g_job_profiler.recording) job_profiler_record((type), (u64)(data)); } while (0)
+#else
+#define JOB_PROFILE(type, data)
+#endif
+
+#endif //_JOB_PROFILER_H
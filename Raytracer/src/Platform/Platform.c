@@ -1,29 +1,27 @@
 
 #if defined(__linux__) || defined(__APPLE__) 
 
+#ifndef __USE_GNU
 #define __USE_GNU
+#endif
 
+// Headless on Linux: the batch renderer has no window or presentation layer
 #include <sys/mman.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <limits.h>
-#include <libgen.h>
 #include <fcntl.h>
-#include <xcb/xcb.h>
-#include <X11/Xlib.h>
-#include <xcb/xcb_keysyms.h>
-#include <X11/keysym.h>
-#include <execinfo.h>
-#include <unistd.h>
 #include <signal.h>
-#include <ucontext.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "X11/X11Logger.c"
-#include "X11/X11Window.c"
+#include "X11/X11Timer.c"
 #include "X11/X11CoreUtils.c"
 #include "X11/X11File.c"
-#include "X11/X11OpenGL.c"
+// The job system is shared with the PlatformApi
+#include "../../../PlatformApi/X11/X11JobSystem.c"
 #include "X11/X11Main.c"
 
 #elif defined(_WIN32)
@@ -16,6 +16,10 @@ void PlatformGetWindowDims(u32 *width, u32 *height);
 // Threading API 
 
 void PlatformAsyncTask(void (*fn)(void*), void *args);
+// Queues count tasks at once, task i receives (u8*)args + i * stride
+void PlatformAsyncTaskBatch(void (*fn)(void*), void *args, u64 stride, u32 count);
+// Runs queued tasks on the calling thread until *counter reaches zero
+void PlatformAwaitCounter(volatile u32 *counter);
 void PlatformAtomicInc(volatile u32*);
 void PlatformAtomicDec(volatile u32*);
 
@@ -46,6 +50,17 @@ typedef enum
 PlatformErrorType PlatformReadFileToBuffer(const char* file_path, u8** buffer, u32* size);
 PlatformErrorType PlatformWriteBufferToFile(const char* file_path, u8* buffer, u64 size, bool append = false);
 
+typedef struct
+{
+    u8   *data;
+    u64   size;
+    void *handle; // platform mapping object, if the platform needs one to unmap
+} PlatformFileMapping;
+
+// Maps a whole file read only. Pages are loaded on first access, nothing is read up front.
+PlatformErrorType PlatformMapFile(const char* file_path, PlatformFileMapping *mapping);
+void PlatformUnmapFile(PlatformFileMapping *mapping);
+
 // TODO(Matt): Replace these params with enums.
 // Defaults 0, -1
 //Str PlatformShowBasicFileDialog(int type, int resource_type);
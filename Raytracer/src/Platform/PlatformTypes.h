@@ -5,6 +5,7 @@
 #if defined(__linux__) || defined(__APPLE__) 
 
 #define FORCE_INLINE inline __attribute__((always_inline))
+#define DebugBreak()  __builtin_trap()
 
 #elif defined(_WIN32)
 
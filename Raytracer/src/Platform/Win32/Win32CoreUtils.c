@@ -211,7 +211,7 @@ u32 PlatformClzl(u64 Value)
     unsigned long LeadingZero = 0;
     
     if (_BitScanReverse64(&LeadingZero, Value))
-        return 31 - LeadingZero;
+        return 63 - LeadingZero;
     else
-        return 32;
+        return 64;
 }
\ No newline at end of file
@@ -120,6 +120,45 @@ PlatformErrorType PlatformWriteBufferToFile(const char* file_path, u8* buffer, u
     return result;
 }
 
+PlatformErrorType PlatformMapFile(const char* file_path, PlatformFileMapping *mapping)
+{
+    memset(mapping, 0, sizeof(PlatformFileMapping));
+    
+    HANDLE handle = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, 0);
+    if (handle == INVALID_HANDLE_VALUE) return PlatformError_FileOpenFailure;
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(handle);
+        return PlatformError_FileReadFailure;
+    }
+    
+    // The mapping object keeps the file open, the file handle can be closed right away
+    HANDLE file_mapping = CreateFileMappingA(handle, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(handle);
+    if (!file_mapping) return PlatformError_FileReadFailure;
+    
+    void *data = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(file_mapping);
+        return PlatformError_FileReadFailure;
+    }
+    
+    mapping->data   = (u8*)data;
+    mapping->size   = (u64)size.QuadPart;
+    mapping->handle = file_mapping;
+    return PlatformError_Success;
+}
+
+void PlatformUnmapFile(PlatformFileMapping *mapping)
+{
+    if (mapping->data)   UnmapViewOfFile(mapping->data);
+    if (mapping->handle) CloseHandle((HANDLE)mapping->handle);
+    memset(mapping, 0, sizeof(PlatformFileMapping));
+}
+
 static Str Win32GetExeFilepath()
 {
     char buf[MAX_PATH];
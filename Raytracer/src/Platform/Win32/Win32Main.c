@@ -5,9 +5,11 @@ enum class Mode : u8
     OnlineBlocking, // present only when finished
     OnlineAsync,    // update as it renders
     OnlineAsyncJob, // Image is split into "jobs"
+    OnlineProgressive, // Morton ordered tiles refined in passes, previewed after each pass
+    OnlineInteractive, // re-renders as the camera moves, accumulates while it is still
 };
 
-file_global Mode g_rt_mode = Mode::OnlineAsyncJob;
+file_global Mode g_rt_mode = Mode::OnlineInteractive;
 
 #define DEFAULT_WINDOW_WIDTH  640
 #define DEFAULT_WINDOW_HEIGHT 360
@@ -18,6 +20,28 @@ file_global Mode g_rt_mode = Mode::OnlineAsyncJob;
 #define WINDOW_NAME           "Maple Raytracer"
 #define MAPLE_STARTUP_FILE    "maple.startup"
 
+// Interactive mode. The budget leaves room in a 60Hz frame for the texture copy and present.
+#define RT_FRAME_BUDGET_MS    12.0f
+#define RT_CAMERA_SPEED       4.0f  // world units per second
+#define RT_CAMERA_TURN_SPEED  1.0f  // radians per second
+
+// Optional .obj or .mesh file instanced into the scene, e.g. a LowPolyTerrainGen export
+file_global const char *g_rt_mesh_file = 0;
+
+// Filter every progressive pass before it is copied to the texture
+file_global bool g_rt_denoise = true;
+
+// Trace in breadth-first batches. The wavefront path records no AOVs, progressive tiles
+// still trace recursively while the denoiser is on.
+file_global bool g_rt_wavefront = false;
+
+// LBVH builds in a fraction of the time, the binned SAH tree is faster to trace
+file_global BvhBuilder g_rt_bvh_builder = BvhBuilder_BinnedSah;
+
+// T starts recording the thread pool, the next T writes the Chrome trace here
+file_global const char *g_rt_trace_file = "job_trace.json";
+file_global b8 g_rt_tracing = false;
+
 file_global bool g_app_is_running = false;
 file_global bool g_needs_resized  = false;
 file_global bool g_fullscreen     = false;
@@ -33,6 +57,13 @@ volatile u32 g_render_active = 0;
 file_global RtJob *job_data = 0;
 file_global Timer  rt_timer;
 
+// For progressive
+file_global RtProgressive rt_progressive;
+
+// For interactive, held keys. The window only reports presses as they repeat.
+file_global RtInteractive rt_interactive;
+file_global b8 g_keys_down[Key_Count];
+
 void 
 PlatformGetWindowDims(u32 *width, u32 *height)
 {
@@ -44,6 +75,16 @@ Win32KeyPressCallback(MapleKey key)
 {
     if (key == Key_Escape)
         g_app_is_running = false;
+    
+    if (key < Key_Count)
+        g_keys_down[key] = true;
+}
+
+void 
+Win32KeyReleaseCallback(MapleKey key)
+{
+    if (key < Key_Count)
+        g_keys_down[key] = false;
 }
 
 void 
@@ -52,6 +93,25 @@ PlatformAsyncTask(void (*fn)(void*), void *args)
     Win32ThreadQueueTask(g_thread_pool, fn, args);
 }
 
+void 
+PlatformAsyncTaskBatch(void (*fn)(void*), void *args, u64 stride, u32 count)
+{
+    Win32ThreadQueueTaskBatch(g_thread_pool, fn, args, stride, count);
+}
+
+void 
+PlatformAwaitCounter(volatile u32 *counter)
+{
+    // Help drain the queue rather than spinning on the counter
+    while (*counter != 0)
+    {
+        if (!Win32ThreadPoolTryRunTask(g_thread_pool))
+        {
+            YieldProcessor();
+        }
+    }
+}
+
 void 
 Win32ResizeCallback(u32 width, u32 height)
 {
@@ -80,6 +140,17 @@ rt_online_async_proc(LPVOID lp_param)
     return 0;
 }
 
+DWORD WINAPI 
+rt_online_progressive_proc(LPVOID lp_param)
+{
+    // Runs off the main thread so the window keeps presenting while the passes complete;
+    // the thread also helps the pool render while it waits on each pass.
+    _InterlockedExchange(&g_render_active, 1);
+    rt_progressive_render((RtProgressive*)lp_param);
+    _InterlockedExchange(&g_render_active, 0);
+    return 0;
+}
+
 DWORD WINAPI 
 rt_online_async_job_proc(LPVOID lp_param)
 {
@@ -87,6 +158,54 @@ rt_online_async_job_proc(LPVOID lp_param)
     return 0;
 }
 
+// Rotates v around the unit length axis
+file_internal v3
+rt_rotate_axis(v3 v, v3 axis, r32 radians)
+{
+    r32 c = cosf(radians);
+    r32 s = sinf(radians);
+    v3 result = v3_add(v3_mulf(v, c), v3_mulf(v3_cross(axis, v), s));
+    return v3_add(result, v3_mulf(axis, v3_dot(axis, v) * (1.0f - c)));
+}
+
+// WASD moves the camera, Q and E lower and raise it, the arrow keys turn it. Returns
+// true when the camera changed.
+file_internal bool
+rt_update_camera(CameraCreateInfo *info, r32 seconds)
+{
+    v3 forward = v3_norm(v3_sub(info->look_at, info->look_from));
+    v3 right   = v3_norm(v3_cross(forward, info->up));
+    
+    v3  move  = V3_ZERO;
+    r32 yaw   = 0.0f;
+    r32 pitch = 0.0f;
+    if (g_keys_down[Key_W])     move = v3_add(move, forward);
+    if (g_keys_down[Key_S])     move = v3_sub(move, forward);
+    if (g_keys_down[Key_D])     move = v3_add(move, right);
+    if (g_keys_down[Key_A])     move = v3_sub(move, right);
+    if (g_keys_down[Key_E])     move = v3_add(move, info->up);
+    if (g_keys_down[Key_Q])     move = v3_sub(move, info->up);
+    if (g_keys_down[Key_Left])  yaw   += 1.0f;
+    if (g_keys_down[Key_Right]) yaw   -= 1.0f;
+    if (g_keys_down[Key_Up])    pitch += 1.0f;
+    if (g_keys_down[Key_Down])  pitch -= 1.0f;
+    
+    if (v3_mag_sq(move) == 0.0f && yaw == 0.0f && pitch == 0.0f)
+        return false;
+    
+    info->look_from = v3_add(info->look_from, v3_mulf(move, RT_CAMERA_SPEED * seconds));
+    
+    forward = rt_rotate_axis(forward, info->up, yaw * RT_CAMERA_TURN_SPEED * seconds);
+    v3 pitched = rt_rotate_axis(forward, right, pitch * RT_CAMERA_TURN_SPEED * seconds);
+    
+    // Stop short of looking straight up or down, the camera basis degenerates there
+    if (fabsf(v3_dot(pitched, info->up)) < 0.99f)
+        forward = pitched;
+    
+    info->look_at = v3_add(info->look_from, v3_mulf(forward, info->focus_dist));
+    return true;
+}
+
 file_internal void
 rt_async_setup_jobs(i32 scan_x, i32 scan_y, RaytracerSettings *settings)
 {
@@ -119,10 +238,7 @@ rt_async_setup_jobs(i32 scan_x, i32 scan_y, RaytracerSettings *settings)
     // Submit the jobs
     _InterlockedExchange(&g_render_active, job_count);
     timer_begin(&rt_timer);
-    for (i32 i = 0; i < arrlen(job_data); ++i)
-    {
-        PlatformAsyncTask(rt_async, &job_data[i]);
-    }
+    PlatformAsyncTaskBatch(rt_async, job_data, sizeof(RtJob), (u32)arrlen(job_data));
 }
 
 INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, INT nCmdShow)
@@ -138,15 +254,20 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
     
     Win32ProcessorInfo processor_info;
     Win32GetProcessorInfo(&processor_info);
-    Win32ThreadPoolInit(&g_thread_pool, processor_info.logical_processor_count, 500);
+    // A progressive pass queues every tile of the image at once. A full queue no longer
+    // drops jobs, but the submitting thread would end up rendering tiles itself.
+    i32 tiles_count = ((TEXTURE_WIDTH + RT_TILE_SIZE - 1) / RT_TILE_SIZE) * ((TEXTURE_HEIGHT + RT_TILE_SIZE - 1) / RT_TILE_SIZE);
+    Win32ThreadPoolInit(&g_thread_pool, processor_info.logical_processor_count, fast_max(500, tiles_count));
+    job_profiler_name_thread("main");
     
     //~ Create the g_client window
     
     host_wnd_init(&g_client, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT, "Maple Terrain");
     
     HostWndCallbacks callbacks = {0};
-    callbacks.press  = Win32KeyPressCallback;
-    callbacks.resize = Win32ResizeCallback;
+    callbacks.press   = Win32KeyPressCallback;
+    callbacks.release = Win32KeyReleaseCallback;
+    callbacks.resize  = Win32ResizeCallback;
     host_wnd_set_callbacks(g_client, &callbacks);
     
     //~ Init rest of stuff
@@ -183,16 +304,41 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
     
     Scene scene;
     scene_init(&scene, 100);
-    build_random_scene(&scene, false);
+    build_random_scene(&scene, false, 1);
+    
+    Mesh mesh{};
+    MeshInstance mesh_instance{};
+    Material mesh_material{};
+    Primitive mesh_prim{};
+    if (g_rt_mesh_file)
+    {
+        size_t len = strlen(g_rt_mesh_file);
+        bool is_binary = len > 5 && strcmp(g_rt_mesh_file + len - 5, ".mesh") == 0;
+        bool loaded = is_binary ? mesh_load_binary(&mesh, g_rt_mesh_file) : mesh_load_obj(&mesh, g_rt_mesh_file);
+        if (loaded)
+        {
+            make_lambertian(&mesh_material, { 0.5f, 0.5f, 0.5f });
+            
+            mesh_instance_init(&mesh_instance, &mesh, M4_IDENTITY);
+            make_mesh_instance(&mesh_prim, &mesh_instance, scene_add_material(&scene, &mesh_material));
+            scene_add(&scene, &mesh_prim);
+            LogInfo("Loaded %s: %d triangles", g_rt_mesh_file, mesh.triangle_count);
+        }
+    }
     
-    // Build a bvh tree for the scene
-    Primitive bvh_tree;
-    make_bvh_node(&bvh_tree, scene.primitives, 0, scene.primitives_count, 0, 0);
-    scene.bvh_tree = &bvh_tree;
+    scene_build_lights(&scene);
     
-    //~ Raytracer settings
+    // Build a bvh tree for the scene, over the camera's shutter interval
+    Timer bvh_timer;
+    timer_begin(&bvh_timer);
+    Bvh bvh;
+    bvh_build(&bvh, scene.primitives, scene.primitives_count, info.t0, info.t1, g_rt_bvh_builder);
+    scene.bvh = &bvh;
+    LogInfo("BVH: %s in %.2f ms, SAH cost %.2f", bvh_builder_name(g_rt_bvh_builder),
+            timer_mili_seconds_elapsed(&bvh_timer), bvh_sah_cost(&bvh));
+    LogInfo("BVH traversal: %s", simd_level_name(bvh.simd_level));
     
-    srand(NULL);
+    //~ Raytracer settings
     
     u32 samples = 100;
     u32 depth = 50;
@@ -205,6 +351,10 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
     rt_settings.height  = TEXTURE_HEIGHT;
     rt_settings.samples = samples;
     rt_settings.depth   = depth;
+    rt_settings.seed    = 1;
+    rt_settings.wavefront = g_rt_wavefront;
+    rt_settings.noise_threshold = 0.01f;
+    rt_settings.denoise = g_rt_denoise && g_rt_mode == Mode::OnlineProgressive;
     //rt_settings.image   = (r32*)rt_renderer.rt_backing[rt_renderer.rt_index];
     rt_settings.image   = (r32*)rt_renderer.rt_backing[0];
     rt_settings.scene   = &scene;
@@ -215,7 +365,7 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
     if (g_rt_mode == Mode::Offline)
     {
         rt_entry(&rt_settings);
-        image_to_ppm(rt_settings.image, width, height);
+        image_write("image.ppm", ImageFormat_PPM, rt_settings.image, rt_settings.width, rt_settings.height);
         goto LBL_EXIT;
     }
     else if (g_rt_mode == Mode::OnlineBlocking)
@@ -231,6 +381,18 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
         //rt_async_setup_jobs(128, 72, &rt_settings);
         rt_async_setup_jobs(192, 108, &rt_settings);
     }
+    else if (g_rt_mode == Mode::OnlineProgressive)
+    {
+        rt_progressive_init(&rt_progressive, &rt_settings);
+        _InterlockedExchange(&g_render_active, 1);
+        timer_begin(&rt_timer);
+        rt_async_simple = CreateThread(NULL, 0, rt_online_progressive_proc, (void*)&rt_progressive, 0, NULL);
+    }
+    else if (g_rt_mode == Mode::OnlineInteractive)
+    {
+        // Rendered on the main thread, a frame at a time, see the loop below
+        rt_interactive_init(&rt_interactive, &rt_settings);
+    }
     
     //~ BEGIN!
     
@@ -238,6 +400,9 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
     r32 TargetSecondsPerFrame = 1 / RefreshRate;
     u64 frame_counter = 0;
     b8 last_frame_render = 1;
+    u32 last_published_pass = 0;
+    u32 scene_seed = 1;
+    r32 last_frame_seconds = TargetSecondsPerFrame;
     Timer frame_timer;
     
     host_wnd_set_active(g_client);
@@ -271,7 +436,58 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
         //~ Render
         
         // Copy current version of image over
-        if ((g_render_active > 0) && (frame_counter % 60) == 0)
+        if (g_rt_mode == Mode::OnlineInteractive)
+        {
+            if (rt_update_camera(&info, last_frame_seconds))
+            {
+                camera_init(&camera, &info);
+                rt_interactive_reset(&rt_interactive);
+            }
+            
+            // N swaps in the next random scene. The frame is synchronous, no job can still
+            // be reading the old one.
+            if (host_wnd_is_key_pressed(g_client, Key_N))
+            {
+                bvh_free(&bvh);
+                scene_free(&scene);
+                scene_init(&scene, 100);
+                build_random_scene(&scene, false, ++scene_seed);
+                if (mesh_instance.mesh)
+                {
+                    make_mesh_instance(&mesh_prim, &mesh_instance, scene_add_material(&scene, &mesh_material));
+                    scene_add(&scene, &mesh_prim);
+                }
+                scene_build_lights(&scene);
+                bvh_build(&bvh, scene.primitives, scene.primitives_count, info.t0, info.t1, g_rt_bvh_builder);
+                scene.bvh = &bvh;
+                rt_interactive_reset(&rt_interactive);
+                LogInfo("Scene seed %d: %d primitives", scene_seed, scene.primitives_count);
+            }
+            
+            // Between two frames no job is running, the trace can be written safely
+            if (host_wnd_is_key_pressed(g_client, Key_T))
+            {
+                if (g_rt_tracing) job_profiler_end(g_rt_trace_file);
+                else              job_profiler_begin();
+                g_rt_tracing = !g_rt_tracing;
+            }
+            
+            if (rt_interactive_frame(&rt_interactive, RT_FRAME_BUDGET_MS))
+            {
+                rt_renderer_copy(&rt_renderer);
+            }
+        }
+        else if (g_rt_mode == Mode::OnlineProgressive)
+        {
+            // Publish every finished pass as soon as it lands
+            u32 published_pass = rt_progressive.published_pass;
+            if (published_pass != last_published_pass)
+            {
+                rt_renderer_copy(&rt_renderer);
+                last_published_pass = published_pass;
+            }
+        }
+        else if ((g_render_active > 0) && (frame_counter % 60) == 0)
         {
             if (g_rt_mode >= Mode::OnlineAsync)
             {
@@ -280,7 +496,7 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
         }
         
 #if 1
-        if (g_render_active == 0 && last_frame_render == 1)
+        if (g_rt_mode != Mode::OnlineInteractive && g_render_active == 0 && last_frame_render == 1)
         {
             // The frame is no longer rendering, but go ahead and perform
             // one last copy so that image is fully up-to-date
@@ -340,13 +556,29 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
             // LOG: Missed frame rate!
         }
         
+        last_frame_seconds = SecondsElapsedPerFrame;
         timer_begin(&frame_timer);
     }
     
     LBL_EXIT:;
     
+    if (g_rt_mode == Mode::OnlineProgressive)
+    {
+        // Let the pass in flight drain before the pool goes away
+        _InterlockedExchange(&rt_progressive.cancel, 1);
+        WaitForSingleObject(rt_async_simple, INFINITE);
+        CloseHandle(rt_async_simple);
+        rt_progressive_free(&rt_progressive);
+    }
+    else if (g_rt_mode == Mode::OnlineInteractive)
+    {
+        rt_interactive_free(&rt_interactive);
+    }
+    
     Win32ThreadPoolFree(&g_thread_pool);
     arrfree(job_data);
+    bvh_free(&bvh);
+    mesh_free(&mesh);
     rt_renderer_free(&rt_renderer);
     host_wnd_free(&g_client);
     SysMemoryFree();
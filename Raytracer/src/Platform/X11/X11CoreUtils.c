@@ -0,0 +1,83 @@
+
+#include <errno.h>
+
+// munmap needs the mapping size, PlatformFree does not get one. Every allocation keeps
+// its size in a header in front of the returned pointer, padded to a cache line so the
+// pointer stays aligned for the SIMD loads in the BVH.
+#define X11_ALLOC_HEADER_SIZE 64
+
+void X11RequestMemory(void **result, u64 size)
+{
+    *result = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+
+    if (*result == MAP_FAILED)
+    {
+        LogFatal("Failed to allocate memory with size %ld", size);
+    }
+
+    int ret = madvise(*result, size, MADV_WILLNEED);
+    if (ret != 0)
+    {
+        LogError("Failed to advice mmap with adive MADV_WILLNEED");
+    }
+}
+
+void X11ReleaseMemory(void **ptr, u64 size)
+{
+    int err = munmap(*ptr, size);
+    if (err != 0)
+    {
+        const char *err_type = strerror(errno);
+        LogFatal("Failed to unmap memory: %s!", err_type);
+    }
+    *ptr = 0;
+}
+
+void* PlatformAlloc(u64 size)
+{
+    void *base;
+    X11RequestMemory(&base, size + X11_ALLOC_HEADER_SIZE);
+    *(u64*)base = size + X11_ALLOC_HEADER_SIZE;
+    return (u8*)base + X11_ALLOC_HEADER_SIZE;
+}
+
+void PlatformFree(void *ptr)
+{
+    if (!ptr) return;
+    void *base = (u8*)ptr - X11_ALLOC_HEADER_SIZE;
+    X11ReleaseMemory(&base, *(u64*)base);
+}
+
+u32 X11GetProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (u32)count : 1;
+}
+
+u32 PlatformCtz(u32 v)
+{
+    u32 result = 32;
+    if (v > 0) result = __builtin_ctz(v);
+    return result;
+}
+
+u32 PlatformClz(u32 v)
+{
+    u32 result = 32;
+    if (v > 0) result = __builtin_clz(v);
+    return result;
+}
+
+u32 PlatformCtzl(u64 v)
+{
+    u32 result = 64;
+    if (v > 0) result = __builtin_ctzl(v);
+    return result;
+}
+
+u32 PlatformClzl(u64 v)
+{
+    u32 result = 64;
+    if (v > 0) result = __builtin_clzll(v);
+    return result;
+}
@@ -0,0 +1,118 @@
+
+// Unlike the windowed builds, the batch renderer resolves paths against the working
+// directory so scene and output paths behave like any other command line tool.
+
+PlatformErrorType PlatformReadFileToBuffer(const char* file_path, u8** buffer, u32* size)
+{
+    PlatformErrorType result = PlatformError_Success;
+
+    // Deterime file size
+    struct stat file_info;
+    int stat_ret = stat(file_path, &file_info);
+    if (stat_ret == -1)
+    {
+        LogError("Failed to get file info for file: %s. Error: %s.", file_path, strerror(errno));
+        return PlatformError_FileOpenFailure;
+    }
+
+    *size = file_info.st_size;
+
+    // open the file
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0)
+    {
+        LogError("Failed to open file: %s! Error: %s.", file_path, strerror(errno));
+        return PlatformError_FileOpenFailure;
+    }
+
+    *buffer = (u8*)MemAlloc(*size + 1);
+
+    // read may return less than asked for on large files
+    u32 total = 0;
+    while (total < *size)
+    {
+        ssize_t read_bytes = read(fd, *buffer + total, *size - total);
+        if (read_bytes <= 0)
+        {
+            LogError("Failure reading file: %s!", file_path);
+            result = PlatformError_FileReadFailure;
+            break;
+        }
+        total += (u32)read_bytes;
+    }
+
+    (*buffer)[total] = 0;
+
+    close(fd);
+    return result;
+}
+
+PlatformErrorType PlatformWriteBufferToFile(const char* file_path, u8* buffer, u64 size, bool append)
+{
+    PlatformErrorType result = PlatformError_Success;
+
+    int flags = O_WRONLY|O_CREAT|(append ? O_APPEND : O_TRUNC);
+    int fd = open(file_path, flags, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+    if (fd < 0)
+    {
+        LogError("Unable to create file: %s! Error: %s", file_path, strerror(errno));
+        return PlatformError_FileOpenFailure;
+    }
+
+    // Same as read, a single write is not guaranteed to take the whole buffer
+    u64 total = 0;
+    while (total < size)
+    {
+        ssize_t written = write(fd, buffer + total, size - total);
+        if (written < 0)
+        {
+            LogError("Failed to write to file %s. Error: %s", file_path, strerror(errno));
+            result = (total > 0) ? PlatformError_FilePartialeWrite : PlatformError_FileWriteFailure;
+            break;
+        }
+        total += (u64)written;
+    }
+
+    close(fd);
+
+    return result;
+}
+
+PlatformErrorType PlatformMapFile(const char* file_path, PlatformFileMapping *mapping)
+{
+    memset(mapping, 0, sizeof(PlatformFileMapping));
+
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0)
+    {
+        LogError("Failed to open file: %s! Error: %s.", file_path, strerror(errno));
+        return PlatformError_FileOpenFailure;
+    }
+
+    struct stat file_info;
+    if (fstat(fd, &file_info) == -1 || file_info.st_size == 0)
+    {
+        LogError("Failed to get file info for file: %s.", file_path);
+        close(fd);
+        return PlatformError_FileReadFailure;
+    }
+
+    // The mapping keeps its own reference to the file, the descriptor is not needed after this
+    void *data = mmap(NULL, file_info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        LogError("Failed to map file: %s! Error: %s.", file_path, strerror(errno));
+        return PlatformError_FileReadFailure;
+    }
+
+    mapping->data = (u8*)data;
+    mapping->size = (u64)file_info.st_size;
+    return PlatformError_Success;
+}
+
+void PlatformUnmapFile(PlatformFileMapping *mapping)
+{
+    if (mapping->data) munmap(mapping->data, mapping->size);
+    memset(mapping, 0, sizeof(PlatformFileMapping));
+}
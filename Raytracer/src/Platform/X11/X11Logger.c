@@ -0,0 +1,84 @@
+
+typedef struct {
+  va_list     ap;
+  const char* fmt;
+  const char* file;
+  struct tm*  time;
+  FILE*       udata;
+  int         line;
+  int         level;
+} LogEvent;
+
+file_global const char *g_log_level_strings[] = {
+  "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
+};
+
+file_global const char *g_log_level_colors[] = {
+  "\x1b[94m", "\x1b[36m", "\x1b[32m", "\x1b[33m", "\x1b[31m", "\x1b[35m"
+};
+
+// Messages below this level are dropped, the CLI raises it with --quiet
+file_global int g_log_min_level = LOG_TRACE;
+
+// Render jobs log from every worker, keep their lines from interleaving
+file_global pthread_mutex_t g_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void StdoutCallback(LogEvent *ev) {
+  char buf[16];
+  buf[strftime(buf, sizeof(buf), "%H:%M:%S", ev->time)] = '\0';
+
+  // Only color the output when a terminal is reading it
+  bool color = isatty(fileno(ev->udata));
+  fprintf(
+    ev->udata, color ? "%s %s%-5s\x1b[0m \x1b[90m%s:%d:\x1b[0m " : "%s %s%-5s %s:%d: ",
+    buf, color ? g_log_level_colors[ev->level] : "", g_log_level_strings[ev->level],
+    ev->file, ev->line);
+  vfprintf(ev->udata, ev->fmt, ev->ap);
+  fprintf(ev->udata, "\n");
+  fflush(ev->udata);
+}
+
+static void InitEvent(LogEvent *ev, FILE *udata, struct tm *local) {
+  if (!ev->time) {
+    time_t t = time(NULL);
+    ev->time = localtime_r(&t, local);
+  }
+  ev->udata = udata;
+}
+
+void PlatformLog(int level, const char *file, int line, const char *fmt, ...)
+{
+    if (level < g_log_min_level && level != LOG_FATAL) return;
+
+    LogEvent ev = {};
+    ev.fmt   = fmt;
+    ev.file  = file;
+    ev.line  = line;
+    ev.level = level;
+
+    struct tm local;
+    InitEvent(&ev, stderr, &local);
+
+    pthread_mutex_lock(&g_log_lock);
+    va_start(ev.ap, fmt);
+    StdoutCallback(&ev);
+    va_end(ev.ap);
+    pthread_mutex_unlock(&g_log_lock);
+
+    if (level == LOG_FATAL)
+    {
+        exit(1);
+    }
+}
+
+bool PlatformShowAssertDialog(const char* message, const char* file, u32 line)
+{
+    // No dialog on a headless node, report it and break into the debugger if one is attached
+    LogError("Assertion Failed! File: %s, Line: %u, Statement: ASSERT(%s)", file, line, message);
+    return true;
+}
+
+void PlatformShowErrorDialog(const char* message)
+{
+    LogError("%s", message);
+}
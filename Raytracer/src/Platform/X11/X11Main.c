@@ -0,0 +1,422 @@
+
+// Headless batch renderer. Builds the scene, renders it once through the job system and
+// writes the image, then reports per-phase timings so runs can be scripted and compared.
+
+#define X11_DEFAULT_WIDTH  1920
+#define X11_DEFAULT_HEIGHT 1080
+
+typedef struct
+{
+    const char *scene;      // "random", "motion" or "lights"
+    const char *scene_file; // optional .json or .rts scene, replaces the built in scene
+    const char *save_file;  // write the scene and its BVH as .rts instead of rendering
+    const char *mesh_file;  // optional .obj or .mesh instanced into the scene
+    const char *out_file;   // format is picked from the extension
+    const char *trace_file; // optional Chrome trace of the job system
+    u32         width;
+    u32         height;
+    u32         samples;
+    u32         depth;
+    u32         seed;
+    u32         threads;    // including the main thread
+    BvhBuilder  builder;
+    r32         noise_threshold;
+    b8          denoise;
+    b8          aov;        // also write <out>_albedo.pfm and <out>_normal.pfm
+    b8          wavefront;
+    b8          quiet;
+} X11CliArgs;
+
+void PlatformGetWindowDims(u32 *width, u32 *height)
+{
+    // No window, report the default render size
+    *width  = X11_DEFAULT_WIDTH;
+    *height = X11_DEFAULT_HEIGHT;
+}
+
+file_internal void X11PrintUsage(const char *exe)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --scene <name>           random, motion or lights (default random)\n"
+            "  --scene-file <file>      load a .json scene, or map a prebuilt .rts scene\n"
+            "  --save-scene <file>      write the scene and its BVH to an .rts file, then exit\n"
+            "  --mesh <file>            instance an .obj or .mesh file into the scene\n"
+            "  --bvh <builder>          sah, lbvh or treelet (default sah)\n"
+            "  --res <W>x<H>            image resolution (default %dx%d)\n"
+            "  --spp <n>                samples per pixel (default 100)\n"
+            "  --depth <n>              maximum ray depth (default 50)\n"
+            "  --seed <n>               sampling seed (default 1)\n"
+            "  --threads <n>            render threads, including the main thread (default: all cores)\n"
+            "  --noise <t>              stop tiles below this relative error, 0 renders every sample (default 0)\n"
+            "  --out <file>             output image, .ppm, .pfm or .rth (default image.ppm)\n"
+            "  --denoise                filter the image with the albedo and normal AOVs\n"
+            "  --aov                    also write the albedo and normal AOVs as <out>_albedo.pfm, <out>_normal.pfm\n"
+            "  --wavefront              trace the tiles in breadth-first batches, no next event estimation\n"
+            "  --trace <file>           write what the job threads did as a Chrome trace (.json)\n"
+            "  --quiet                  only log warnings and errors\n",
+            exe, X11_DEFAULT_WIDTH, X11_DEFAULT_HEIGHT);
+}
+
+file_internal bool X11ParseU32(const char *str, u32 *result)
+{
+    char *end;
+    unsigned long value = strtoul(str, &end, 10);
+    if (end == str || *end != 0 || value > U32_MAX) return false;
+    *result = (u32)value;
+    return true;
+}
+
+file_internal bool X11HasExtension(const char *path, const char *ext)
+{
+    size_t len = strlen(path), ext_len = strlen(ext);
+    return len > ext_len && strcmp(path + len - ext_len, ext) == 0;
+}
+
+// <out>_<suffix>.pfm, with the extension of out replaced
+file_internal void X11AovPath(char *result, u32 size, const char *out, const char *suffix)
+{
+    const char *dot = strrchr(out, '.');
+    int stem = dot ? (int)(dot - out) : (int)strlen(out);
+    snprintf(result, size, "%.*s_%s.pfm", stem, out, suffix);
+}
+
+file_internal bool X11ParseArgs(X11CliArgs *args, int argc, char **argv)
+{
+    args->scene           = "random";
+    args->scene_file      = 0;
+    args->save_file       = 0;
+    args->mesh_file       = 0;
+    args->out_file        = "image.ppm";
+    args->trace_file      = 0;
+    args->width           = X11_DEFAULT_WIDTH;
+    args->height          = X11_DEFAULT_HEIGHT;
+    args->samples         = 100;
+    args->depth           = 50;
+    args->seed            = 1;
+    args->threads         = X11GetProcessorCount();
+    args->builder         = BvhBuilder_BinnedSah;
+    args->noise_threshold = 0.0f;
+    args->denoise         = false;
+    args->aov             = false;
+    args->wavefront       = false;
+    args->quiet           = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *opt = argv[i];
+        if (strcmp(opt, "--quiet") == 0)
+        {
+            args->quiet = true;
+            continue;
+        }
+        if (strcmp(opt, "--denoise") == 0)
+        {
+            args->denoise = true;
+            continue;
+        }
+        if (strcmp(opt, "--aov") == 0)
+        {
+            args->aov = true;
+            continue;
+        }
+        if (strcmp(opt, "--wavefront") == 0)
+        {
+            args->wavefront = true;
+            continue;
+        }
+        if (strcmp(opt, "--help") == 0 || strcmp(opt, "-h") == 0)
+        {
+            return false;
+        }
+
+        // Every other option takes a value
+        if (i + 1 >= argc)
+        {
+            LogError("Missing value for %s", opt);
+            return false;
+        }
+        const char *value = argv[++i];
+
+        bool ok = true;
+        if      (strcmp(opt, "--scene")   == 0) args->scene     = value;
+        else if (strcmp(opt, "--scene-file") == 0) args->scene_file = value;
+        else if (strcmp(opt, "--save-scene") == 0) args->save_file  = value;
+        else if (strcmp(opt, "--mesh")    == 0) args->mesh_file = value;
+        else if (strcmp(opt, "--out")     == 0) args->out_file  = value;
+        else if (strcmp(opt, "--trace")   == 0) args->trace_file = value;
+        else if (strcmp(opt, "--bvh")     == 0)
+        {
+            if      (strcmp(value, "sah")     == 0) args->builder = BvhBuilder_BinnedSah;
+            else if (strcmp(value, "lbvh")    == 0) args->builder = BvhBuilder_Lbvh;
+            else if (strcmp(value, "treelet") == 0) args->builder = BvhBuilder_LbvhTreelet;
+            else ok = false;
+        }
+        else if (strcmp(opt, "--spp")     == 0) ok = X11ParseU32(value, &args->samples);
+        else if (strcmp(opt, "--depth")   == 0) ok = X11ParseU32(value, &args->depth);
+        else if (strcmp(opt, "--seed")    == 0) ok = X11ParseU32(value, &args->seed);
+        else if (strcmp(opt, "--threads") == 0) ok = X11ParseU32(value, &args->threads) && args->threads > 0;
+        else if (strcmp(opt, "--noise")   == 0) ok = sscanf(value, "%f", &args->noise_threshold) == 1;
+        else if (strcmp(opt, "--res")     == 0)
+        {
+            ok = sscanf(value, "%ux%u", &args->width, &args->height) == 2 && args->width > 1 && args->height > 1;
+        }
+        else
+        {
+            LogError("Unknown option %s", opt);
+            return false;
+        }
+
+        if (!ok)
+        {
+            LogError("Invalid value for %s: %s", opt, value);
+            return false;
+        }
+    }
+
+    if (strcmp(args->scene, "random") != 0 && strcmp(args->scene, "motion") != 0 && strcmp(args->scene, "lights") != 0)
+    {
+        LogError("Unknown scene %s", args->scene);
+        return false;
+    }
+
+    if (args->scene_file && !X11HasExtension(args->scene_file, ".json") && !X11HasExtension(args->scene_file, ".rts"))
+    {
+        LogError("Scene files are .json or .rts: %s", args->scene_file);
+        return false;
+    }
+    if (args->mesh_file && args->scene_file && X11HasExtension(args->scene_file, ".rts"))
+    {
+        LogError("A mesh cannot be added to a prebuilt .rts scene");
+        return false;
+    }
+    if (args->wavefront && (args->denoise || args->aov))
+    {
+        LogError("The wavefront path records no AOVs, it cannot be combined with --denoise or --aov");
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    global_timer_setup();
+
+    X11CliArgs args;
+    if (!X11ParseArgs(&args, argc, argv))
+    {
+        X11PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (args.quiet) g_log_min_level = LOG_WARN;
+
+    //~ initialze memory for the application
+
+    u64   app_backing_memory_size = _MB(512);
+    void *app_backing_memory = PlatformAlloc(app_backing_memory_size);
+    SysMemoryInit(app_backing_memory, app_backing_memory_size);
+
+    // The main thread renders too while it waits on each pass
+    X11JobSystemInit(&g_job_system, (i32)args.threads - 1);
+
+    // Covers everything that runs on the job system, up to the image being written
+    job_profiler_name_thread("main");
+    if (args.trace_file) job_profiler_begin();
+
+    Timer phase_timer;
+    r32 scene_ms, bvh_ms, render_ms, write_ms;
+
+    //~ Create the scene
+
+    bool motion_blur = strcmp(args.scene, "motion") == 0;
+    bool mapped = args.scene_file && X11HasExtension(args.scene_file, ".rts");
+
+    CameraCreateInfo info{};
+    info.look_from    = { 13, 2, 3 };
+    info.look_at      = V3_ZERO;
+    info.up           = { 0, 1, 0 };
+    info.vfov         = 20;
+    info.aperture     = 0.1f;
+    info.focus_dist   = 10.0f;
+    info.t0           = 0.0f;
+    info.t1           = 1.0f;
+
+    timer_begin(&phase_timer);
+
+    // A mapped scene comes with its tree, built scenes get theirs below
+    SceneFile scene_file{};
+    Scene built_scene{};
+    Bvh built_bvh{};
+    Scene *scene;
+    Bvh *bvh;
+
+    Mesh mesh{};
+    MeshInstance mesh_instance{};
+
+    if (mapped)
+    {
+        if (!scene_file_load(&scene_file, args.scene_file))
+        {
+            LogFatal("Unable to load scene %s", args.scene_file);
+        }
+        scene = &scene_file.scene;
+        bvh = &scene_file.bvh;
+        info = scene_file.camera;
+    }
+    else
+    {
+        scene = &built_scene;
+        bvh = &built_bvh;
+        scene_init(scene, 100);
+        if (args.scene_file)
+        {
+            if (!scene_load_json(scene, &info, args.scene_file))
+            {
+                LogFatal("Unable to load scene %s", args.scene_file);
+            }
+        }
+        else if (strcmp(args.scene, "lights") == 0) build_lights_scene(scene, args.seed);
+        else                                        build_random_scene(scene, motion_blur, args.seed);
+
+        if (args.mesh_file)
+        {
+            bool is_binary = X11HasExtension(args.mesh_file, ".mesh");
+            bool loaded = is_binary ? mesh_load_binary(&mesh, args.mesh_file) : mesh_load_obj(&mesh, args.mesh_file);
+            if (!loaded)
+            {
+                LogFatal("Unable to load mesh %s", args.mesh_file);
+            }
+
+            Material mesh_material;
+            make_lambertian(&mesh_material, { 0.5f, 0.5f, 0.5f });
+
+            Primitive mesh_prim;
+            mesh_instance_init(&mesh_instance, &mesh, M4_IDENTITY);
+            make_mesh_instance(&mesh_prim, &mesh_instance, scene_add_material(scene, &mesh_material));
+            scene_add(scene, &mesh_prim);
+            LogInfo("Loaded %s: %d triangles", args.mesh_file, mesh.triangle_count);
+        }
+
+        scene_build_lights(scene);
+    }
+    scene_ms = timer_mili_seconds_elapsed(&phase_timer);
+
+    // Build a bvh tree for the scene, over the camera's shutter interval
+    timer_begin(&phase_timer);
+    if (!mapped)
+    {
+        bvh_build(bvh, scene->primitives, scene->primitives_count, info.t0, info.t1, args.builder);
+        scene->bvh = bvh;
+    }
+    bvh_ms = timer_mili_seconds_elapsed(&phase_timer);
+
+    if (args.save_file)
+    {
+        bool saved = scene_file_write(args.save_file, scene, bvh, &info);
+        printf("scene   %10.2f ms  %u primitives, %u materials, %u lights\n", scene_ms,
+               scene->primitives_count, scene->materials_count, scene->lights_count);
+        printf("bvh     %10.2f ms  %s, %s%s, SAH cost %.2f\n", bvh_ms, bvh_builder_name(args.builder),
+               simd_level_name(bvh->simd_level), bvh->end_bounds ? ", motion" : "", bvh_sah_cost(bvh));
+        printf("saved   %s\n", saved ? args.save_file : "failed");
+        if (args.trace_file && job_profiler_end(args.trace_file)) printf("trace   %s\n", args.trace_file);
+
+        X11JobSystemFree(&g_job_system);
+        if (mapped) scene_file_close(&scene_file);
+        else
+        {
+            bvh_free(bvh);
+            scene_free(scene);
+        }
+        mesh_free(&mesh);
+        SysMemoryFree();
+        PlatformFree(app_backing_memory);
+        return saved ? 0 : 1;
+    }
+
+    //~ Camera
+
+    info.aspect_ratio = (r32)args.width / (r32)args.height;
+
+    Camera camera;
+    camera_init(&camera, &info);
+
+    //~ Render
+
+    RaytracerSettings rt_settings{};
+    rt_settings.width   = args.width;
+    rt_settings.height  = args.height;
+    rt_settings.samples = args.samples;
+    rt_settings.depth   = args.depth;
+    rt_settings.seed    = args.seed;
+    rt_settings.wavefront = args.wavefront;
+    rt_settings.noise_threshold = args.noise_threshold;
+    rt_settings.denoise = args.denoise;
+    rt_settings.image   = (r32*)PlatformAlloc(sizeof(r32) * 3 * (u64)args.width * args.height);
+    rt_settings.albedo  = args.aov ? (r32*)PlatformAlloc(sizeof(r32) * 3 * (u64)args.width * args.height) : 0;
+    rt_settings.normal  = args.aov ? (r32*)PlatformAlloc(sizeof(r32) * 3 * (u64)args.width * args.height) : 0;
+    rt_settings.scene   = scene;
+    rt_settings.camera  = &camera;
+
+    // The progressive scheduler is the tiled job path; with no noise threshold every tile
+    // runs to the full sample count and the image matches rt_entry bit for bit.
+    RtProgressive progressive;
+    rt_progressive_init(&progressive, &rt_settings);
+
+    timer_begin(&phase_timer);
+    rt_progressive_render(&progressive);
+    render_ms = timer_mili_seconds_elapsed(&phase_timer);
+
+    u64 rays = rt_progressive_rays_traced(&progressive);
+    bool traced = args.trace_file && job_profiler_end(args.trace_file);
+
+    //~ Write
+
+    timer_begin(&phase_timer);
+    bool written = image_write(args.out_file, image_format_from_path(args.out_file),
+                               rt_settings.image, rt_settings.width, rt_settings.height);
+    if (args.aov)
+    {
+        char aov_path[1024];
+        X11AovPath(aov_path, sizeof(aov_path), args.out_file, "albedo");
+        written &= image_write(aov_path, ImageFormat_PFMData, rt_settings.albedo, rt_settings.width, rt_settings.height);
+        X11AovPath(aov_path, sizeof(aov_path), args.out_file, "normal");
+        written &= image_write(aov_path, ImageFormat_PFMData, rt_settings.normal, rt_settings.width, rt_settings.height);
+    }
+    write_ms = timer_mili_seconds_elapsed(&phase_timer);
+
+    //~ Report
+
+    r64 rays_per_sec = (render_ms > 0.0f) ? (r64)rays / ((r64)render_ms / 1000.0) : 0.0;
+    printf("scene   %10.2f ms  %u primitives, %u materials, %u lights%s\n", scene_ms,
+           scene->primitives_count, scene->materials_count, scene->lights_count, mapped ? ", mapped" : "");
+    printf("bvh     %10.2f ms  %s, %s%s, SAH cost %.2f\n", bvh_ms, mapped ? "prebuilt" : bvh_builder_name(args.builder),
+           simd_level_name(bvh->simd_level), bvh->end_bounds ? ", motion" : "", bvh_sah_cost(bvh));
+    printf("render  %10.2f ms  %ux%u, %u spp, depth %u, %u threads%s\n", render_ms,
+           args.width, args.height, args.samples, args.depth, args.threads, args.wavefront ? ", wavefront" : "");
+    if (args.denoise)
+    {
+        printf("denoise %10.2f ms  last pass, included in render\n", progressive.denoise_ms);
+    }
+    printf("write   %10.2f ms  %s%s\n", write_ms, args.out_file, args.aov ? " and AOVs" : "");
+    printf("rays    %10llu     %.2f Mrays/s\n", (unsigned long long)rays, rays_per_sec / 1e6);
+    if (traced) printf("trace   %s\n", args.trace_file);
+
+    rt_progressive_free(&progressive);
+    X11JobSystemFree(&g_job_system);
+    PlatformFree(rt_settings.image);
+    PlatformFree(rt_settings.albedo);
+    PlatformFree(rt_settings.normal);
+    if (mapped) scene_file_close(&scene_file);
+    else
+    {
+        bvh_free(bvh);
+        scene_free(scene);
+    }
+    mesh_free(&mesh);
+    SysMemoryFree();
+    PlatformFree(app_backing_memory);
+
+    return written ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+
+// CLOCK_MONOTONIC is already in nanoseconds, there is no frequency to query
+file_global const i64 g_performance_frequency = 1000000000;
+
+FORCE_INLINE u64 X11QueryCounter()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * g_performance_frequency + (u64)ts.tv_nsec;
+}
+
+void global_timer_setup()
+{
+}
+
+void timer_begin(Timer *timer)
+{
+    timer->start = X11QueryCounter();
+}
+
+r32 timer_seconds_elapsed(Timer *timer)
+{
+    r32 Result = ((r32)(X11QueryCounter() - timer->start) / (r32)g_performance_frequency);
+    return(Result);
+}
+
+r32 timer_mili_seconds_elapsed(Timer *timer)
+{
+    r32 Result = ((r32)(X11QueryCounter() - timer->start) * 1000 / (r32)g_performance_frequency);
+    return(Result);
+}
+
+r32 timer_nano_seconds_elapsed(Timer *timer)
+{
+    r32 Result = (r32)(X11QueryCounter() - timer->start);
+    return(Result);
+}
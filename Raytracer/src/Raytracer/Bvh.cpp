@@ -0,0 +1,944 @@
+
+struct BvhBin
+{
+    Aabb bounds;
+    Aabb end_bounds;
+    u32  count;
+};
+
+struct BvhBuildCtx
+{
+    Bvh        *bvh;
+    Aabb       *boxes;     // per primitive bounds, at shutter open for a motion tree
+    Aabb       *end_boxes; // per primitive bounds at shutter close, null for a static tree
+    v3         *centroids; // per primitive bounds centroid, at mid shutter for a motion tree
+    BvhBuilder  builder;
+    u64        *morton;    // LBVH: Morton code of the primitive at each prim_indices position
+    r32        *costs;     // treelets: SAH cost of the subtree under each node, area weighted
+    u8         *heights;   // treelets: height of the subtree under each node
+};
+
+struct BvhSplit
+{
+    r32 cost;
+    i32 axis;
+    u32 bin;       // primitives in bins [0, bin) go left
+    r32 cmin;      // centroid bounds min along axis
+    r32 bin_scale; // BVH_BIN_COUNT / centroid extent along axis
+};
+
+FORCE_INLINE r32
+bvh_node_area(BvhNode *node)
+{
+    Aabb box = { node->min, node->max };
+    return aabb_surface_area(&box);
+}
+
+FORCE_INLINE u32
+bvh_bin_index(r32 centroid, r32 cmin, r32 bin_scale)
+{
+    u32 bin = (u32)((centroid - cmin) * bin_scale);
+    return (bin < BVH_BIN_COUNT) ? bin : BVH_BIN_COUNT - 1;
+}
+
+// The area of a lerped box is quadratic in time, so Simpson's rule gives its exact mean
+// over the shutter interval
+file_internal r32
+bvh_swept_area(Aabb *start, Aabb *end)
+{
+    Aabb mid;
+    mid.min = v3_mulf(v3_add(start->min, end->min), 0.5f);
+    mid.max = v3_mulf(v3_add(start->max, end->max), 0.5f);
+    return (aabb_surface_area(start) + 4.0f * aabb_surface_area(&mid) + aabb_surface_area(end)) / 6.0f;
+}
+
+FORCE_INLINE r32
+bvh_cost_area(BvhBuildCtx *ctx, Aabb *start, Aabb *end)
+{
+    return ctx->end_boxes ? bvh_swept_area(start, end) : aabb_surface_area(start);
+}
+
+file_internal void
+bvh_update_node_bounds(BvhBuildCtx *ctx, u32 node_idx)
+{
+    BvhNode *node = &ctx->bvh->nodes[node_idx];
+
+    Aabb bounds, end_bounds;
+    aabb_make_empty(&bounds);
+    aabb_make_empty(&end_bounds);
+
+    u32 *indices = ctx->bvh->prim_indices + node->left_first;
+    for (u32 i = 0; i < node->count; ++i)
+    {
+        aabb_grow(&bounds, &ctx->boxes[indices[i]]);
+        if (ctx->end_boxes) aabb_grow(&end_bounds, &ctx->end_boxes[indices[i]]);
+    }
+
+    node->min = bounds.min;
+    node->max = bounds.max;
+    if (ctx->end_boxes) ctx->bvh->end_bounds[node_idx] = end_bounds;
+}
+
+file_internal BvhSplit
+bvh_find_best_split(BvhBuildCtx *ctx, BvhNode *node)
+{
+    BvhSplit result{};
+    result.cost = R32_MAX;
+    result.axis = -1;
+
+    u32 *indices = ctx->bvh->prim_indices + node->left_first;
+    for (i32 axis = 0; axis < 3; ++axis)
+    {
+        r32 cmin = R32_MAX;
+        r32 cmax = R32_MIN;
+        for (u32 i = 0; i < node->count; ++i)
+        {
+            r32 c = ctx->centroids[indices[i]].p[axis];
+            cmin = fminf(cmin, c);
+            cmax = fmaxf(cmax, c);
+        }
+        if (cmin == cmax) continue;
+
+        BvhBin bins[BVH_BIN_COUNT];
+        for (u32 b = 0; b < BVH_BIN_COUNT; ++b)
+        {
+            aabb_make_empty(&bins[b].bounds);
+            aabb_make_empty(&bins[b].end_bounds);
+            bins[b].count = 0;
+        }
+
+        r32 bin_scale = (r32)BVH_BIN_COUNT / (cmax - cmin);
+        for (u32 i = 0; i < node->count; ++i)
+        {
+            u32 prim = indices[i];
+            BvhBin *bin = &bins[bvh_bin_index(ctx->centroids[prim].p[axis], cmin, bin_scale)];
+            aabb_grow(&bin->bounds, &ctx->boxes[prim]);
+            if (ctx->end_boxes) aabb_grow(&bin->end_bounds, &ctx->end_boxes[prim]);
+            bin->count++;
+        }
+
+        // Sweep from both ends to gather the area and count on each side of every plane
+        r32 left_area[BVH_BIN_COUNT - 1],  right_area[BVH_BIN_COUNT - 1];
+        u32 left_count[BVH_BIN_COUNT - 1], right_count[BVH_BIN_COUNT - 1];
+
+        Aabb left_box, right_box, left_end, right_end;
+        aabb_make_empty(&left_box);
+        aabb_make_empty(&right_box);
+        aabb_make_empty(&left_end);
+        aabb_make_empty(&right_end);
+        u32 left_sum = 0, right_sum = 0;
+
+        for (u32 i = 0; i < BVH_BIN_COUNT - 1; ++i)
+        {
+            left_sum += bins[i].count;
+            left_count[i] = left_sum;
+            aabb_grow(&left_box, &bins[i].bounds);
+            aabb_grow(&left_end, &bins[i].end_bounds);
+            left_area[i] = (left_sum > 0) ? bvh_cost_area(ctx, &left_box, &left_end) : 0.0f;
+
+            u32 r = BVH_BIN_COUNT - 1 - i;
+            right_sum += bins[r].count;
+            right_count[r - 1] = right_sum;
+            aabb_grow(&right_box, &bins[r].bounds);
+            aabb_grow(&right_end, &bins[r].end_bounds);
+            right_area[r - 1] = (right_sum > 0) ? bvh_cost_area(ctx, &right_box, &right_end) : 0.0f;
+        }
+
+        for (u32 i = 0; i < BVH_BIN_COUNT - 1; ++i)
+        {
+            if (left_count[i] == 0 || right_count[i] == 0) continue;
+
+            r32 cost = (r32)left_count[i] * left_area[i] + (r32)right_count[i] * right_area[i];
+            if (cost < result.cost)
+            {
+                result.cost      = cost;
+                result.axis      = axis;
+                result.bin       = i + 1;
+                result.cmin      = cmin;
+                result.bin_scale = bin_scale;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Returns how many primitives go to the left child once the node's range is partitioned
+// around the best binned SAH plane, 0 if the node is cheaper as a leaf
+file_internal u32
+bvh_split_binned(BvhBuildCtx *ctx, u32 node_idx)
+{
+    Bvh *bvh = ctx->bvh;
+    BvhNode *node = &bvh->nodes[node_idx];
+
+    BvhSplit split = bvh_find_best_split(ctx, node);
+    if (split.axis < 0) return 0; // every centroid is identical, nothing to split on
+
+    Aabb node_box = { node->min, node->max };
+    r32 node_area  = bvh_cost_area(ctx, &node_box, ctx->end_boxes ? &bvh->end_bounds[node_idx] : 0);
+    r32 leaf_cost  = (r32)node->count * node_area;
+    r32 split_cost = BVH_TRAVERSAL_COST * node_area + split.cost;
+    if (split_cost >= leaf_cost && node->count <= BVH_MAX_LEAF_SIZE) return 0;
+
+    // Partition the index range in place around the chosen bin
+    u32 *indices = bvh->prim_indices;
+    i32 i = (i32)node->left_first;
+    i32 j = i + (i32)node->count - 1;
+    while (i <= j)
+    {
+        r32 c = ctx->centroids[indices[i]].p[split.axis];
+        if (bvh_bin_index(c, split.cmin, split.bin_scale) < split.bin)
+        {
+            ++i;
+        }
+        else
+        {
+            u32 tmp = indices[i];
+            indices[i] = indices[j];
+            indices[j] = tmp;
+            --j;
+        }
+    }
+
+    u32 left_count = (u32)i - node->left_first;
+    return (left_count < node->count) ? left_count : 0;
+}
+
+// The range is sorted by Morton code, so the split is where the highest bit that differs
+// within the range flips. A range of equal codes is halved. Small nodes still only split
+// if the SAH says so. Node bounds are only known once the subtree is built, small nodes
+// gather their own.
+file_internal u32
+bvh_split_morton(BvhBuildCtx *ctx, u32 node_idx)
+{
+    Bvh *bvh = ctx->bvh;
+    BvhNode *node = &bvh->nodes[node_idx];
+
+    u64 *codes = ctx->morton;
+    u32 first = node->left_first;
+    u32 last  = first + node->count - 1;
+
+    u32 split = first + node->count / 2;
+    if (codes[first] != codes[last])
+    {
+        u32 bit = 63 - PlatformClzl(codes[first] ^ codes[last]);
+        u32 lo = first, hi = last; // the bit is clear at lo and set at hi
+        while (hi - lo > 1)
+        {
+            u32 mid = lo + (hi - lo) / 2;
+            if ((codes[mid] >> bit) & 1) hi = mid;
+            else                         lo = mid;
+        }
+        split = hi;
+    }
+
+    if (node->count <= BVH_MAX_LEAF_SIZE)
+    {
+        Aabb left, right, left_end, right_end;
+        aabb_make_empty(&left);
+        aabb_make_empty(&right);
+        aabb_make_empty(&left_end);
+        aabb_make_empty(&right_end);
+        for (u32 i = first; i <= last; ++i)
+        {
+            u32 prim = bvh->prim_indices[i];
+            aabb_grow((i < split) ? &left : &right, &ctx->boxes[prim]);
+            if (ctx->end_boxes) aabb_grow((i < split) ? &left_end : &right_end, &ctx->end_boxes[prim]);
+        }
+
+        Aabb node_box = left, node_end = left_end;
+        aabb_grow(&node_box, &right);
+        aabb_grow(&node_end, &right_end);
+
+        r32 node_area  = bvh_cost_area(ctx, &node_box, &node_end);
+        r32 leaf_cost  = (r32)node->count * node_area;
+        r32 split_cost = BVH_TRAVERSAL_COST * node_area
+            + (r32)(split - first) * bvh_cost_area(ctx, &left, &left_end)
+            + (r32)(last + 1 - split) * bvh_cost_area(ctx, &right, &right_end);
+        if (split_cost >= leaf_cost) return 0;
+    }
+
+    return split - first;
+}
+
+FORCE_INLINE r32
+bvh_node_cost_area(BvhBuildCtx *ctx, u32 node_idx)
+{
+    BvhNode *node = &ctx->bvh->nodes[node_idx];
+    Aabb box = { node->min, node->max };
+    return bvh_cost_area(ctx, &box, ctx->end_boxes ? &ctx->bvh->end_bounds[node_idx] : 0);
+}
+
+// Treelet restructuring (Karras and Aila 2013). The treelet grows from the node by
+// repeatedly opening its largest interior leaf. The optimal topology over its leaves is
+// found by dynamic programming over every subset, then the treelet is rewritten into the
+// child pairs it already owns, so no nodes move outside of it.
+struct BvhTreelet
+{
+    u32     leaves[BVH_TREELET_LEAVES];
+    u32     pairs[BVH_TREELET_LEAVES - 1];
+    u32     leaves_count;
+    u32     pairs_used;
+
+    BvhNode leaf_nodes[BVH_TREELET_LEAVES];
+    Aabb    leaf_end_bounds[BVH_TREELET_LEAVES];
+    r32     leaf_costs[BVH_TREELET_LEAVES];
+    u8      leaf_heights[BVH_TREELET_LEAVES];
+
+    // Per subset of the leaves
+    Aabb    bounds[1 << BVH_TREELET_LEAVES];
+    Aabb    end_bounds[1 << BVH_TREELET_LEAVES];
+    r32     cost[1 << BVH_TREELET_LEAVES];
+    u8      left[1 << BVH_TREELET_LEAVES];
+};
+
+// Returns the height of the emitted subtree
+file_internal u32
+bvh_treelet_emit(BvhBuildCtx *ctx, BvhTreelet *treelet, u32 subset, u32 node_idx)
+{
+    Bvh *bvh = ctx->bvh;
+
+    if ((subset & (subset - 1)) == 0)
+    {
+        u32 leaf = PlatformCtz(subset);
+        bvh->nodes[node_idx] = treelet->leaf_nodes[leaf];
+        if (ctx->end_boxes) bvh->end_bounds[node_idx] = treelet->leaf_end_bounds[leaf];
+        ctx->costs[node_idx]   = treelet->leaf_costs[leaf];
+        ctx->heights[node_idx] = treelet->leaf_heights[leaf];
+        return treelet->leaf_heights[leaf];
+    }
+
+    u32 pair = treelet->pairs[treelet->pairs_used++];
+    BvhNode *node = &bvh->nodes[node_idx];
+    node->min        = treelet->bounds[subset].min;
+    node->max        = treelet->bounds[subset].max;
+    node->left_first = pair;
+    node->count      = 0;
+    if (ctx->end_boxes) bvh->end_bounds[node_idx] = treelet->end_bounds[subset];
+    ctx->costs[node_idx] = treelet->cost[subset];
+
+    u32 left = treelet->left[subset];
+    u32 left_height  = bvh_treelet_emit(ctx, treelet, left, pair);
+    u32 right_height = bvh_treelet_emit(ctx, treelet, subset ^ left, pair + 1);
+    ctx->heights[node_idx] = (u8)(1 + fast_max(left_height, right_height));
+    return ctx->heights[node_idx];
+}
+
+file_internal void
+bvh_treelet_optimize(BvhBuildCtx *ctx, u32 root_idx, u32 depth)
+{
+    Bvh *bvh = ctx->bvh;
+
+    // A leaf can end up at most BVH_TREELET_LEAVES - 2 levels deeper than it was, the tree
+    // has to stay within the depth bound of the traversal stack
+    if (depth + ctx->heights[root_idx] + BVH_TREELET_LEAVES - 2 >= BVH_STACK_SIZE) return;
+
+    BvhTreelet treelet;
+    treelet.pairs[0]     = bvh->nodes[root_idx].left_first;
+    treelet.leaves[0]    = treelet.pairs[0];
+    treelet.leaves[1]    = treelet.pairs[0] + 1;
+    treelet.leaves_count = 2;
+    u32 pairs_count = 1;
+
+    while (treelet.leaves_count < BVH_TREELET_LEAVES)
+    {
+        i32 best = -1;
+        r32 best_area = -1.0f;
+        for (u32 i = 0; i < treelet.leaves_count; ++i)
+        {
+            BvhNode *node = &bvh->nodes[treelet.leaves[i]];
+            if (node->count == 0 && bvh_node_area(node) > best_area)
+            {
+                best_area = bvh_node_area(node);
+                best = (i32)i;
+            }
+        }
+        if (best < 0) break;
+
+        u32 pair = bvh->nodes[treelet.leaves[best]].left_first;
+        treelet.pairs[pairs_count++] = pair;
+        treelet.leaves[best] = pair;
+        treelet.leaves[treelet.leaves_count++] = pair + 1;
+    }
+
+    // Two or three leaves leave no choice of topology
+    if (treelet.leaves_count < 4) return;
+
+    for (u32 i = 0; i < treelet.leaves_count; ++i)
+    {
+        u32 leaf = treelet.leaves[i];
+        treelet.leaf_nodes[i] = bvh->nodes[leaf];
+        treelet.leaf_costs[i]   = ctx->costs[leaf];
+        treelet.leaf_heights[i] = ctx->heights[leaf];
+        if (ctx->end_boxes) treelet.leaf_end_bounds[i] = bvh->end_bounds[leaf];
+    }
+
+    // Subsets only contain smaller subsets, counting up visits every subset after its parts
+    u32 full = (1u << treelet.leaves_count) - 1;
+    for (u32 subset = 1; subset <= full; ++subset)
+    {
+        u32 low  = subset & (0u - subset);
+        u32 rest = subset ^ low;
+        BvhNode *leaf = &treelet.leaf_nodes[PlatformCtz(low)];
+
+        Aabb *bounds = &treelet.bounds[subset];
+        Aabb *end    = &treelet.end_bounds[subset];
+        bounds->min = leaf->min;
+        bounds->max = leaf->max;
+        if (ctx->end_boxes) *end = treelet.leaf_end_bounds[PlatformCtz(low)];
+        if (rest == 0)
+        {
+            treelet.cost[subset] = treelet.leaf_costs[PlatformCtz(low)];
+            continue;
+        }
+        aabb_grow(bounds, &treelet.bounds[rest]);
+        if (ctx->end_boxes) aabb_grow(end, &treelet.end_bounds[rest]);
+
+        // Every split once: the side holding the lowest leaf goes left
+        r32 best = R32_MAX;
+        for (u32 left = (subset - 1) & subset; left > 0; left = (left - 1) & subset)
+        {
+            if (!(left & low)) continue;
+            r32 cost = treelet.cost[left] + treelet.cost[subset ^ left];
+            if (cost < best)
+            {
+                best = cost;
+                treelet.left[subset] = (u8)left;
+            }
+        }
+        treelet.cost[subset] = BVH_TRAVERSAL_COST * bvh_cost_area(ctx, bounds, end) + best;
+    }
+
+    // Rewriting an equivalent topology only churns the nodes
+    if (treelet.cost[full] >= ctx->costs[root_idx] * 0.9999f) return;
+
+    treelet.pairs_used = 1;
+    u32 left = treelet.left[full];
+    u32 left_height  = bvh_treelet_emit(ctx, &treelet, left, treelet.pairs[0]);
+    u32 right_height = bvh_treelet_emit(ctx, &treelet, full ^ left, treelet.pairs[0] + 1);
+    ctx->costs[root_idx]   = treelet.cost[full];
+    ctx->heights[root_idx] = (u8)(1 + fast_max(left_height, right_height));
+}
+
+struct BvhBuildTask
+{
+    BvhBuildCtx  *ctx;
+    u32           node;
+    u32           base;
+    u32           depth;
+    volatile u32 *pending;
+};
+
+file_internal void bvh_subdivide(BvhBuildCtx *ctx, u32 node_idx, u32 base, u32 depth);
+
+file_internal void
+bvh_subdivide_task(void *arg)
+{
+    BvhBuildTask *task = (BvhBuildTask*)arg;
+    bvh_subdivide(task->ctx, task->node, task->base, task->depth);
+    PlatformAtomicDec(task->pending);
+}
+
+// A node of n primitives owns the 2n - 2 node slots starting at base for its descendants:
+// its children, then the left child's range, then the right child's. Subtrees never share
+// slots, so they can be built concurrently without allocating from a shared counter.
+file_internal void
+bvh_subdivide(BvhBuildCtx *ctx, u32 node_idx, u32 base, u32 depth)
+{
+    Bvh *bvh = ctx->bvh;
+    BvhNode *node = &bvh->nodes[node_idx];
+
+    // The traversal stack holds at most one entry per level, so deeper nodes become leaves
+    u32 left_count = 0;
+    if (node->count > 1 && depth + 1 < BVH_STACK_SIZE)
+    {
+        left_count = (ctx->builder == BvhBuilder_BinnedSah) ? bvh_split_binned(ctx, node_idx) : bvh_split_morton(ctx, node_idx);
+    }
+
+    // The binned builder needs every node's bounds before splitting it, the Morton splits
+    // do not and get theirs bottom up in linear time
+    bool top_down = ctx->builder == BvhBuilder_BinnedSah;
+
+    if (left_count == 0)
+    {
+        if (!top_down) bvh_update_node_bounds(ctx, node_idx);
+        if (ctx->costs)
+        {
+            ctx->costs[node_idx]   = (r32)node->count * bvh_node_cost_area(ctx, node_idx);
+            ctx->heights[node_idx] = 0;
+        }
+        return;
+    }
+
+    u32 count    = node->count;
+    u32 left_idx = base;
+
+    BvhNode *left  = &bvh->nodes[left_idx];
+    BvhNode *right = &bvh->nodes[left_idx + 1];
+    left->left_first  = node->left_first;
+    left->count       = left_count;
+    right->left_first = node->left_first + left_count;
+    right->count      = count - left_count;
+
+    node->left_first = left_idx;
+    node->count      = 0;
+
+    if (top_down)
+    {
+        bvh_update_node_bounds(ctx, left_idx);
+        bvh_update_node_bounds(ctx, left_idx + 1);
+    }
+
+    u32 left_base  = base + 2;
+    u32 right_base = left_base + 2 * left_count - 2;
+
+    if (count >= BVH_TASK_MIN_PRIMS)
+    {
+        // The left subtree goes to the job system, this thread carries on with the right
+        volatile u32 pending = 1;
+        BvhBuildTask task = { ctx, left_idx, left_base, depth + 1, &pending };
+        PlatformAsyncTask(bvh_subdivide_task, &task);
+        bvh_subdivide(ctx, left_idx + 1, right_base, depth + 1);
+        PlatformAwaitCounter(&pending);
+    }
+    else
+    {
+        bvh_subdivide(ctx, left_idx,     left_base,  depth + 1);
+        bvh_subdivide(ctx, left_idx + 1, right_base, depth + 1);
+    }
+
+    if (!top_down)
+    {
+        node = &bvh->nodes[node_idx];
+        left = &bvh->nodes[left_idx];
+        right = &bvh->nodes[left_idx + 1];
+        Aabb bounds = { left->min, left->max };
+        Aabb right_bounds = { right->min, right->max };
+        aabb_grow(&bounds, &right_bounds);
+        node->min = bounds.min;
+        node->max = bounds.max;
+        if (ctx->end_boxes)
+        {
+            Aabb *end = &bvh->end_bounds[node_idx];
+            *end = bvh->end_bounds[left_idx];
+            aabb_grow(end, &bvh->end_bounds[left_idx + 1]);
+        }
+    }
+
+    if (ctx->costs)
+    {
+        ctx->costs[node_idx] = BVH_TRAVERSAL_COST * bvh_node_cost_area(ctx, node_idx)
+            + ctx->costs[left_idx] + ctx->costs[left_idx + 1];
+        ctx->heights[node_idx] = (u8)(1 + fast_max(ctx->heights[left_idx], ctx->heights[left_idx + 1]));
+        if (count >= BVH_TREELET_MIN_PRIMS) bvh_treelet_optimize(ctx, node_idx, depth);
+    }
+}
+
+// Spreads the low 21 bits of v so there are two zero bits between each of them
+FORCE_INLINE u64
+bvh_morton_expand(u32 v)
+{
+    u64 x = v & 0x1FFFFF;
+    x = (x | x << 32) & 0x1F00000000FFFFull;
+    x = (x | x << 16) & 0x1F0000FF0000FFull;
+    x = (x | x << 8)  & 0x100F00F00F00F00Full;
+    x = (x | x << 4)  & 0x10C30C30C30C30C3ull;
+    x = (x | x << 2)  & 0x1249249249249249ull;
+    return x;
+}
+
+// Sorts prim_indices along a 63 bit Morton curve through the centroids with an LSD radix
+// sort, 11 bits per pass
+file_internal void
+bvh_sort_morton(BvhBuildCtx *ctx, u32 count)
+{
+    Aabb centroid_bounds;
+    aabb_make_empty(&centroid_bounds);
+    for (u32 i = 0; i < count; ++i)
+    {
+        Aabb point = { ctx->centroids[i], ctx->centroids[i] };
+        aabb_grow(&centroid_bounds, &point);
+    }
+
+    const r32 grid = (r32)((1 << 21) - 1);
+    v3 extent = v3_sub(centroid_bounds.max, centroid_bounds.min);
+    v3 scale;
+    for (u32 axis = 0; axis < 3; ++axis)
+    {
+        scale.p[axis] = (extent.p[axis] > 0.0f) ? grid / extent.p[axis] : 0.0f;
+    }
+
+    u64 *codes         = (u64*)PlatformAlloc(sizeof(u64) * 2 * (u64)count);
+    u64 *scratch_codes = codes + count;
+    u32 *indices         = ctx->bvh->prim_indices;
+    u32 *scratch_indices = (u32*)PlatformAlloc(sizeof(u32) * (u64)count);
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 q[3];
+        for (u32 axis = 0; axis < 3; ++axis)
+        {
+            r32 v = (ctx->centroids[i].p[axis] - centroid_bounds.min.p[axis]) * scale.p[axis];
+            q[axis] = (u32)fminf(fmaxf(v, 0.0f), grid);
+        }
+        codes[i] = (bvh_morton_expand(q[0]) << 2) | (bvh_morton_expand(q[1]) << 1) | bvh_morton_expand(q[2]);
+    }
+
+    // Six passes, an even number, so the result ends up back in codes and indices
+    const u32 radix_bits = 11;
+    const u32 radix_size = 1 << radix_bits;
+    u32 *offsets = (u32*)PlatformAlloc(sizeof(u32) * radix_size);
+    for (u32 shift = 0; shift < 64; shift += radix_bits)
+    {
+        memset(offsets, 0, sizeof(u32) * radix_size);
+        for (u32 i = 0; i < count; ++i) offsets[(codes[i] >> shift) & (radix_size - 1)]++;
+
+        u32 sum = 0;
+        for (u32 d = 0; d < radix_size; ++d)
+        {
+            u32 digit_count = offsets[d];
+            offsets[d] = sum;
+            sum += digit_count;
+        }
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            u32 dst = offsets[(codes[i] >> shift) & (radix_size - 1)]++;
+            scratch_codes[dst]   = codes[i];
+            scratch_indices[dst] = indices[i];
+        }
+
+        u64 *tmp_codes = codes;     codes   = scratch_codes;   scratch_codes   = tmp_codes;
+        u32 *tmp_idx   = indices;   indices = scratch_indices; scratch_indices = tmp_idx;
+    }
+
+    PlatformFree(offsets);
+    PlatformFree(scratch_indices);
+    ctx->morton = codes;
+}
+
+// Renumbers the nodes in depth first order, children allocated as their parent is
+// visited. That closes the slots left unused by subtrees that ended early and gives the
+// layout of a serial recursive build, whichever order the tasks ran in.
+file_internal void
+bvh_compact(Bvh *bvh, BvhNode *src_nodes, Aabb *src_end_bounds, u32 src_idx, u32 dst_idx)
+{
+    BvhNode *node = &bvh->nodes[dst_idx];
+    *node = src_nodes[src_idx];
+    if (src_end_bounds) bvh->end_bounds[dst_idx] = src_end_bounds[src_idx];
+    if (node->count > 0) return;
+
+    u32 src_left = node->left_first;
+    u32 dst_left = bvh->nodes_count;
+    bvh->nodes_count += 2;
+    node->left_first = dst_left;
+
+    bvh_compact(bvh, src_nodes, src_end_bounds, src_left,     dst_left);
+    bvh_compact(bvh, src_nodes, src_end_bounds, src_left + 1, dst_left + 1);
+}
+
+// end_boxes may be null, otherwise boxes and end_boxes are the primitive bounds at the
+// start and end of the shutter and a motion tree is built
+file_internal void
+bvh_build_boxes(Bvh *bvh, Aabb *boxes, Aabb *end_boxes, u32 count, BvhBuilder builder)
+{
+    // A binary tree with N leaves has at most 2N - 1 nodes
+    u64 max_nodes = 2 * (u64)count - 1;
+    bvh->nodes        = (BvhNode*)PlatformAlloc(sizeof(BvhNode) * max_nodes);
+    bvh->prim_indices = (u32*)PlatformAlloc(sizeof(u32) * (u64)count);
+    bvh->prim_count   = count;
+    if (end_boxes) bvh->end_bounds = (Aabb*)PlatformAlloc(sizeof(Aabb) * max_nodes);
+
+    BvhBuildCtx ctx{};
+    ctx.bvh       = bvh;
+    ctx.boxes     = boxes;
+    ctx.end_boxes = end_boxes;
+    ctx.centroids = (v3*)PlatformAlloc(sizeof(v3) * (u64)count);
+    ctx.builder   = builder;
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        v3 centroid = v3_mulf(v3_add(boxes[i].min, boxes[i].max), 0.5f);
+        if (end_boxes)
+        {
+            v3 end_centroid = v3_mulf(v3_add(end_boxes[i].min, end_boxes[i].max), 0.5f);
+            centroid = v3_mulf(v3_add(centroid, end_centroid), 0.5f);
+        }
+        ctx.centroids[i] = centroid;
+        bvh->prim_indices[i] = i;
+    }
+
+    if (builder != BvhBuilder_BinnedSah) bvh_sort_morton(&ctx, count);
+    if (builder == BvhBuilder_LbvhTreelet)
+    {
+        ctx.costs   = (r32*)PlatformAlloc(sizeof(r32) * max_nodes);
+        ctx.heights = (u8*)PlatformAlloc(max_nodes);
+    }
+
+    BvhNode *root = &bvh->nodes[0];
+    root->left_first = 0;
+    root->count      = count;
+
+    if (builder == BvhBuilder_BinnedSah) bvh_update_node_bounds(&ctx, 0);
+    bvh_subdivide(&ctx, 0, 1, 0);
+
+    BvhNode *sparse_nodes = bvh->nodes;
+    Aabb *sparse_end_bounds = bvh->end_bounds;
+    bvh->nodes = (BvhNode*)PlatformAlloc(sizeof(BvhNode) * max_nodes);
+    if (end_boxes) bvh->end_bounds = (Aabb*)PlatformAlloc(sizeof(Aabb) * max_nodes);
+    bvh->nodes_count = 1;
+    bvh_compact(bvh, sparse_nodes, sparse_end_bounds, 0, 0);
+
+    PlatformFree(sparse_nodes);
+    if (sparse_end_bounds) PlatformFree(sparse_end_bounds);
+    if (ctx.morton) PlatformFree(ctx.morton);
+    if (ctx.costs)   PlatformFree(ctx.costs);
+    if (ctx.heights) PlatformFree(ctx.heights);
+    PlatformFree(ctx.centroids);
+}
+
+file_internal void
+bvh_build_from_boxes(Bvh *bvh, Aabb *boxes, u32 count, BvhBuilder builder)
+{
+    memset(bvh, 0, sizeof(Bvh));
+    if (count == 0) return;
+
+    bvh_build_boxes(bvh, boxes, 0, count, builder);
+}
+
+file_internal void
+bvh_build(Bvh *bvh, Primitive *primitives, u32 count, r32 t0, r32 t1, BvhBuilder builder)
+{
+    memset(bvh, 0, sizeof(Bvh));
+    if (count == 0) return;
+
+    Aabb *boxes = (Aabb*)PlatformAlloc(sizeof(Aabb) * (u64)count);
+    Aabb *end_boxes = 0;
+
+    if (t1 > t0)
+    {
+        // Bounds at both ends of the shutter, the tree only needs them if something moves
+        end_boxes = (Aabb*)PlatformAlloc(sizeof(Aabb) * (u64)count);
+
+        bool moving = false;
+        for (u32 i = 0; i < count; ++i)
+        {
+            build_aabb_primitive(&boxes[i],     &primitives[i], t0, t0);
+            build_aabb_primitive(&end_boxes[i], &primitives[i], t1, t1);
+            if (memcmp(&boxes[i], &end_boxes[i], sizeof(Aabb)) != 0) moving = true;
+        }
+
+        if (!moving)
+        {
+            PlatformFree(end_boxes);
+            end_boxes = 0;
+        }
+    }
+    else
+    {
+        for (u32 i = 0; i < count; ++i)
+        {
+            build_aabb_primitive(&boxes[i], &primitives[i], t0, t1);
+        }
+    }
+
+    bvh_build_boxes(bvh, boxes, end_boxes, count, builder);
+    if (end_boxes)
+    {
+        bvh->time0        = t0;
+        bvh->inv_duration = 1.0f / (t1 - t0);
+        PlatformFree(end_boxes);
+    }
+    PlatformFree(boxes);
+
+    bvh_set_simd_level(bvh, primitives, simd_detect_level());
+}
+
+file_internal void
+bvh_free(Bvh *bvh)
+{
+    bvh_set_simd_level(bvh, 0, SimdLevel_Scalar);
+    if (bvh->nodes)        PlatformFree(bvh->nodes);
+    if (bvh->prim_indices) PlatformFree(bvh->prim_indices);
+    if (bvh->end_bounds)   PlatformFree(bvh->end_bounds);
+    memset(bvh, 0, sizeof(Bvh));
+}
+
+file_internal r32
+bvh_sah_cost(Bvh *bvh)
+{
+    if (bvh->nodes_count == 0) return 0.0f;
+
+    r64 cost = 0.0;
+    for (u32 i = 0; i < bvh->nodes_count; ++i)
+    {
+        BvhNode *node = &bvh->nodes[i];
+        Aabb box = { node->min, node->max };
+        r32 area = bvh->end_bounds ? bvh_swept_area(&box, &bvh->end_bounds[i]) : aabb_surface_area(&box);
+        cost += (r64)area * ((node->count > 0) ? (r64)node->count : (r64)BVH_TRAVERSAL_COST);
+    }
+
+    Aabb root = { bvh->nodes[0].min, bvh->nodes[0].max };
+    r32 root_area = bvh->end_bounds ? bvh_swept_area(&root, &bvh->end_bounds[0]) : aabb_surface_area(&root);
+    return (root_area > 0.0f) ? (r32)(cost / root_area) : 0.0f;
+}
+
+file_internal const char*
+bvh_builder_name(BvhBuilder builder)
+{
+    switch (builder)
+    {
+        case BvhBuilder_Lbvh:        return "LBVH";
+        case BvhBuilder_LbvhTreelet: return "LBVH + treelets";
+        default:                     return "binned SAH";
+    }
+}
+
+struct BvhStackEntry
+{
+    u32 node;
+    r32 dist; // entry distance, used to skip nodes behind the closest hit
+};
+
+// Fraction of the shutter interval at the ray's time, the lerp weight for end_bounds
+FORCE_INLINE r32
+bvh_time_weight(Bvh *bvh, Ray *ray)
+{
+    return (ray->time - bvh->time0) * bvh->inv_duration;
+}
+
+template<bool Motion> FORCE_INLINE r32
+bvh_intersect_node(Bvh *bvh, u32 node_idx, v3 orig, v3 inv_dir, r32 time_weight, r32 tmin, r32 tmax)
+{
+    BvhNode *node = &bvh->nodes[node_idx];
+    if (!Motion)
+    {
+        return intersect_ray_aabb_dist(orig, inv_dir, node->min, node->max, tmin, tmax);
+    }
+
+    Aabb *end = &bvh->end_bounds[node_idx];
+    v3 min = v3_add(node->min, v3_mulf(v3_sub(end->min, node->min), time_weight));
+    v3 max = v3_add(node->max, v3_mulf(v3_sub(end->max, node->max), time_weight));
+    return intersect_ray_aabb_dist(orig, inv_dir, min, max, tmin, tmax);
+}
+
+template<bool Motion, bool AnyHit, typename LeafFn> FORCE_INLINE bool
+bvh_traverse_nodes(Bvh *bvh, Ray *ray, r32 tmin, r32 *tmax, LeafFn leaf_fn)
+{
+    BvhNode *nodes = bvh->nodes;
+    v3 inv_dir = { 1.0f / ray->dir.x, 1.0f / ray->dir.y, 1.0f / ray->dir.z };
+    r32 time_weight = Motion ? bvh_time_weight(bvh, ray) : 0.0f;
+
+    if (bvh_intersect_node<Motion>(bvh, 0, ray->orig, inv_dir, time_weight, tmin, *tmax) == R32_MAX)
+    {
+        return false;
+    }
+
+    BvhStackEntry stack[BVH_STACK_SIZE];
+    u32 stack_ptr = 0;
+    u32 node_idx  = 0;
+    bool hit_anything = false;
+
+    for (;;)
+    {
+        BvhNode *node = &nodes[node_idx];
+        if (node->count > 0)
+        {
+            u32 *indices = bvh->prim_indices + node->left_first;
+            for (u32 i = 0; i < node->count; ++i)
+            {
+                if (leaf_fn(indices[i], tmax))
+                {
+                    if (AnyHit) return true;
+                    hit_anything = true;
+                }
+            }
+        }
+        else
+        {
+            u32 near_idx = node->left_first;
+            u32 far_idx  = near_idx + 1;
+            r32 near_dist = bvh_intersect_node<Motion>(bvh, near_idx, ray->orig, inv_dir, time_weight, tmin, *tmax);
+            r32 far_dist  = bvh_intersect_node<Motion>(bvh, far_idx,  ray->orig, inv_dir, time_weight, tmin, *tmax);
+
+            if (far_dist < near_dist)
+            {
+                fast_swapf(near_dist, far_dist);
+                u32 tmp = near_idx;
+                near_idx = far_idx;
+                far_idx  = tmp;
+            }
+
+            if (near_dist != R32_MAX)
+            {
+                if (far_dist != R32_MAX)
+                {
+                    stack[stack_ptr].node = far_idx;
+                    stack[stack_ptr].dist = far_dist;
+                    ++stack_ptr;
+                }
+                node_idx = near_idx;
+                continue;
+            }
+        }
+
+        // Pop the next node, skipping any that begin beyond the closest hit found so far
+        for (;;)
+        {
+            if (stack_ptr == 0) return hit_anything;
+            --stack_ptr;
+            if (stack[stack_ptr].dist < *tmax)
+            {
+                node_idx = stack[stack_ptr].node;
+                break;
+            }
+        }
+    }
+}
+
+// Closest hit traversal of the binary tree. leaf_fn(prim, tmax) tests one primitive index
+// and returns true if it found a closer hit, in which case it has also lowered *tmax.
+// With AnyHit the walk ends at the first leaf_fn that reports a hit.
+template<bool AnyHit = false, typename LeafFn> FORCE_INLINE bool
+bvh_traverse(Bvh *bvh, Ray *ray, r32 tmin, r32 *tmax, LeafFn leaf_fn)
+{
+    if (bvh->nodes_count == 0) return false;
+
+    if (bvh->end_bounds) return bvh_traverse_nodes<true, AnyHit>(bvh, ray, tmin, tmax, leaf_fn);
+    else                 return bvh_traverse_nodes<false, AnyHit>(bvh, ray, tmin, tmax, leaf_fn);
+}
+
+file_internal bool
+intersect_ray_bvh_scalar(Hit *hit, Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 *tmax)
+{
+    return bvh_traverse(bvh, ray, tmin, tmax, [&](u32 prim, r32 *closest) {
+        return intersect_ray_primitive(hit, ray, primitives, prim, tmin, closest);
+    });
+}
+
+file_internal bool
+intersect_ray_bvh(Hit *hit, Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 *tmax)
+{
+    switch (bvh->simd_level)
+    {
+        case SimdLevel_AVX2: return intersect_ray_bvh8(hit, ray, bvh, primitives, tmin, tmax);
+        case SimdLevel_SSE:  return intersect_ray_bvh4(hit, ray, bvh, primitives, tmin, tmax);
+        default:             return intersect_ray_bvh_scalar(hit, ray, bvh, primitives, tmin, tmax);
+    }
+}
+
+file_internal bool
+intersect_ray_bvh_any(Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 tmax)
+{
+    switch (bvh->simd_level)
+    {
+        case SimdLevel_AVX2: return intersect_ray_bvh8_any(ray, bvh, primitives, tmin, tmax);
+        case SimdLevel_SSE:  return intersect_ray_bvh4_any(ray, bvh, primitives, tmin, tmax);
+        default: break;
+    }
+
+    Hit hit;
+    return bvh_traverse<true>(bvh, ray, tmin, &tmax, [&](u32 prim, r32 *closest) {
+        return intersect_ray_primitive(&hit, ray, primitives, prim, tmin, closest);
+    });
+}
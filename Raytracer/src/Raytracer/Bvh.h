@@ -0,0 +1,84 @@
+#ifndef _RAYTRACER_BVH_H
+#define _RAYTRACER_BVH_H
+
+constexpr u32 BVH_BIN_COUNT         = 16;   // SAH bins per axis
+constexpr u32 BVH_MAX_LEAF_SIZE     = 4;    // largest leaf the SAH is allowed to keep
+constexpr u32 BVH_STACK_SIZE        = 64;   // traversal stack depth, also bounds the tree depth
+constexpr r32 BVH_TRAVERSAL_COST    = 1.0f; // cost of visiting a node relative to one primitive test
+constexpr u32 BVH_TASK_MIN_PRIMS    = 4096; // smaller subtrees are built serially by the task that reaches them
+constexpr u32 BVH_TREELET_LEAVES    = 7;    // leaves of a restructured treelet, the search is 3^n
+constexpr u32 BVH_TREELET_MIN_PRIMS = 32;   // treelets are only formed over subtrees this large
+
+enum BvhBuilder
+{
+    BvhBuilder_BinnedSah,   // top down binned SAH, the cheapest trees to trace
+    BvhBuilder_Lbvh,        // splits at the Morton code bits, linear time after the sort
+    BvhBuilder_LbvhTreelet, // LBVH, then every treelet restructured to its optimal SAH topology
+
+    BvhBuilder_Count,
+};
+
+// A flattened BVH node. Interior nodes store the index of their left child, the right child
+// always directly follows it in the node array. Leaves store a range into Bvh::prim_indices.
+struct alignas(32) BvhNode
+{
+    v3  min;
+    u32 left_first; // interior: left child index, leaf: first index into prim_indices
+    v3  max;
+    u32 count;      // 0 for interior nodes, otherwise number of primitives in the leaf
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode should fit in half a cache line");
+
+struct Bvh
+{
+    BvhNode   *nodes;
+    u32       *prim_indices; // primitive indices, reordered so each leaf is a contiguous range
+    u32        nodes_count;
+    u32        prim_count;
+    
+    // Motion trees: nodes hold their bounds at shutter open, end_bounds at shutter close.
+    // Primitives move linearly, so a node is tested against the two boxes lerped by the
+    // ray's time. Null when nothing in the tree moves.
+    Aabb      *end_bounds;
+    r32        time0;
+    r32        inv_duration; // 1 / (time1 - time0)
+    
+    // Wide copy of the tree consumed by the SIMD kernels (see BvhSimd.cpp)
+    SimdLevel  simd_level;
+    void      *wide_nodes;
+    void      *wide_deltas; // BvhWideDeltas per wide node, motion trees only
+    u32        wide_nodes_count;
+    BvhSpheres spheres;
+};
+
+// Builds the tree over the shutter interval [t0, t1] and selects the widest traversal
+// kernel the CPU supports. If any primitive moves within the interval a motion tree is built.
+// Subtrees of BVH_TASK_MIN_PRIMS or more are built as tasks on the job system, the node
+// layout does not depend on how the tasks were scheduled.
+file_internal void bvh_build(Bvh *bvh, struct Primitive *primitives, u32 count, r32 t0, r32 t1,
+                             BvhBuilder builder = BvhBuilder_BinnedSah);
+// Builds only the binary tree over caller provided bounds, e.g. the triangles of a mesh.
+// The boxes are not kept.
+file_internal void bvh_build_from_boxes(Bvh *bvh, Aabb *boxes, u32 count, BvhBuilder builder = BvhBuilder_BinnedSah);
+file_internal void bvh_free(Bvh *bvh);
+// Expected cost of tracing a ray that hits the root box, in primitive tests. Motion trees
+// use the mean area over the shutter.
+file_internal r32  bvh_sah_cost(Bvh *bvh);
+file_internal const char* bvh_builder_name(BvhBuilder builder);
+// Rebuilds the wide node/leaf data for the requested kernel. SimdLevel_Scalar frees it.
+file_internal void bvh_set_simd_level(Bvh *bvh, struct Primitive *primitives, SimdLevel level);
+
+file_internal bool intersect_ray_bvh(Hit              *hit,
+                                     struct Ray       *ray,
+                                     Bvh              *bvh,
+                                     struct Primitive *primitives,
+                                     r32               tmin,
+                                     r32              *tmax);
+// True if anything is hit within [tmin, tmax], stops at the first hit found
+file_internal bool intersect_ray_bvh_any(struct Ray       *ray,
+                                         Bvh              *bvh,
+                                         struct Primitive *primitives,
+                                         r32               tmin,
+                                         r32               tmax);
+
+#endif //_RAYTRACER_BVH_H
@@ -0,0 +1,582 @@
+
+// Every wide node pushes at most W - 1 children and the wide tree is never deeper than
+// the binary tree it was collapsed from.
+constexpr u32 BVH_WIDE_STACK_SIZE = BVH_STACK_SIZE * 7;
+
+file_internal SimdLevel
+simd_detect_level()
+{
+#if defined(_WIN32)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    bool has_sse2    = (info[3] & (1 << 26)) != 0;
+    bool has_avx     = (info[2] & (1 << 28)) != 0;
+    bool has_osxsave = (info[2] & (1 << 27)) != 0;
+
+    bool has_avx2 = false;
+    if (max_leaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        has_avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    // The OS has to save the YMM registers on a context switch before AVX is usable
+    bool os_ymm = has_osxsave && ((_xgetbv(0) & 0x6) == 0x6);
+
+    if (has_avx && has_avx2 && os_ymm) return SimdLevel_AVX2;
+    if (has_sse2)                      return SimdLevel_SSE;
+    return SimdLevel_Scalar;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))   return SimdLevel_AVX2;
+    if (__builtin_cpu_supports("sse2")  ) return SimdLevel_SSE;
+    return SimdLevel_Scalar;
+#endif
+}
+
+file_internal const char*
+simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel_AVX2: return "AVX2 (BVH8)";
+        case SimdLevel_SSE:  return "SSE (BVH4)";
+        default:             return "Scalar (BVH2)";
+    }
+}
+
+// Collapses the binary subtree rooted at src_idx into a W-wide node. The binary node's
+// children are gathered, then the interior entry with the largest surface area is
+// repeatedly replaced by its two children until all W slots are in use.
+template<typename NodeT, u32 W> file_internal u32
+bvh_collapse_node(Bvh *bvh, NodeT *wide_nodes, BvhWideDeltas<W> *deltas, u32 src_idx)
+{
+    u32 slots[W];
+    u32 used = 1;
+    slots[0] = src_idx;
+
+    while (used < W)
+    {
+        i32 best = -1;
+        r32 best_area = -1.0f;
+        for (u32 i = 0; i < used; ++i)
+        {
+            BvhNode *node = &bvh->nodes[slots[i]];
+            if (node->count == 0 && bvh_node_area(node) > best_area)
+            {
+                best_area = bvh_node_area(node);
+                best = (i32)i;
+            }
+        }
+        if (best < 0) break;
+
+        u32 left = bvh->nodes[slots[best]].left_first;
+        slots[best]   = left;
+        slots[used++] = left + 1;
+    }
+
+    u32 wide_idx = bvh->wide_nodes_count++;
+    NodeT *wide = &wide_nodes[wide_idx];
+
+    for (u32 i = 0; i < W; ++i)
+    {
+        if (i < used)
+        {
+            BvhNode *node = &bvh->nodes[slots[i]];
+            wide->min_x[i] = node->min.x;
+            wide->min_y[i] = node->min.y;
+            wide->min_z[i] = node->min.z;
+            wide->max_x[i] = node->max.x;
+            wide->max_y[i] = node->max.y;
+            wide->max_z[i] = node->max.z;
+            wide->count[i] = node->count;
+            wide->child[i] = (node->count > 0) ? node->left_first : 0;
+
+            if (deltas)
+            {
+                Aabb *end = &bvh->end_bounds[slots[i]];
+                r32 *delta = deltas[wide_idx].planes;
+                delta[0 * W + i] = end->min.x - node->min.x;
+                delta[1 * W + i] = end->min.y - node->min.y;
+                delta[2 * W + i] = end->min.z - node->min.z;
+                delta[3 * W + i] = end->max.x - node->max.x;
+                delta[4 * W + i] = end->max.y - node->max.y;
+                delta[5 * W + i] = end->max.z - node->max.z;
+            }
+        }
+        else
+        {
+            // An inverted infinite box, missed by every ray whichever direction it takes
+            wide->min_x[i] = wide->min_y[i] = wide->min_z[i] =  INFINITY;
+            wide->max_x[i] = wide->max_y[i] = wide->max_z[i] = -INFINITY;
+            wide->count[i] = 0;
+            wide->child[i] = 0;
+
+            if (deltas)
+            {
+                for (u32 p = 0; p < 6; ++p) deltas[wide_idx].planes[p * W + i] = 0.0f;
+            }
+        }
+    }
+
+    // Recurse after the slots are written so each node's children follow it in memory
+    for (u32 i = 0; i < used; ++i)
+    {
+        BvhNode *node = &bvh->nodes[slots[i]];
+        if (node->count == 0)
+        {
+            wide_nodes[wide_idx].child[i] = bvh_collapse_node<NodeT, W>(bvh, wide_nodes, deltas, slots[i]);
+        }
+    }
+
+    return wide_idx;
+}
+
+template<typename NodeT, u32 W> file_internal void
+bvh_build_wide(Bvh *bvh)
+{
+    // A wide node consumes at least one binary interior node, except for a leaf root
+    u64 max_nodes = (bvh->nodes_count + 1) / 2 + 1;
+    NodeT *wide_nodes = (NodeT*)PlatformAlloc(sizeof(NodeT) * max_nodes);
+
+    BvhWideDeltas<W> *deltas = 0;
+    if (bvh->end_bounds) deltas = (BvhWideDeltas<W>*)PlatformAlloc(sizeof(BvhWideDeltas<W>) * max_nodes);
+
+    bvh->wide_nodes_count = 0;
+    bvh_collapse_node<NodeT, W>(bvh, wide_nodes, deltas, 0);
+    bvh->wide_nodes  = wide_nodes;
+    bvh->wide_deltas = deltas;
+}
+
+// Entries per BvhSpheres array, rounded up so every array starts on a 32 byte boundary
+FORCE_INLINE u64
+bvh_spheres_stride(u32 prim_count)
+{
+    return ((u64)prim_count + 8 + 7) & ~7ull;
+}
+
+file_internal void
+bvh_build_spheres(Bvh *bvh, Primitive *primitives)
+{
+    u64 stride = bvh_spheres_stride(bvh->prim_count);
+    r32 *block = (r32*)PlatformAlloc(sizeof(r32) * stride * 4);
+
+    BvhSpheres *spheres = &bvh->spheres;
+    spheres->x         = block;
+    spheres->y         = block + stride;
+    spheres->z         = block + stride * 2;
+    spheres->radius_sq = block + stride * 3;
+
+    for (u32 i = 0; i < bvh->prim_count; ++i)
+    {
+        Primitive *prim = &primitives[bvh->prim_indices[i]];
+        if (prim->type == Primitive_Sphere)
+        {
+            spheres->x[i]         = prim->sphere.origin.x;
+            spheres->y[i]         = prim->sphere.origin.y;
+            spheres->z[i]         = prim->sphere.origin.z;
+            spheres->radius_sq[i] = prim->sphere.radius * prim->sphere.radius;
+        }
+        else
+        {
+            spheres->radius_sq[i] = -1.0f;
+        }
+    }
+}
+
+file_internal void
+bvh_set_simd_level(Bvh *bvh, Primitive *primitives, SimdLevel level)
+{
+    if (bvh->wide_nodes)  PlatformFree(bvh->wide_nodes);
+    if (bvh->wide_deltas) PlatformFree(bvh->wide_deltas);
+    if (bvh->spheres.x)   PlatformFree(bvh->spheres.x);
+    bvh->wide_nodes       = 0;
+    bvh->wide_deltas      = 0;
+    bvh->wide_nodes_count = 0;
+    memset(&bvh->spheres, 0, sizeof(BvhSpheres));
+    bvh->simd_level = SimdLevel_Scalar;
+
+    if (level == SimdLevel_Scalar || bvh->nodes_count == 0) return;
+
+    if (level == SimdLevel_AVX2) bvh_build_wide<Bvh8Node, 8>(bvh);
+    else                         bvh_build_wide<Bvh4Node, 4>(bvh);
+
+    bvh_build_spheres(bvh, primitives);
+    bvh->simd_level = level;
+}
+
+struct BvhWideStackEntry
+{
+    u32 child;
+    u32 count; // 0 for a wide node, otherwise a leaf range starting at child
+    r32 dist;
+};
+
+// Pushes the hit children of a node so the nearest one ends up on top of the stack
+FORCE_INLINE void
+bvh_push_sorted(BvhWideStackEntry *stack, u32 *stack_ptr, u32 *child, u32 *count, r32 *dist, u32 mask)
+{
+    u32 base = *stack_ptr;
+    u32 top  = base;
+    while (mask)
+    {
+        u32 lane = simd_first_lane(mask);
+        mask &= mask - 1;
+
+        // Insertion sort, farthest entries stay at the bottom
+        u32 j = top++;
+        while (j > base && stack[j - 1].dist < dist[lane])
+        {
+            stack[j] = stack[j - 1];
+            --j;
+        }
+        stack[j].child = child[lane];
+        stack[j].count = count[lane];
+        stack[j].dist  = dist[lane];
+    }
+    *stack_ptr = top;
+}
+
+// Tests up to four leaf spheres at once and records the closest hit. Primitives the
+// kernel cannot handle are returned in the mask for the scalar path.
+FORCE_INLINE u32
+intersect_ray_spheres4(Ray *ray, BvhSpheres *spheres, u32 first, u32 count, r32 tmin, r32 tmax,
+                       r32 *out_t, u32 *out_lane)
+{
+    __m128 ox = _mm_set1_ps(ray->orig.x), oy = _mm_set1_ps(ray->orig.y), oz = _mm_set1_ps(ray->orig.z);
+    __m128 dx = _mm_set1_ps(ray->dir.x),  dy = _mm_set1_ps(ray->dir.y),  dz = _mm_set1_ps(ray->dir.z);
+
+    __m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(spheres->x + first));
+    __m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(spheres->y + first));
+    __m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(spheres->z + first));
+    __m128 rsq = _mm_loadu_ps(spheres->radius_sq + first);
+
+    r32 a = v3_mag_sq(ray->dir);
+    __m128 A = _mm_set1_ps(a);
+    __m128 B = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+    __m128 C = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)), rsq);
+    __m128 disc = _mm_sub_ps(_mm_mul_ps(B, B), _mm_mul_ps(A, C));
+
+    __m128 root = _mm_sqrt_ps(_mm_max_ps(disc, _mm_setzero_ps()));
+    __m128 t0 = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), B), root), A);
+    __m128 t1 = _mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_setzero_ps(), B), root), A);
+
+    __m128 vmin = _mm_set1_ps(tmin), vmax = _mm_set1_ps(tmax);
+    __m128 t0_ok = _mm_and_ps(_mm_cmplt_ps(t0, vmax), _mm_cmpgt_ps(t0, vmin));
+    __m128 t1_ok = _mm_and_ps(_mm_cmplt_ps(t1, vmax), _mm_cmpgt_ps(t1, vmin));
+    __m128 t = _mm_or_ps(_mm_and_ps(t0_ok, t0), _mm_andnot_ps(t0_ok, t1));
+
+    u32 lanes   = (1u << count) - 1;
+    u32 dynamic = (u32)_mm_movemask_ps(_mm_cmplt_ps(rsq, _mm_setzero_ps())) & lanes;
+    u32 hits    = (u32)_mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(disc, _mm_setzero_ps()), _mm_or_ps(t0_ok, t1_ok)));
+    hits &= lanes & ~dynamic;
+
+    alignas(16) r32 ts[4];
+    _mm_store_ps(ts, t);
+    while (hits)
+    {
+        u32 lane = simd_first_lane(hits);
+        hits &= hits - 1;
+        if (ts[lane] < *out_t)
+        {
+            *out_t    = ts[lane];
+            *out_lane = first + lane;
+        }
+    }
+
+    return dynamic;
+}
+
+file_internal bool
+intersect_ray_bvh_leaf4(Hit *hit, Ray *ray, Bvh *bvh, Primitive *primitives,
+                        u32 first, u32 count, r32 tmin, r32 *tmax)
+{
+    bool hit_anything = false;
+    for (u32 start = first; start < first + count; start += 4)
+    {
+        u32 lanes = (first + count) - start;
+        if (lanes > 4) lanes = 4;
+
+        r32 best_t = *tmax;
+        u32 best   = U32_MAX;
+        u32 dynamic = intersect_ray_spheres4(ray, &bvh->spheres, start, lanes, tmin, *tmax, &best_t, &best);
+        if (best != U32_MAX)
+        {
+            hit->t         = best_t;
+            hit->primitive = bvh->prim_indices[best];
+            *tmax = best_t;
+            hit_anything = true;
+        }
+
+        while (dynamic)
+        {
+            u32 lane = simd_first_lane(dynamic);
+            dynamic &= dynamic - 1;
+            if (intersect_ray_primitive(hit, ray, primitives, bvh->prim_indices[start + lane], tmin, tmax))
+                hit_anything = true;
+        }
+    }
+    return hit_anything;
+}
+
+// Loads one bound plane of a node's children, moved to the ray's time for motion trees
+template<bool Motion> FORCE_INLINE __m128
+bvh4_load_plane(r32 *planes, r32 *deltas, u32 offset, __m128 time_weight)
+{
+    __m128 plane = _mm_load_ps(planes + offset);
+    if (Motion) plane = _mm_add_ps(plane, _mm_mul_ps(_mm_load_ps(deltas + offset), time_weight));
+    return plane;
+}
+
+// AnyHit stops at the first hit within [tmin, *tmax], for shadow rays that only need to
+// know whether something is in the way
+template<bool Motion, bool AnyHit> file_internal bool
+intersect_ray_bvh4_nodes(Hit *hit, Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 *tmax)
+{
+    Bvh4Node *nodes = (Bvh4Node*)bvh->wide_nodes;
+    BvhWideDeltas<4> *deltas = (BvhWideDeltas<4>*)bvh->wide_deltas;
+    __m128 time_weight = _mm_set1_ps(Motion ? bvh_time_weight(bvh, ray) : 0.0f);
+
+    __m128 ox = _mm_set1_ps(ray->orig.x), oy = _mm_set1_ps(ray->orig.y), oz = _mm_set1_ps(ray->orig.z);
+    v3 inv_dir = { 1.0f / ray->dir.x, 1.0f / ray->dir.y, 1.0f / ray->dir.z };
+    __m128 ix = _mm_set1_ps(inv_dir.x);
+    __m128 iy = _mm_set1_ps(inv_dir.y);
+    __m128 iz = _mm_set1_ps(inv_dir.z);
+    __m128 vmin = _mm_set1_ps(tmin);
+    __m128 exit_scale = _mm_set1_ps(AABB_EXIT_SCALE);
+
+    // Select the near and far planes once per ray from the direction signs. Max planes
+    // sit 3 * W floats after their min counterparts. The reciprocal is tested so -0 counts
+    // as a negative direction.
+    u32 near_x = (inv_dir.x >= 0.0f) ? 0 : 12, far_x = 12 - near_x;
+    u32 near_y = (inv_dir.y >= 0.0f) ? 4 : 16, far_y = 20 - near_y;
+    u32 near_z = (inv_dir.z >= 0.0f) ? 8 : 20, far_z = 28 - near_z;
+
+    BvhWideStackEntry stack[BVH_WIDE_STACK_SIZE];
+    u32 stack_ptr = 1;
+    stack[0] = { 0, 0, tmin };
+
+    bool hit_anything = false;
+    while (stack_ptr > 0)
+    {
+        BvhWideStackEntry entry = stack[--stack_ptr];
+        if (entry.dist >= *tmax) continue;
+
+        if (entry.count > 0)
+        {
+            if (intersect_ray_bvh_leaf4(hit, ray, bvh, primitives, entry.child, entry.count, tmin, tmax))
+            {
+                if (AnyHit) return true;
+                hit_anything = true;
+            }
+            continue;
+        }
+
+        Bvh4Node *node = &nodes[entry.child];
+        r32 *planes = node->min_x;
+        r32 *moves  = Motion ? deltas[entry.child].planes : 0;
+
+        __m128 tnx = _mm_mul_ps(_mm_sub_ps(bvh4_load_plane<Motion>(planes, moves, near_x, time_weight), ox), ix);
+        __m128 tny = _mm_mul_ps(_mm_sub_ps(bvh4_load_plane<Motion>(planes, moves, near_y, time_weight), oy), iy);
+        __m128 tnz = _mm_mul_ps(_mm_sub_ps(bvh4_load_plane<Motion>(planes, moves, near_z, time_weight), oz), iz);
+        __m128 tfx = _mm_mul_ps(_mm_sub_ps(bvh4_load_plane<Motion>(planes, moves, far_x,  time_weight), ox), ix);
+        __m128 tfy = _mm_mul_ps(_mm_sub_ps(bvh4_load_plane<Motion>(planes, moves, far_y,  time_weight), oy), iy);
+        __m128 tfz = _mm_mul_ps(_mm_sub_ps(bvh4_load_plane<Motion>(planes, moves, far_z,  time_weight), oz), iz);
+
+        __m128 t_enter = _mm_max_ps(_mm_max_ps(tnx, tny), _mm_max_ps(tnz, vmin));
+        __m128 t_exit  = _mm_mul_ps(_mm_min_ps(_mm_min_ps(tfx, tfy), tfz), exit_scale);
+        t_exit = _mm_min_ps(t_exit, _mm_set1_ps(*tmax));
+        u32 mask = (u32)_mm_movemask_ps(_mm_cmple_ps(t_enter, t_exit));
+
+        alignas(16) r32 dist[4];
+        _mm_store_ps(dist, t_enter);
+        bvh_push_sorted(stack, &stack_ptr, node->child, node->count, dist, mask);
+    }
+
+    return hit_anything;
+}
+
+file_internal bool
+intersect_ray_bvh4(Hit *hit, Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 *tmax)
+{
+    if (bvh->wide_deltas) return intersect_ray_bvh4_nodes<true, false>(hit, ray, bvh, primitives, tmin, tmax);
+    else                  return intersect_ray_bvh4_nodes<false, false>(hit, ray, bvh, primitives, tmin, tmax);
+}
+
+file_internal bool
+intersect_ray_bvh4_any(Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 tmax)
+{
+    Hit hit;
+    if (bvh->wide_deltas) return intersect_ray_bvh4_nodes<true, true>(&hit, ray, bvh, primitives, tmin, &tmax);
+    else                  return intersect_ray_bvh4_nodes<false, true>(&hit, ray, bvh, primitives, tmin, &tmax);
+}
+
+RT_TARGET_AVX2 FORCE_INLINE u32
+intersect_ray_spheres8(Ray *ray, BvhSpheres *spheres, u32 first, u32 count, r32 tmin, r32 tmax,
+                       r32 *out_t, u32 *out_lane)
+{
+    __m256 ox = _mm256_set1_ps(ray->orig.x), oy = _mm256_set1_ps(ray->orig.y), oz = _mm256_set1_ps(ray->orig.z);
+    __m256 dx = _mm256_set1_ps(ray->dir.x),  dy = _mm256_set1_ps(ray->dir.y),  dz = _mm256_set1_ps(ray->dir.z);
+
+    __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(spheres->x + first));
+    __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(spheres->y + first));
+    __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(spheres->z + first));
+    __m256 rsq = _mm256_loadu_ps(spheres->radius_sq + first);
+
+    r32 a = v3_mag_sq(ray->dir);
+    __m256 A = _mm256_set1_ps(a);
+    __m256 B = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+    __m256 C = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz)), rsq);
+    __m256 disc = _mm256_sub_ps(_mm256_mul_ps(B, B), _mm256_mul_ps(A, C));
+
+    __m256 zero = _mm256_setzero_ps();
+    __m256 root = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+    __m256 t0 = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, B), root), A);
+    __m256 t1 = _mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(zero, B), root), A);
+
+    __m256 vmin = _mm256_set1_ps(tmin), vmax = _mm256_set1_ps(tmax);
+    __m256 t0_ok = _mm256_and_ps(_mm256_cmp_ps(t0, vmax, _CMP_LT_OQ), _mm256_cmp_ps(t0, vmin, _CMP_GT_OQ));
+    __m256 t1_ok = _mm256_and_ps(_mm256_cmp_ps(t1, vmax, _CMP_LT_OQ), _mm256_cmp_ps(t1, vmin, _CMP_GT_OQ));
+    __m256 t = _mm256_blendv_ps(t1, t0, t0_ok);
+
+    u32 lanes   = (1u << count) - 1;
+    u32 dynamic = (u32)_mm256_movemask_ps(_mm256_cmp_ps(rsq, zero, _CMP_LT_OQ)) & lanes;
+    u32 hits    = (u32)_mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(disc, zero, _CMP_GT_OQ), _mm256_or_ps(t0_ok, t1_ok)));
+    hits &= lanes & ~dynamic;
+
+    alignas(32) r32 ts[8];
+    _mm256_store_ps(ts, t);
+    while (hits)
+    {
+        u32 lane = simd_first_lane(hits);
+        hits &= hits - 1;
+        if (ts[lane] < *out_t)
+        {
+            *out_t    = ts[lane];
+            *out_lane = first + lane;
+        }
+    }
+
+    return dynamic;
+}
+
+RT_TARGET_AVX2 file_internal bool
+intersect_ray_bvh_leaf8(Hit *hit, Ray *ray, Bvh *bvh, Primitive *primitives,
+                        u32 first, u32 count, r32 tmin, r32 *tmax)
+{
+    bool hit_anything = false;
+    for (u32 start = first; start < first + count; start += 8)
+    {
+        u32 lanes = (first + count) - start;
+        if (lanes > 8) lanes = 8;
+
+        r32 best_t = *tmax;
+        u32 best   = U32_MAX;
+        u32 dynamic = intersect_ray_spheres8(ray, &bvh->spheres, start, lanes, tmin, *tmax, &best_t, &best);
+        if (best != U32_MAX)
+        {
+            hit->t         = best_t;
+            hit->primitive = bvh->prim_indices[best];
+            *tmax = best_t;
+            hit_anything = true;
+        }
+
+        while (dynamic)
+        {
+            u32 lane = simd_first_lane(dynamic);
+            dynamic &= dynamic - 1;
+            if (intersect_ray_primitive(hit, ray, primitives, bvh->prim_indices[start + lane], tmin, tmax))
+                hit_anything = true;
+        }
+    }
+    return hit_anything;
+}
+
+template<bool Motion> RT_TARGET_AVX2 FORCE_INLINE __m256
+bvh8_load_plane(r32 *planes, r32 *deltas, u32 offset, __m256 time_weight)
+{
+    __m256 plane = _mm256_load_ps(planes + offset);
+    if (Motion) plane = _mm256_add_ps(plane, _mm256_mul_ps(_mm256_load_ps(deltas + offset), time_weight));
+    return plane;
+}
+
+template<bool Motion, bool AnyHit> RT_TARGET_AVX2 file_internal bool
+intersect_ray_bvh8_nodes(Hit *hit, Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 *tmax)
+{
+    Bvh8Node *nodes = (Bvh8Node*)bvh->wide_nodes;
+    BvhWideDeltas<8> *deltas = (BvhWideDeltas<8>*)bvh->wide_deltas;
+    __m256 time_weight = _mm256_set1_ps(Motion ? bvh_time_weight(bvh, ray) : 0.0f);
+
+    __m256 ox = _mm256_set1_ps(ray->orig.x), oy = _mm256_set1_ps(ray->orig.y), oz = _mm256_set1_ps(ray->orig.z);
+    v3 inv_dir = { 1.0f / ray->dir.x, 1.0f / ray->dir.y, 1.0f / ray->dir.z };
+    __m256 ix = _mm256_set1_ps(inv_dir.x);
+    __m256 iy = _mm256_set1_ps(inv_dir.y);
+    __m256 iz = _mm256_set1_ps(inv_dir.z);
+    __m256 vmin = _mm256_set1_ps(tmin);
+    __m256 exit_scale = _mm256_set1_ps(AABB_EXIT_SCALE);
+
+    u32 near_x = (inv_dir.x >= 0.0f) ? 0  : 24, far_x = 24 - near_x;
+    u32 near_y = (inv_dir.y >= 0.0f) ? 8  : 32, far_y = 40 - near_y;
+    u32 near_z = (inv_dir.z >= 0.0f) ? 16 : 40, far_z = 56 - near_z;
+
+    BvhWideStackEntry stack[BVH_WIDE_STACK_SIZE];
+    u32 stack_ptr = 1;
+    stack[0] = { 0, 0, tmin };
+
+    bool hit_anything = false;
+    while (stack_ptr > 0)
+    {
+        BvhWideStackEntry entry = stack[--stack_ptr];
+        if (entry.dist >= *tmax) continue;
+
+        if (entry.count > 0)
+        {
+            if (intersect_ray_bvh_leaf8(hit, ray, bvh, primitives, entry.child, entry.count, tmin, tmax))
+            {
+                if (AnyHit) return true;
+                hit_anything = true;
+            }
+            continue;
+        }
+
+        Bvh8Node *node = &nodes[entry.child];
+        r32 *planes = node->min_x;
+        r32 *moves  = Motion ? deltas[entry.child].planes : 0;
+
+        __m256 tnx = _mm256_mul_ps(_mm256_sub_ps(bvh8_load_plane<Motion>(planes, moves, near_x, time_weight), ox), ix);
+        __m256 tny = _mm256_mul_ps(_mm256_sub_ps(bvh8_load_plane<Motion>(planes, moves, near_y, time_weight), oy), iy);
+        __m256 tnz = _mm256_mul_ps(_mm256_sub_ps(bvh8_load_plane<Motion>(planes, moves, near_z, time_weight), oz), iz);
+        __m256 tfx = _mm256_mul_ps(_mm256_sub_ps(bvh8_load_plane<Motion>(planes, moves, far_x,  time_weight), ox), ix);
+        __m256 tfy = _mm256_mul_ps(_mm256_sub_ps(bvh8_load_plane<Motion>(planes, moves, far_y,  time_weight), oy), iy);
+        __m256 tfz = _mm256_mul_ps(_mm256_sub_ps(bvh8_load_plane<Motion>(planes, moves, far_z,  time_weight), oz), iz);
+
+        __m256 t_enter = _mm256_max_ps(_mm256_max_ps(tnx, tny), _mm256_max_ps(tnz, vmin));
+        __m256 t_exit  = _mm256_mul_ps(_mm256_min_ps(_mm256_min_ps(tfx, tfy), tfz), exit_scale);
+        t_exit = _mm256_min_ps(t_exit, _mm256_set1_ps(*tmax));
+        u32 mask = (u32)_mm256_movemask_ps(_mm256_cmp_ps(t_enter, t_exit, _CMP_LE_OQ));
+
+        alignas(32) r32 dist[8];
+        _mm256_store_ps(dist, t_enter);
+        bvh_push_sorted(stack, &stack_ptr, node->child, node->count, dist, mask);
+    }
+
+    return hit_anything;
+}
+
+RT_TARGET_AVX2 file_internal bool
+intersect_ray_bvh8(Hit *hit, Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 *tmax)
+{
+    if (bvh->wide_deltas) return intersect_ray_bvh8_nodes<true, false>(hit, ray, bvh, primitives, tmin, tmax);
+    else                  return intersect_ray_bvh8_nodes<false, false>(hit, ray, bvh, primitives, tmin, tmax);
+}
+
+RT_TARGET_AVX2 file_internal bool
+intersect_ray_bvh8_any(Ray *ray, Bvh *bvh, Primitive *primitives, r32 tmin, r32 tmax)
+{
+    Hit hit;
+    if (bvh->wide_deltas) return intersect_ray_bvh8_nodes<true, true>(&hit, ray, bvh, primitives, tmin, &tmax);
+    else                  return intersect_ray_bvh8_nodes<false, true>(&hit, ray, bvh, primitives, tmin, &tmax);
+}
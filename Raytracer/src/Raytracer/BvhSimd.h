@@ -0,0 +1,93 @@
+#ifndef _RAYTRACER_BVH_SIMD_H
+#define _RAYTRACER_BVH_SIMD_H
+
+#if defined(_WIN32)
+#include <intrin.h>
+// MSVC emits AVX instructions for intrinsics without needing a per-function target
+#define RT_TARGET_AVX2
+#else
+#include <immintrin.h>
+#define RT_TARGET_AVX2 __attribute__((target("avx,avx2")))
+#endif
+
+enum SimdLevel
+{
+    SimdLevel_Scalar, // binary BVH, one box/primitive per test
+    SimdLevel_SSE,    // 4-wide BVH nodes and leaves
+    SimdLevel_AVX2,   // 8-wide BVH nodes and leaves
+
+    SimdLevel_Count,
+};
+
+// Wide BVH nodes store their children's bounds as SoA so one node visit tests every
+// child box at once. count[i] == 0 marks an interior child, otherwise child[i] is the
+// first index of a leaf range into Bvh::prim_indices. Unused slots hold an empty box.
+struct alignas(16) Bvh4Node
+{
+    r32 min_x[4], min_y[4], min_z[4];
+    r32 max_x[4], max_y[4], max_z[4];
+    u32 child[4];
+    u32 count[4];
+};
+static_assert(sizeof(Bvh4Node) == 128, "Bvh4Node should span two cache lines");
+
+struct alignas(32) Bvh8Node
+{
+    r32 min_x[8], min_y[8], min_z[8];
+    r32 max_x[8], max_y[8], max_z[8];
+    u32 child[8];
+    u32 count[8];
+};
+static_assert(sizeof(Bvh8Node) == 256, "Bvh8Node should span four cache lines");
+
+// Motion trees keep one of these per wide node, parallel to the node array: how much each
+// of the node's bound planes moves from shutter open to close, in the same SoA layout.
+// Static trees do not allocate them, so their nodes stay the same size.
+template<u32 W> struct alignas(4 * W) BvhWideDeltas
+{
+    r32 planes[6 * W];
+};
+
+// Sphere data in leaf order: entry i describes primitives[prim_indices[i]]. A negative
+// radius_sq marks a primitive that is not a static sphere and is tested by the scalar path.
+// Arrays are padded by 8 entries so the kernels can always issue full-width loads.
+struct BvhSpheres
+{
+    r32 *x;
+    r32 *y;
+    r32 *z;
+    r32 *radius_sq;
+};
+
+// Index of the lowest set bit of a lane mask, mask must be non-zero
+FORCE_INLINE u32 simd_first_lane(u32 mask)
+{
+#if defined(_WIN32)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctz(mask);
+#endif
+}
+
+file_internal SimdLevel   simd_detect_level();
+file_internal const char* simd_level_name(SimdLevel level);
+
+file_internal bool intersect_ray_bvh4(Hit              *hit,
+                                      struct Ray       *ray,
+                                      struct Bvh       *bvh,
+                                      struct Primitive *primitives,
+                                      r32               tmin,
+                                      r32              *tmax);
+file_internal bool intersect_ray_bvh8(Hit              *hit,
+                                      struct Ray       *ray,
+                                      struct Bvh       *bvh,
+                                      struct Primitive *primitives,
+                                      r32               tmin,
+                                      r32              *tmax);
+// Any-hit variants, true as soon as something is hit within [tmin, tmax]
+file_internal bool intersect_ray_bvh4_any(struct Ray *ray, struct Bvh *bvh, struct Primitive *primitives, r32 tmin, r32 tmax);
+file_internal bool intersect_ray_bvh8_any(struct Ray *ray, struct Bvh *bvh, struct Primitive *primitives, r32 tmin, r32 tmax);
+
+#endif //_RAYTRACER_BVH_SIMD_H
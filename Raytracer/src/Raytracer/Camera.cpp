@@ -28,13 +28,13 @@ camera_init(Camera *camera, CameraCreateInfo *info)
 }
 
 file_internal void
-camera_get_ray(Ray *ray, Camera *camera, r32 s, r32 t)
+camera_get_ray(Ray *ray, Camera *camera, r32 s, r32 t, Rng *rng)
 {
-    v3 rd = v3_mulf(random_in_unit_disc(), camera->lens_radius);
+    v3 rd = v3_mulf(rng_in_unit_disc(rng), camera->lens_radius);
     v3 offset = v3_add(v3_mulf(camera->u, rd.x), v3_mulf(camera->v, rd.y));
     
     ray->orig = v3_add(camera->origin, offset);
-    ray->time = random_clamped(camera->time0, camera->time1);
+    ray->time = rng_clamped(rng, camera->time0, camera->time1);
     // dir = lower_left + horit*s + vert*t - origin - offset
     ray->dir = v3_add(camera->lower_left_corner, v3_mulf(camera->horizontal, s));
     ray->dir = v3_add(ray->dir, v3_mulf(camera->vertical, t));
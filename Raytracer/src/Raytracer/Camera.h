@@ -27,6 +27,6 @@ struct Camera
 };
 
 file_internal void camera_init(Camera *camera, CameraCreateInfo *info);
-file_internal void camera_get_ray(struct Ray *ray, Camera *camera, r32 s, r32 t);
+file_internal void camera_get_ray(struct Ray *ray, Camera *camera, r32 s, r32 t, Rng *rng);
 
 #endif //_RAYTRACER_CAMERA_H
@@ -0,0 +1,292 @@
+
+file_internal void
+denoiser_init(Denoiser *denoiser, u32 width, u32 height)
+{
+    *denoiser = {};
+    denoiser->width  = width;
+    denoiser->height = height;
+
+    // color, variance, albedo, normal and the two scratch planes
+    const u32 plane_count = 3 + 1 + 3 + 3 + 3 + 1;
+    u64 pixels = (u64)width * height;
+    denoiser->jobs_count = (height + DENOISE_BAND_ROWS - 1) / DENOISE_BAND_ROWS;
+    denoiser->backing = PlatformAlloc(sizeof(r32) * pixels * plane_count + sizeof(DenoiseJob) * denoiser->jobs_count);
+
+    r32 *cursor = (r32*)denoiser->backing;
+    r32 **planes[] = {
+        &denoiser->color[0], &denoiser->color[1], &denoiser->color[2],
+        &denoiser->variance,
+        &denoiser->albedo[0], &denoiser->albedo[1], &denoiser->albedo[2],
+        &denoiser->normal[0], &denoiser->normal[1], &denoiser->normal[2],
+        &denoiser->scratch_color[0], &denoiser->scratch_color[1], &denoiser->scratch_color[2],
+        &denoiser->scratch_variance,
+    };
+    static_assert(ARRAYCOUNT(planes) == plane_count, "every plane needs backing");
+
+    for (u32 i = 0; i < plane_count; ++i)
+    {
+        *planes[i] = cursor;
+        cursor += pixels;
+    }
+
+    denoiser->jobs = (DenoiseJob*)cursor;
+    for (u32 j = 0; j < denoiser->jobs_count; ++j)
+    {
+        DenoiseJob *job = &denoiser->jobs[j];
+        job->denoiser = denoiser;
+        job->y0 = j * DENOISE_BAND_ROWS;
+        job->y1 = fast_min(job->y0 + DENOISE_BAND_ROWS, height);
+        job->step = 1;
+    }
+}
+
+file_internal void
+denoiser_free(Denoiser *denoiser)
+{
+    PlatformFree(denoiser->backing);
+    *denoiser = {};
+}
+
+FORCE_INLINE v3
+denoiser_clamp_albedo(v3 albedo)
+{
+    return {
+        fast_maxf(albedo.r, DENOISE_MIN_ALBEDO),
+        fast_maxf(albedo.g, DENOISE_MIN_ALBEDO),
+        fast_maxf(albedo.b, DENOISE_MIN_ALBEDO),
+    };
+}
+
+file_internal void
+denoiser_set_pixel(Denoiser *denoiser, u32 pixel, v3 color, r32 variance, v3 albedo, v3 normal)
+{
+    v3 divisor = denoiser_clamp_albedo(albedo);
+    r32 divisor_lum = 0.2126f * divisor.r + 0.7152f * divisor.g + 0.0722f * divisor.b;
+
+    denoiser->color[0][pixel] = color.r / divisor.r;
+    denoiser->color[1][pixel] = color.g / divisor.g;
+    denoiser->color[2][pixel] = color.b / divisor.b;
+    denoiser->variance[pixel] = variance / (divisor_lum * divisor_lum);
+
+    denoiser->albedo[0][pixel] = albedo.r;
+    denoiser->albedo[1][pixel] = albedo.g;
+    denoiser->albedo[2][pixel] = albedo.b;
+
+    // Normals averaged over an edge pixel come out short, renormalize so the center pixel
+    // still agrees with itself
+    r32 len = v3_mag(normal);
+    if (len > 0.0f) normal = v3_divf(normal, len);
+    denoiser->normal[0][pixel] = normal.x;
+    denoiser->normal[1][pixel] = normal.y;
+    denoiser->normal[2][pixel] = normal.z;
+}
+
+file_internal v3
+denoiser_get_pixel(Denoiser *denoiser, u32 pixel)
+{
+    v3 albedo = { denoiser->albedo[0][pixel], denoiser->albedo[1][pixel], denoiser->albedo[2][pixel] };
+    v3 color  = { denoiser->color[0][pixel],  denoiser->color[1][pixel],  denoiser->color[2][pixel]  };
+    return v3_mul(color, denoiser_clamp_albedo(albedo));
+}
+
+// exp(-x) for x >= 0, to about 1e-4 relative. 2^t is split into an exponent, added
+// straight into the float's bits, and a fraction in (-1, 0] taken from a polynomial.
+FORCE_INLINE __m128
+denoise_exp_neg(__m128 x)
+{
+    __m128 t = _mm_max_ps(_mm_mul_ps(x, _mm_set1_ps(-1.44269504f)), _mm_set1_ps(-125.0f));
+    __m128i whole = _mm_cvttps_epi32(t);
+    __m128 f = _mm_mul_ps(_mm_sub_ps(t, _mm_cvtepi32_ps(whole)), _mm_set1_ps(0.693147181f));
+
+    __m128 p = _mm_set1_ps(1.0f / 120.0f);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f / 24.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f / 6.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.5f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+    return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p), _mm_slli_epi32(whole, 23)));
+}
+
+FORCE_INLINE __m128
+denoise_luminance(__m128 r, __m128 g, __m128 b)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(0.2126f)), _mm_mul_ps(g, _mm_set1_ps(0.7152f))),
+                      _mm_mul_ps(b, _mm_set1_ps(0.0722f)));
+}
+
+// Loads the four pixels starting at column x. Columns outside the row are clamped to its
+// edge, the caller masks them out where that matters.
+FORCE_INLINE __m128
+denoise_load(r32 *row, i32 x, i32 width)
+{
+    if (x >= 0 && x + 4 <= width) return _mm_loadu_ps(row + x);
+    return _mm_setr_ps(row[fast_clamp(0, width - 1, x + 0)], row[fast_clamp(0, width - 1, x + 1)],
+                       row[fast_clamp(0, width - 1, x + 2)], row[fast_clamp(0, width - 1, x + 3)]);
+}
+
+FORCE_INLINE void
+denoise_store(r32 *row, i32 x, i32 width, __m128 value)
+{
+    if (x + 4 <= width)
+    {
+        _mm_storeu_ps(row + x, value);
+        return;
+    }
+
+    alignas(16) r32 lanes[4];
+    _mm_store_ps(lanes, value);
+    for (i32 i = 0; x + i < width; ++i) row[x + i] = lanes[i];
+}
+
+// 3x3 tent filtered variance around four pixels, smooths out the per-pixel estimate which
+// is very noisy at low sample counts
+FORCE_INLINE __m128
+denoise_blurred_variance(Denoiser *denoiser, i32 x, i32 y)
+{
+    const r32 weights[3] = { 0.25f, 0.5f, 0.25f };
+    i32 width = (i32)denoiser->width;
+
+    __m128 result = _mm_setzero_ps();
+    for (i32 dy = -1; dy <= 1; ++dy)
+    {
+        i32 yy = fast_clamp(0, (i32)denoiser->height - 1, y + dy);
+        r32 *row = denoiser->variance + (u64)yy * width;
+        for (i32 dx = -1; dx <= 1; ++dx)
+        {
+            __m128 w = _mm_set1_ps(weights[dy + 1] * weights[dx + 1]);
+            result = _mm_add_ps(result, _mm_mul_ps(w, denoise_load(row, x + dx, width)));
+        }
+    }
+    return result;
+}
+
+file_internal void
+denoise_band(void *args)
+{
+    DenoiseJob *job = (DenoiseJob*)args;
+    Denoiser *denoiser = job->denoiser;
+
+    i32 width  = (i32)denoiser->width;
+    i32 height = (i32)denoiser->height;
+    i32 step   = (i32)job->step;
+
+    // B3-spline taps, indexed by distance from the center
+    const r32 kernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+    const __m128 inv_sigma_albedo_sq = _mm_set1_ps(1.0f / (DENOISE_SIGMA_ALBEDO * DENOISE_SIGMA_ALBEDO));
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128i lane_offsets = _mm_setr_epi32(0, 1, 2, 3);
+
+    for (i32 y = (i32)job->y0; y < (i32)job->y1; ++y)
+    {
+        u64 center_row = (u64)y * width;
+        for (i32 x = 0; x < width; x += 4)
+        {
+            __m128 cr = denoise_load(denoiser->color[0] + center_row, x, width);
+            __m128 cg = denoise_load(denoiser->color[1] + center_row, x, width);
+            __m128 cb = denoise_load(denoiser->color[2] + center_row, x, width);
+            __m128 ar = denoise_load(denoiser->albedo[0] + center_row, x, width);
+            __m128 ag = denoise_load(denoiser->albedo[1] + center_row, x, width);
+            __m128 ab = denoise_load(denoiser->albedo[2] + center_row, x, width);
+            __m128 nx = denoise_load(denoiser->normal[0] + center_row, x, width);
+            __m128 ny = denoise_load(denoiser->normal[1] + center_row, x, width);
+            __m128 nz = denoise_load(denoiser->normal[2] + center_row, x, width);
+            __m128 lum = denoise_luminance(cr, cg, cb);
+
+            __m128 sigma = _mm_mul_ps(_mm_set1_ps(DENOISE_SIGMA_LUMINANCE),
+                                      _mm_sqrt_ps(denoise_blurred_variance(denoiser, x, y)));
+            __m128 inv_sigma = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(sigma, _mm_set1_ps(1e-4f)));
+
+            // The center tap always counts in full, so the weights never sum to zero
+            __m128 center_w = _mm_set1_ps(kernel[0] * kernel[0]);
+            __m128 sum_w = center_w;
+            __m128 sum_r = _mm_mul_ps(center_w, cr);
+            __m128 sum_g = _mm_mul_ps(center_w, cg);
+            __m128 sum_b = _mm_mul_ps(center_w, cb);
+            __m128 sum_v = _mm_mul_ps(_mm_mul_ps(center_w, center_w),
+                                      denoise_load(denoiser->variance + center_row, x, width));
+
+            for (i32 dy = -2; dy <= 2; ++dy)
+            {
+                i32 yy = y + dy * step;
+                if (yy < 0 || yy >= height) continue;
+                u64 row = (u64)yy * width;
+
+                for (i32 dx = -2; dx <= 2; ++dx)
+                {
+                    if (dx == 0 && dy == 0) continue;
+
+                    i32 xx = x + dx * step;
+                    __m128 qr = denoise_load(denoiser->color[0] + row, xx, width);
+                    __m128 qg = denoise_load(denoiser->color[1] + row, xx, width);
+                    __m128 qb = denoise_load(denoiser->color[2] + row, xx, width);
+
+                    // max(0, n.nq)^32 by repeated squaring
+                    __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, denoise_load(denoiser->normal[0] + row, xx, width)),
+                                                       _mm_mul_ps(ny, denoise_load(denoiser->normal[1] + row, xx, width))),
+                                            _mm_mul_ps(nz, denoise_load(denoiser->normal[2] + row, xx, width)));
+                    __m128 w_normal = _mm_max_ps(dot, _mm_setzero_ps());
+                    for (u32 i = 0; i < DENOISE_NORMAL_POWER_LOG2; ++i) w_normal = _mm_mul_ps(w_normal, w_normal);
+
+                    __m128 dar = _mm_sub_ps(ar, denoise_load(denoiser->albedo[0] + row, xx, width));
+                    __m128 dag = _mm_sub_ps(ag, denoise_load(denoiser->albedo[1] + row, xx, width));
+                    __m128 dab = _mm_sub_ps(ab, denoise_load(denoiser->albedo[2] + row, xx, width));
+                    __m128 albedo_dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dar, dar), _mm_mul_ps(dag, dag)), _mm_mul_ps(dab, dab));
+
+                    __m128 lum_dist = _mm_and_ps(_mm_sub_ps(lum, denoise_luminance(qr, qg, qb)), abs_mask);
+
+                    __m128 exponent = _mm_add_ps(_mm_mul_ps(lum_dist, inv_sigma), _mm_mul_ps(albedo_dist, inv_sigma_albedo_sq));
+                    __m128 w = _mm_mul_ps(_mm_set1_ps(kernel[abs(dx)] * kernel[abs(dy)]),
+                                          _mm_mul_ps(w_normal, denoise_exp_neg(exponent)));
+
+                    // Taps that fall off the side of the image do not count
+                    __m128i column = _mm_add_epi32(_mm_set1_epi32(xx), lane_offsets);
+                    __m128i inside = _mm_and_si128(_mm_cmpgt_epi32(column, _mm_set1_epi32(-1)),
+                                                   _mm_cmplt_epi32(column, _mm_set1_epi32(width)));
+                    w = _mm_and_ps(w, _mm_castsi128_ps(inside));
+
+                    sum_w = _mm_add_ps(sum_w, w);
+                    sum_r = _mm_add_ps(sum_r, _mm_mul_ps(w, qr));
+                    sum_g = _mm_add_ps(sum_g, _mm_mul_ps(w, qg));
+                    sum_b = _mm_add_ps(sum_b, _mm_mul_ps(w, qb));
+                    sum_v = _mm_add_ps(sum_v, _mm_mul_ps(_mm_mul_ps(w, w), denoise_load(denoiser->variance + row, xx, width)));
+                }
+            }
+
+            __m128 inv_w = _mm_div_ps(_mm_set1_ps(1.0f), sum_w);
+            denoise_store(denoiser->scratch_color[0] + center_row, x, width, _mm_mul_ps(sum_r, inv_w));
+            denoise_store(denoiser->scratch_color[1] + center_row, x, width, _mm_mul_ps(sum_g, inv_w));
+            denoise_store(denoiser->scratch_color[2] + center_row, x, width, _mm_mul_ps(sum_b, inv_w));
+            denoise_store(denoiser->scratch_variance + center_row, x, width, _mm_mul_ps(sum_v, _mm_mul_ps(inv_w, inv_w)));
+        }
+    }
+
+    PlatformAtomicDec(&denoiser->pending);
+}
+
+file_internal void
+denoiser_run(Denoiser *denoiser)
+{
+    for (u32 iteration = 0; iteration < DENOISE_ITERATIONS; ++iteration)
+    {
+        for (u32 j = 0; j < denoiser->jobs_count; ++j)
+        {
+            denoiser->jobs[j].step = 1u << iteration;
+        }
+
+        denoiser->pending = denoiser->jobs_count;
+        PlatformAsyncTaskBatch(denoise_band, denoiser->jobs, sizeof(DenoiseJob), denoiser->jobs_count);
+        PlatformAwaitCounter(&denoiser->pending);
+
+        // The filtered planes become the input of the next iteration
+        for (u32 c = 0; c < 3; ++c)
+        {
+            r32 *tmp = denoiser->color[c];
+            denoiser->color[c] = denoiser->scratch_color[c];
+            denoiser->scratch_color[c] = tmp;
+        }
+        r32 *tmp = denoiser->variance;
+        denoiser->variance = denoiser->scratch_variance;
+        denoiser->scratch_variance = tmp;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef _RAYTRACER_DENOISE_H
+#define _RAYTRACER_DENOISE_H
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) with the variance guided
+// luminance weight of SVGF (Schied et al. 2017). Each iteration is a sparse 5x5 B3-spline
+// kernel whose taps are spaced 1, 2, 4, ... pixels apart; every tap is weighted down by
+// how far its normal, albedo and luminance are from the center pixel. Color is divided by
+// the albedo before filtering and multiplied back after, so only the lighting is blurred.
+//
+// The planes are SoA so the kernel filters four pixels of a row per SSE op, and each
+// iteration runs as row bands on the job system. Every pixel only reads the previous
+// iteration, the result does not depend on the number of threads.
+
+constexpr u32 DENOISE_ITERATIONS        = 4;    // tap spacing reaches 8 pixels, a 33 pixel footprint
+constexpr u32 DENOISE_BAND_ROWS         = 16;   // rows per job
+constexpr r32 DENOISE_SIGMA_LUMINANCE   = 4.0f; // luminance weight, in standard deviations
+constexpr r32 DENOISE_SIGMA_ALBEDO      = 0.2f;
+constexpr u32 DENOISE_NORMAL_POWER_LOG2 = 5;    // normal weight is max(0, dot)^32
+constexpr r32 DENOISE_MIN_ALBEDO        = 0.01f; // albedo is clamped to this before dividing by it
+
+struct DenoiseJob
+{
+    struct Denoiser *denoiser;
+    u32              y0, y1;
+    u32              step;
+};
+
+struct Denoiser
+{
+    u32  width;
+    u32  height;
+
+    // Filled by denoiser_set_pixel, color holds the result after denoiser_run
+    r32 *color[3];
+    r32 *variance;   // of the luminance of color
+    r32 *albedo[3];
+    r32 *normal[3];
+
+    // The other half of the color/variance ping-pong
+    r32 *scratch_color[3];
+    r32 *scratch_variance;
+
+    DenoiseJob  *jobs;
+    u32          jobs_count;
+    volatile u32 pending;
+
+    void        *backing;
+};
+
+file_internal void denoiser_init(Denoiser *denoiser, u32 width, u32 height);
+file_internal void denoiser_free(Denoiser *denoiser);
+// color is the pixel's mean radiance and variance the variance of its luminance mean
+file_internal void denoiser_set_pixel(Denoiser *denoiser, u32 pixel, v3 color, r32 variance, v3 albedo, v3 normal);
+file_internal v3   denoiser_get_pixel(Denoiser *denoiser, u32 pixel);
+// Blocks until every iteration is done, the calling thread helps through PlatformAwaitCounter
+file_internal void denoiser_run(Denoiser *denoiser);
+
+#endif //_RAYTRACER_DENOISE_H
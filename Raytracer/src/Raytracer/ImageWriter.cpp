@@ -0,0 +1,200 @@
+
+FORCE_INLINE __m128
+image_clamp4(__m128 v)
+{
+    return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+// 8 bit quantization, 16 channels per iteration
+file_internal void
+image_quantize_u8(u8 *dst, r32 *src, u64 count)
+{
+    __m128 scale = _mm_set1_ps(255.999f);
+
+    u64 i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = _mm_cvttps_epi32(_mm_mul_ps(image_clamp4(_mm_loadu_ps(src + i +  0)), scale));
+        __m128i b = _mm_cvttps_epi32(_mm_mul_ps(image_clamp4(_mm_loadu_ps(src + i +  4)), scale));
+        __m128i c = _mm_cvttps_epi32(_mm_mul_ps(image_clamp4(_mm_loadu_ps(src + i +  8)), scale));
+        __m128i d = _mm_cvttps_epi32(_mm_mul_ps(image_clamp4(_mm_loadu_ps(src + i + 12)), scale));
+
+        // Values are already in [0, 255], so the saturating packs only narrow them
+        __m128i ab = _mm_packs_epi32(a, b);
+        __m128i cd = _mm_packs_epi32(c, d);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(ab, cd));
+    }
+
+    for (; i < count; ++i)
+    {
+        dst[i] = (u8)(255.999f * fast_clampf(0.0f, 1.0f, src[i]));
+    }
+}
+
+// The image holds gamma 2 values (see rt_store_pixel), squaring takes them back to linear
+file_internal void
+image_linearize(r32 *dst, r32 *src, u64 count)
+{
+    u64 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(v, v));
+    }
+
+    for (; i < count; ++i)
+    {
+        dst[i] = src[i] * src[i];
+    }
+}
+
+// Round to nearest even float to half conversion (after F. Giesen's float_to_half_fast3_rtne)
+FORCE_INLINE u16
+image_f32_to_f16(r32 value)
+{
+    union { r32 f; u32 u; } bits;
+    bits.f = value;
+
+    u32 sign = (bits.u >> 16) & 0x8000;
+    bits.u &= 0x7FFFFFFF;
+
+    u16 result;
+    if (bits.u >= 0x47800000) // too large for a half, or inf/nan
+    {
+        result = (bits.u > 0x7F800000) ? 0x7E00 : 0x7C00;
+    }
+    else if (bits.u < 0x38800000) // denormal half, let the float adder do the rounding
+    {
+        union { r32 f; u32 u; } magic;
+        magic.u = ((127 - 15) + (23 - 10) + 1) << 23;
+        bits.f += magic.f;
+        result = (u16)(bits.u - magic.u);
+    }
+    else
+    {
+        u32 mant_odd = (bits.u >> 13) & 1;
+        bits.u += ((u32)(15 - 127) << 23) + 0xFFF;
+        bits.u += mant_odd;
+        result = (u16)(bits.u >> 13);
+    }
+
+    return result | (u16)sign;
+}
+
+file_internal u64
+image_encode_ppm(u8 *out, r32 *image, u32 width, u32 height)
+{
+    u64 header = (u64)snprintf((char*)out, out ? 64 : 0, "P6\n%d %d\n255\n", width, height);
+    u64 count  = 3 * (u64)width * height;
+    if (out) image_quantize_u8(out + header, image, count);
+    return header + count;
+}
+
+file_internal u64
+image_encode_pfm(u8 *out, r32 *image, u32 width, u32 height)
+{
+    // A negative scale marks little endian data
+    u64 header = (u64)snprintf((char*)out, out ? 64 : 0, "PF\n%d %d\n-1.0\n", width, height);
+    u64 row    = 3 * (u64)width;
+    if (out)
+    {
+        // PFM stores the bottom row first
+        r32 *pixels = (r32*)(out + header);
+        for (u32 y = 0; y < height; ++y)
+        {
+            image_linearize(pixels + y * row, image + (height - 1 - y) * row, row);
+        }
+    }
+    return header + sizeof(r32) * row * height;
+}
+
+file_internal u64
+image_encode_pfm_data(u8 *out, r32 *image, u32 width, u32 height)
+{
+    u64 header = (u64)snprintf((char*)out, out ? 64 : 0, "PF\n%d %d\n-1.0\n", width, height);
+    u64 row    = 3 * (u64)width;
+    if (out)
+    {
+        r32 *pixels = (r32*)(out + header);
+        for (u32 y = 0; y < height; ++y)
+        {
+            memcpy(pixels + y * row, image + (height - 1 - y) * row, sizeof(r32) * row);
+        }
+    }
+    return header + sizeof(r32) * row * height;
+}
+
+file_internal u64
+image_encode_half_tiled(u8 *out, r32 *image, u32 width, u32 height)
+{
+    u64 size = sizeof(ImageHalfHeader) + sizeof(u16) * 3 * (u64)width * height;
+    if (!out) return size;
+
+    ImageHalfHeader *header = (ImageHalfHeader*)out;
+    header->magic     = IMAGE_HALF_MAGIC;
+    header->version   = IMAGE_HALF_VERSION;
+    header->width     = width;
+    header->height    = height;
+    header->tile_size = IMAGE_HALF_TILE_SIZE;
+    header->channels  = 3;
+
+    u16 *cursor = (u16*)(header + 1);
+    r32 linear[3 * IMAGE_HALF_TILE_SIZE];
+
+    for (u32 ty = 0; ty < height; ty += IMAGE_HALF_TILE_SIZE)
+    {
+        u32 tile_h = fast_min(IMAGE_HALF_TILE_SIZE, height - ty);
+        for (u32 tx = 0; tx < width; tx += IMAGE_HALF_TILE_SIZE)
+        {
+            u32 tile_w = fast_min(IMAGE_HALF_TILE_SIZE, width - tx);
+            for (u32 y = ty; y < ty + tile_h; ++y)
+            {
+                image_linearize(linear, image + 3 * ((u64)y * width + tx), 3 * tile_w);
+                for (u32 c = 0; c < 3 * tile_w; ++c)
+                {
+                    *cursor++ = image_f32_to_f16(linear[c]);
+                }
+            }
+        }
+    }
+
+    return size;
+}
+
+file_internal ImageFormat
+image_format_from_path(const char *file_path)
+{
+    const char *ext = strrchr(file_path, '.');
+    if (ext && strcmp(ext, ".pfm") == 0) return ImageFormat_PFM;
+    if (ext && strcmp(ext, ".rth") == 0) return ImageFormat_HalfTiled;
+    return ImageFormat_PPM;
+}
+
+file_internal bool
+image_write(const char *file_path, ImageFormat format, r32 *image, u32 width, u32 height)
+{
+    typedef u64 (*image_encode_pfn)(u8 *out, r32 *image, u32 width, u32 height);
+    image_encode_pfn encoders[ImageFormat_Count] = {
+        image_encode_ppm,
+        image_encode_pfm,
+        image_encode_half_tiled,
+        image_encode_pfm_data,
+    };
+
+    // First call only sizes the file, the second encodes it in place
+    image_encode_pfn encode = encoders[format];
+    u64 size = encode(0, image, width, height);
+
+    u8 *buffer = (u8*)PlatformAlloc(size + 64);
+    encode(buffer, image, width, height);
+
+    PlatformErrorType err = PlatformWriteBufferToFile(file_path, buffer, size);
+    PlatformFree(buffer);
+
+    if (err != PlatformError_Success)
+    {
+        LogError("Unable to write image %s", file_path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef _RAYTRACER_IMAGE_WRITER_H
+#define _RAYTRACER_IMAGE_WRITER_H
+
+// Writes the raytracer's r32 RGB image (top row first, already gamma corrected but not
+// clamped by rt_store_pixel) to disk. Every format is encoded into one buffer and written with a
+// single call.
+
+enum ImageFormat
+{
+    ImageFormat_PPM,       // binary P6, 8 bits per channel, display referred
+    ImageFormat_PFM,       // float PFM, linear
+    ImageFormat_HalfTiled, // tiled half float, linear (see ImageHalfHeader)
+    ImageFormat_PFMData,   // float PFM of values that are not gamma corrected, e.g. AOVs
+
+    ImageFormat_Count,
+};
+
+constexpr u32 IMAGE_HALF_MAGIC     = 0x46485452; // "RTHF"
+constexpr u32 IMAGE_HALF_VERSION   = 1;
+constexpr u32 IMAGE_HALF_TILE_SIZE = 64;
+
+// Tiled half float file: the header, then the tiles in row major order starting at the
+// top left. Each tile holds its pixels row major as RGB halves, edge tiles are clipped to
+// the image so no padding is stored.
+struct ImageHalfHeader
+{
+    u32 magic;
+    u32 version;
+    u32 width;
+    u32 height;
+    u32 tile_size;
+    u32 channels;
+};
+
+// Picks the format from the extension: .pfm, .rth, anything else is written as PPM
+file_internal ImageFormat image_format_from_path(const char *file_path);
+file_internal bool        image_write(const char *file_path, ImageFormat format, r32 *image, u32 width, u32 height);
+
+#endif //_RAYTRACER_IMAGE_WRITER_H
@@ -0,0 +1,265 @@
+
+file_internal void
+rt_interactive_set_scale(RtInteractive *interactive, u32 scale)
+{
+    RaytracerSettings *settings = interactive->settings;
+
+    // The camera divides by width - 1 and height - 1, keep at least two pixels a side
+    while (scale > 1 && (settings->width / scale < 2 || settings->height / scale < 2))
+        scale >>= 1;
+
+    interactive->scale       = scale;
+    interactive->width       = settings->width  / scale;
+    interactive->height      = settings->height / scale;
+    interactive->cursor      = 0;
+    interactive->bands_count = (interactive->height + RT_INTERACTIVE_BAND_ROWS - 1) / RT_INTERACTIVE_BAND_ROWS;
+
+    // accum is not cleared, the first sample of a row overwrites it
+    memset(interactive->row_spp, 0, sizeof(u32) * interactive->height);
+}
+
+file_internal void
+rt_interactive_init(RtInteractive *interactive, RaytracerSettings *settings)
+{
+    *interactive = {};
+    interactive->settings = settings;
+
+    u32 pixels = settings->width * settings->height;
+    u32 bands  = (settings->height + RT_INTERACTIVE_BAND_ROWS - 1) / RT_INTERACTIVE_BAND_ROWS;
+    interactive->accum   = (v3*)PlatformAlloc(sizeof(v3) * pixels);
+    interactive->row_spp = (u32*)PlatformAlloc(sizeof(u32) * settings->height);
+    interactive->jobs    = (RtBandJob*)PlatformAlloc(sizeof(RtBandJob) * bands);
+
+    interactive->resolve_jobs_count = (settings->height + RT_RESOLVE_BAND_ROWS - 1) / RT_RESOLVE_BAND_ROWS;
+    interactive->resolve_jobs = (RtBandJob*)PlatformAlloc(sizeof(RtBandJob) * interactive->resolve_jobs_count);
+    interactive->resolve_rows = (v3*)PlatformAlloc(sizeof(v3) * (settings->width / 2) * interactive->resolve_jobs_count);
+    for (u32 b = 0; b < interactive->resolve_jobs_count; ++b)
+    {
+        RtBandJob *job = &interactive->resolve_jobs[b];
+        job->interactive = interactive;
+        job->row = interactive->resolve_rows + b * (settings->width / 2);
+        job->y0 = b * RT_RESOLVE_BAND_ROWS;
+        job->y1 = fast_min(job->y0 + RT_RESOLVE_BAND_ROWS, settings->height);
+    }
+
+    // The first frame has no timings to go by, it previews at the coarsest scale
+    rt_interactive_set_scale(interactive, RT_INTERACTIVE_MAX_SCALE);
+    interactive->reset = true;
+}
+
+file_internal void
+rt_interactive_free(RtInteractive *interactive)
+{
+    PlatformFree(interactive->accum);
+    PlatformFree(interactive->row_spp);
+    PlatformFree(interactive->jobs);
+    PlatformFree(interactive->resolve_jobs);
+    PlatformFree(interactive->resolve_rows);
+    *interactive = {};
+}
+
+file_internal void
+rt_interactive_reset(RtInteractive *interactive)
+{
+    interactive->reset = true;
+}
+
+file_internal void
+rt_interactive_band(void *args)
+{
+    RtBandJob *job = (RtBandJob*)args;
+    RtInteractive *interactive = job->interactive;
+    RaytracerSettings *settings = interactive->settings;
+    Camera *camera = settings->camera;
+    Scene  *scene  = settings->scene;
+
+    u32 width  = interactive->width;
+    u32 height = interactive->height;
+    for (u32 y = job->y0; y < job->y1; ++y)
+    {
+        i32 j = (i32)height - 1 - (i32)y;
+        u32 s = interactive->row_spp[y];
+
+        for (u32 x = 0; x < width; ++x)
+        {
+            i32 i = (i32)x;
+            u32 p = y * width + x;
+
+            // Keyed on the render resolution, a preview pixel is its own pixel
+            Rng rng;
+            rt_pixel_rng(&rng, settings, i, j, s);
+
+            r32 u = (r32)(i + rng_next(&rng)) / (r32)(width  - 1);
+            r32 v = (r32)(j + rng_next(&rng)) / (r32)(height - 1);
+
+            Ray ray{};
+            camera_get_ray(&ray, camera, u, v, &rng);
+            v3 sample = ray_color(&ray, scene, settings->depth, &rng);
+
+            v3 color = (s == 0) ? sample : v3_add(interactive->accum[p], sample);
+            interactive->accum[p] = color;
+
+            // At full resolution the row resolves in place, a preview is upsampled after
+            if (interactive->scale == 1)
+                rt_store_pixel(settings->image, (i32)p * 3, color, s + 1);
+        }
+
+        interactive->row_spp[y] = s + 1;
+    }
+
+    PlatformAtomicDec(&interactive->pending);
+}
+
+// Bilinear upsample of the preview means. Image rows over preview rows that have no sample
+// yet keep what the last frame left in them.
+file_internal void
+rt_interactive_resolve(void *args)
+{
+    RtBandJob *job = (RtBandJob*)args;
+    RtInteractive *interactive = job->interactive;
+    RaytracerSettings *settings = interactive->settings;
+
+    u32 width  = interactive->width;
+    u32 height = interactive->height;
+    r32 inv_scale = 1.0f / (r32)interactive->scale;
+
+    for (u32 y = job->y0; y < job->y1; ++y)
+    {
+        r32 fy = fast_clampf(0.0f, (r32)(height - 1), ((r32)y + 0.5f) * inv_scale - 0.5f);
+        u32 r0 = (u32)fy;
+        u32 r1 = fast_min(r0 + 1, height - 1);
+        r32 ty = fy - (r32)r0;
+
+        if (interactive->row_spp[r0] == 0) continue;
+        if (interactive->row_spp[r1] == 0) r1 = r0;
+
+        // Blend the two preview rows once, then every image pixel is a single lerp
+        r32 w0 = (1.0f - ty) / (r32)interactive->row_spp[r0];
+        r32 w1 = ty / (r32)interactive->row_spp[r1];
+        v3 *row0 = interactive->accum + r0 * width;
+        v3 *row1 = interactive->accum + r1 * width;
+        for (u32 x = 0; x < width; ++x)
+        {
+            job->row[x] = v3_add(v3_mulf(row0[x], w0), v3_mulf(row1[x], w1));
+        }
+
+        for (u32 x = 0; x < settings->width; ++x)
+        {
+            r32 fx = fast_clampf(0.0f, (r32)(width - 1), ((r32)x + 0.5f) * inv_scale - 0.5f);
+            u32 c0 = (u32)fx;
+            u32 c1 = fast_min(c0 + 1, width - 1);
+            r32 tx = fx - (r32)c0;
+
+            v3 color = v3_add(v3_mulf(job->row[c0], 1.0f - tx), v3_mulf(job->row[c1], tx));
+            rt_store_pixel(settings->image, (i32)(y * settings->width + x) * 3, color, 1);
+        }
+    }
+
+    PlatformAtomicDec(&interactive->pending);
+}
+
+file_internal b8
+rt_interactive_frame(RtInteractive *interactive, r32 budget_ms)
+{
+    RaytracerSettings *settings = interactive->settings;
+
+    Timer timer;
+    timer_begin(&timer);
+
+    if (interactive->reset)
+    {
+        // Preview at the finest scale whose whole pass fits the budget
+        u32 scale = RT_INTERACTIVE_MAX_SCALE;
+        if (interactive->ms_per_pixel > 0.0f)
+        {
+            scale = 1;
+            r32 pass_ms = interactive->ms_per_pixel * (r32)(settings->width * settings->height);
+            while (scale < RT_INTERACTIVE_MAX_SCALE && pass_ms + interactive->resolve_ms > budget_ms)
+            {
+                scale  <<= 1;
+                pass_ms *= 0.25f;
+            }
+        }
+
+        rt_interactive_set_scale(interactive, scale);
+        interactive->reset  = false;
+        interactive->moving = true;
+    }
+    else if (interactive->moving)
+    {
+        // The camera settled, start over at full resolution. Rows the full resolution pass
+        // has not reached yet keep showing the preview.
+        interactive->moving = false;
+        if (interactive->scale > 1) rt_interactive_set_scale(interactive, 1);
+    }
+
+    u32 height = interactive->height;
+    u32 band_pixels = RT_INTERACTIVE_BAND_ROWS * interactive->width;
+    r32 render_budget = budget_ms - ((interactive->scale > 1) ? interactive->resolve_ms : 0.0f);
+
+    b8 rendered = false;
+    for (;;)
+    {
+        // Bands are visited in order, the last row is the last to reach any sample count
+        if (interactive->row_spp[height - 1] >= settings->samples) break;
+
+        r32 remaining = render_budget - timer_mili_seconds_elapsed(&timer);
+        if (rendered && remaining <= 0.0f) break;
+
+        // Always at least one band so every frame makes progress
+        u32 count = interactive->bands_count;
+        if (interactive->ms_per_pixel > 0.0f)
+        {
+            r32 fit = remaining / (interactive->ms_per_pixel * (r32)band_pixels);
+            if (fit < (r32)count) count = fast_max((i32)fit, 1);
+        }
+
+        u32 job_count = 0;
+        u32 pixels = 0;
+        for (u32 b = 0; b < count; ++b)
+        {
+            u32 y0 = interactive->cursor * RT_INTERACTIVE_BAND_ROWS;
+            if (interactive->row_spp[y0] >= settings->samples) break;
+
+            RtBandJob *job = &interactive->jobs[job_count++];
+            job->interactive = interactive;
+            job->y0 = y0;
+            job->y1 = fast_min(y0 + RT_INTERACTIVE_BAND_ROWS, height);
+            pixels += (job->y1 - job->y0) * interactive->width;
+
+            interactive->cursor = (interactive->cursor + 1) % interactive->bands_count;
+        }
+
+        // The band under the cursor already has every sample, there is nothing to time
+        if (pixels == 0) break;
+
+        Timer batch_timer;
+        timer_begin(&batch_timer);
+
+        interactive->pending = job_count;
+        PlatformAsyncTaskBatch(rt_interactive_band, interactive->jobs, sizeof(RtBandJob), job_count);
+        PlatformAwaitCounter(&interactive->pending);
+
+        // Smoothed, the cost per pixel changes as the camera moves across the scene
+        r32 ms_per_pixel = timer_mili_seconds_elapsed(&batch_timer) / (r32)pixels;
+        interactive->ms_per_pixel = (interactive->ms_per_pixel > 0.0f)
+            ? 0.75f * interactive->ms_per_pixel + 0.25f * ms_per_pixel : ms_per_pixel;
+
+        rendered = true;
+    }
+
+    if (rendered && interactive->scale > 1)
+    {
+        Timer resolve_timer;
+        timer_begin(&resolve_timer);
+
+        interactive->pending = interactive->resolve_jobs_count;
+        PlatformAsyncTaskBatch(rt_interactive_resolve, interactive->resolve_jobs, sizeof(RtBandJob),
+                               interactive->resolve_jobs_count);
+        PlatformAwaitCounter(&interactive->pending);
+
+        interactive->resolve_ms = timer_mili_seconds_elapsed(&resolve_timer);
+    }
+
+    return rendered;
+}
@@ -0,0 +1,63 @@
+#ifndef _RAYTRACER_INTERACTIVE_H
+#define _RAYTRACER_INTERACTIVE_H
+
+// Interactive accumulation for the viewer. Every frame renders one sample per pixel over as
+// many row bands as fit the frame's time budget, adding into a float accumulation buffer,
+// and resolves the running mean into settings->image. A pass that does not fit finishes over
+// the next frames, rows that have not been reached yet keep the previous frame's pixels.
+//
+// rt_interactive_reset drops the accumulated samples after the camera or the scene changed.
+// While resets keep coming in, the preview renders at 1/2, 1/4 or 1/8 of the resolution,
+// whichever lets a whole pass fit the budget, and is upsampled bilinearly to the image. The
+// first frame without a reset goes back to full resolution and starts accumulating for real.
+
+constexpr u32 RT_INTERACTIVE_BAND_ROWS  = 8;  // rows per job, at the render resolution
+constexpr u32 RT_INTERACTIVE_MAX_SCALE  = 8;  // coarsest preview, in pixels per side
+constexpr u32 RT_RESOLVE_BAND_ROWS      = 16; // image rows per upsampling job
+
+struct RtBandJob
+{
+    struct RtInteractive *interactive;
+    u32                   y0, y1; // rows, top down, max exclusive
+    v3                   *row;    // upsampling scratch, one preview row
+};
+
+struct RtInteractive
+{
+    RaytracerSettings *settings;  // width and height are the display resolution
+
+    // Sized for the full resolution, a preview only uses the first width * height pixels
+    v3        *accum;
+    u32       *row_spp;     // samples accumulated in each row of the render resolution
+
+    u32        scale;       // 1 renders at full resolution
+    u32        width;       // render resolution, settings->width / scale
+    u32        height;
+    u32        cursor;      // next band to render
+    u32        bands_count;
+
+    b8         reset;       // set by rt_interactive_reset, consumed by the next frame
+    b8         moving;      // the last frame started from a reset
+
+    r32        ms_per_pixel; // wall time of one sample over one pixel, with every thread busy
+    r32        resolve_ms;   // last upsampling pass
+
+    RtBandJob *jobs;
+    RtBandJob *resolve_jobs;
+    v3        *resolve_rows;  // scratch rows of the resolve jobs
+    u32        resolve_jobs_count;
+
+    volatile u32 pending;
+};
+
+file_internal void rt_interactive_init(RtInteractive *interactive, RaytracerSettings *settings);
+file_internal void rt_interactive_free(RtInteractive *interactive);
+// Drops every accumulated sample on the next frame. Call it after the camera or the scene
+// changed, no job may be in flight.
+file_internal void rt_interactive_reset(RtInteractive *interactive);
+// Renders for about budget_ms and resolves into settings->image, the calling thread helps
+// through PlatformAwaitCounter. Returns false when nothing changed because every pixel
+// already has settings->samples samples.
+file_internal b8   rt_interactive_frame(RtInteractive *interactive, r32 budget_ms);
+
+#endif //_RAYTRACER_INTERACTIVE_H
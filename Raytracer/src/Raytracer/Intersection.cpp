@@ -1,23 +1,22 @@
-
-file_internal bool intersect_ray_sphere(HitRecord *record, Ray *ray, Primitive *prim, r32 tmin, r32 *tmax);
-file_internal bool intersect_ray_dynamic_sphere(HitRecord *Record,
+file_internal bool intersect_ray_sphere(Hit *hit, Ray *ray, Primitive *prim, r32 tmin, r32 *tmax);
+file_internal bool intersect_ray_dynamic_sphere(Hit       *hit,
                                                 Ray       *ray,
                                                 Primitive *prim,
                                                 r32        Tmin,
                                                 r32        *tmax);
-file_internal bool intersect_ray_bvh_node(HitRecord  *record,
-                                          Ray        *ray,
-                                          Primitive  *prim,
-                                          r32         tmin, 
-                                          r32        *tmax);
 
-typedef bool (*intersection_pfn)(HitRecord *record, Ray *ray, Primitive *sphere, r32 tmin, r32 *tmax);
+// Candidate tests only fill in Hit::t and, for meshes, the element and barycentrics
+typedef bool (*intersection_pfn)(Hit *hit, Ray *ray, Primitive *sphere, r32 tmin, r32 *tmax);
 file_global intersection_pfn g_intersection_look_up[] = {
     intersect_ray_sphere,         // Sphere
     intersect_ray_dynamic_sphere, // Dynamic Sphere
-    intersect_ray_bvh_node,       // BVH Node
+    intersect_ray_mesh_instance,  // Mesh Instance
 };
 
+// Scene queries made by this thread, for rays/sec reporting. Thread local so counting
+// costs no more than an increment.
+file_global thread_local u64 tls_rays_traced = 0;
+
 file_internal void 
 hit_rec_set_face_normal(HitRecord *record, struct Ray *ray)
 {
@@ -36,8 +35,44 @@ hit_sphere(v3 *center, r32 radius, Ray *r)
     return (discriminant > 0);
 }
 
+file_internal void
+hit_rec_from_sphere(HitRecord *record, Ray *ray, v3 center, r32 radius, r32 t)
+{
+    record->t = t;
+    record->point = ray_move_along(ray, record->t);
+    record->normal = v3_divf(v3_sub(record->point, center), radius);
+    hit_rec_set_face_normal(record, ray);
+}
+
+file_internal void
+hit_rec_resolve(HitRecord *record, Hit *hit, Ray *ray, Scene *scene)
+{
+    Primitive *primitive = &scene->primitives[hit->primitive];
+    switch (primitive->type)
+    {
+        case Primitive_Sphere:
+        {
+            hit_rec_from_sphere(record, ray, primitive->sphere.origin, primitive->sphere.radius, hit->t);
+        } break;
+        
+        case Primitive_DynamicSphere:
+        {
+            PrimitiveDynamicSphere *sphere = &primitive->dyn_sphere;
+            hit_rec_from_sphere(record, ray, get_sphere_center(sphere, ray->time), sphere->radius, hit->t);
+        } break;
+        
+        case Primitive_MeshInstance:
+        {
+            hit_rec_from_mesh_instance(record, ray, &primitive->mesh_instance, hit);
+        } break;
+    }
+    
+    record->material  = &scene->materials[primitive->material_id];
+    record->primitive = hit->primitive;
+}
+
 file_internal bool 
-intersect_ray_sphere(HitRecord *record, Ray *ray, Primitive *prim, r32 tmin, r32 *Tmax)
+intersect_ray_sphere(Hit *hit, Ray *ray, Primitive *prim, r32 tmin, r32 *Tmax)
 {
     PrimitiveSphere *sphere = &prim->sphere;
     r32 tmax = *Tmax;
@@ -58,11 +93,7 @@ intersect_ray_sphere(HitRecord *record, Ray *ray, Primitive *prim, r32 tmin, r32
         
         if (tmp < tmax && tmp > tmin)
         {
-            record->t = tmp;
-            record->point = ray_move_along(ray, record->t);
-            record->normal = v3_divf(v3_sub(record->point, sphere->origin), sphere->radius);
-            record->material = sphere->material;
-            hit_rec_set_face_normal(record, ray);
+            hit->t = tmp;
             Result = true;
         }
         else
@@ -70,11 +101,7 @@ intersect_ray_sphere(HitRecord *record, Ray *ray, Primitive *prim, r32 tmin, r32
             tmp = (-B + root) / (A);
             if (tmp < tmax && tmp > tmin)
             {
-                record->t = tmp;
-                record->point = ray_move_along(ray, record->t);
-                record->normal = v3_divf(v3_sub(record->point, sphere->origin), sphere->radius);
-                record->material = sphere->material;
-                hit_rec_set_face_normal(record, ray);
+                hit->t = tmp;
                 Result = true;
             }
         }
@@ -84,7 +111,7 @@ intersect_ray_sphere(HitRecord *record, Ray *ray, Primitive *prim, r32 tmin, r32
 }
 
 file_internal bool 
-intersect_ray_dynamic_sphere(HitRecord               *Record,
+intersect_ray_dynamic_sphere(Hit                     *hit,
                              Ray                     *ray,
                              Primitive *prim,
                              r32                      Tmin,
@@ -110,11 +137,7 @@ intersect_ray_dynamic_sphere(HitRecord               *Record,
         
         if (Tmp < Tmax && Tmp > Tmin)
         {
-            Record->t = Tmp;
-            Record->point = ray_move_along(ray, Record->t);
-            Record->normal = v3_divf(v3_sub(Record->point, SphereCenter), sphere->radius);
-            Record->material = sphere->material;
-            hit_rec_set_face_normal(Record, ray);
+            hit->t = Tmp;
             Result = true;
         }
         else
@@ -122,11 +145,7 @@ intersect_ray_dynamic_sphere(HitRecord               *Record,
             Tmp = (-B + Root) / (A);
             if (Tmp < Tmax && Tmp > Tmin)
             {
-                Record->t = Tmp;
-                Record->point = ray_move_along(ray, Record->t);
-                Record->normal = v3_divf(v3_sub(Record->point, SphereCenter), sphere->radius);
-                Record->material = sphere->material;
-                hit_rec_set_face_normal(Record, ray);
+                hit->t = Tmp;
                 Result = true;
             }
         }
@@ -135,64 +154,44 @@ intersect_ray_dynamic_sphere(HitRecord               *Record,
     return Result;
 }
 
-file_internal bool 
-intersect_ray_aabb(Ray *ray, Aabb *aabb, r32 tmin, r32 tmax)
-{
-    for (int a = 0; a < 3; ++a)
-    {
-        // Fast AABB
-        r32 invd = 1.0f / ray->dir.p[a];
-        r32 t0 = (aabb->min.p[a] - ray->orig.p[a]) * invd;
-        r32 t1 = (aabb->max.p[a] - ray->orig.p[a]) * invd;
-        if (t1 < t0)
-        {
-            fast_swapf(t0, t1);
-        }
-        
-        tmin = t0 > tmin ? t0 : tmin;
-        tmax = t1 < tmax ? t1 : tmax;
-        if (tmax < tmin) return false;
-    }
-    return true;
-}
-
-file_internal bool 
-intersect_ray_bvh_node(HitRecord  *record,
-                       Ray        *ray,
-                       Primitive *prim,
-                       r32         tmin, 
-                       r32        *tmax)
+// Slab test against a box using a precomputed reciprocal ray direction. Returns the
+// entry distance, or R32_MAX if the ray misses the box within [tmin, tmax]. The exit
+// distance is padded by AABB_EXIT_SCALE.
+file_internal r32 
+intersect_ray_aabb_dist(v3 orig, v3 inv_dir, v3 min, v3 max, r32 tmin, r32 tmax)
 {
-    BvhNode *bvh_node = &prim->bvh_node;
+    r32 tx0 = (min.x - orig.x) * inv_dir.x;
+    r32 tx1 = (max.x - orig.x) * inv_dir.x;
+    r32 ty0 = (min.y - orig.y) * inv_dir.y;
+    r32 ty1 = (max.y - orig.y) * inv_dir.y;
+    r32 tz0 = (min.z - orig.z) * inv_dir.z;
+    r32 tz1 = (max.z - orig.z) * inv_dir.z;
     
-    if (!intersect_ray_aabb(ray, &bvh_node->aabb, tmin, *tmax))
-    {
-        return false;
-    }
+    r32 t_enter = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)), fmaxf(fminf(tz0, tz1), tmin));
+    r32 t_exit  = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)), fmaxf(tz0, tz1)) * AABB_EXIT_SCALE;
+    t_exit = fminf(t_exit, tmax);
     
-    bool hit_left  = intersect_ray_primitive(record, ray, bvh_node->left,  tmin, tmax);
-    bool hit_right = intersect_ray_primitive(record, ray, bvh_node->right, tmin, hit_left ? &record->t : tmax);
-    return hit_left || hit_right;
+    return (t_enter <= t_exit) ? t_enter : R32_MAX;
 }
 
 file_internal bool 
-intersect_ray_primitive(HitRecord  *record,
+intersect_ray_primitive(Hit        *hit,
                         Ray        *ray,
-                        Primitive  *primitive,
+                        Primitive  *primitives,
+                        u32         index,
                         r32         tmin, 
                         r32        *tmax)
 {
-    HitRecord tmp_record{};
-    bool hit_anything = false;
-    
-    if (g_intersection_look_up[primitive->type](&tmp_record, ray, primitive, tmin, tmax))
+    // The candidate is written straight into the caller's Hit, a test only succeeds
+    // when it is closer than everything found so far
+    if (g_intersection_look_up[primitives[index].type](hit, ray, &primitives[index], tmin, tmax))
     {
-        *tmax = tmp_record.t;
-        *record = tmp_record;
-        hit_anything = true;
+        hit->primitive = index;
+        *tmax = hit->t;
+        return true;
     }
     
-    return hit_anything;
+    return false;
 }
 
 file_internal bool 
@@ -204,25 +203,46 @@ intersect_ray_scene(HitRecord *record,
 {
     bool hit_anything = false;
     r32 closest_hit = tmax;
+    Hit hit{};
+    
+    tls_rays_traced++;
     
-    if (scene->bvh_tree)
+    if (scene->bvh)
     {
-        if (intersect_ray_bvh_node(record, ray, scene->bvh_tree, tmin, &closest_hit))
+        if (intersect_ray_bvh(&hit, ray, scene->bvh, scene->primitives, tmin, &closest_hit))
             hit_anything = true;
     }
     else
     {
         for (u32 i = 0; i < scene->primitives_count; ++i)
         {
-            Primitive *primitive = &scene->primitives[i];
-            if (intersect_ray_primitive(record, ray, primitive, tmin, &closest_hit)) 
+            if (intersect_ray_primitive(&hit, ray, scene->primitives, i, tmin, &closest_hit)) 
                 hit_anything = true;
         }
     }
     
+    if (hit_anything) hit_rec_resolve(record, &hit, ray, scene);
     return hit_anything;
 }
 
+file_internal bool
+intersect_ray_scene_any(Ray *ray, Scene *scene, r32 tmin, r32 tmax)
+{
+    tls_rays_traced++;
+    
+    if (scene->bvh)
+    {
+        return intersect_ray_bvh_any(ray, scene->bvh, scene->primitives, tmin, tmax);
+    }
+    
+    Hit hit;
+    for (u32 i = 0; i < scene->primitives_count; ++i)
+    {
+        if (intersect_ray_primitive(&hit, ray, scene->primitives, i, tmin, &tmax)) return true;
+    }
+    return false;
+}
+
 file_internal void
 build_surrounding_box(Aabb *result, Aabb *box0, Aabb *box1)
 {
@@ -239,6 +259,27 @@ build_surrounding_box(Aabb *result, Aabb *box0, Aabb *box1)
     };
 }
 
+file_internal void
+aabb_make_empty(Aabb *aabb)
+{
+    aabb->min = { R32_MAX, R32_MAX, R32_MAX };
+    aabb->max = { R32_MIN, R32_MIN, R32_MIN };
+}
+
+file_internal void
+aabb_grow(Aabb *aabb, Aabb *other)
+{
+    aabb->min = { fminf(aabb->min.x, other->min.x), fminf(aabb->min.y, other->min.y), fminf(aabb->min.z, other->min.z) };
+    aabb->max = { fmaxf(aabb->max.x, other->max.x), fmaxf(aabb->max.y, other->max.y), fmaxf(aabb->max.z, other->max.z) };
+}
+
+file_internal r32
+aabb_surface_area(Aabb *aabb)
+{
+    v3 e = v3_sub(aabb->max, aabb->min);
+    return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
 file_internal void
 build_aabb_sphere(Aabb *aabb, PrimitiveSphere *sphere, r32 t0, r32 t1)
 {
@@ -274,9 +315,9 @@ build_aabb_primitive(Aabb *aabb, Primitive *primitive, r32 t0, r32 t1)
     {
         build_aabb_dyn_sphere(aabb, &primitive->dyn_sphere, t0, t1);
     }
-    else if (primitive->type == Primitive_BvhNode)
+    else if (primitive->type == Primitive_MeshInstance)
     {
-        *aabb = primitive->bvh_node.aabb;
+        build_aabb_mesh_instance(aabb, &primitive->mesh_instance, t0, t1);
     }
 }
 
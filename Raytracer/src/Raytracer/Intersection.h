@@ -1,13 +1,24 @@
 #ifndef _RAYTRACER_INTERSECTION_H
 #define _RAYTRACER_INTERSECTION_H
 
+// Candidate hit carried through traversal. It is kept small since one is written for
+// every closer hit found; the full HitRecord is rebuilt once, for the closest hit only.
+struct Hit
+{
+    r32 t;
+    u32 primitive; // index into Scene::primitives
+    u32 element;   // triangle within a mesh instance, unused by spheres
+    r32 b1, b2;    // barycentric weights of the triangle's second and third vertex
+};
+
 struct HitRecord
 {
-    Material material;
-    v3       point;
-    v3       normal;
-    b8       is_front_facing;
-    r32      t;
+    Material *material; // entry in Scene::materials
+    v3        point;
+    v3        normal;
+    b8        is_front_facing;
+    r32       t;
+    u32       primitive; // index into Scene::primitives
 };
 
 struct Aabb
@@ -16,7 +27,15 @@ struct Aabb
     v3 max;
 };
 
+// Slab tests scale the exit distance by this to cover the worst case rounding error of the
+// slab math (Ize, "Robust BVH Ray Traversal"), so rays through a shared triangle vertex or
+// edge cannot miss every box that contains it
+constexpr r32 AABB_EXIT_SCALE = 1.0f + 2.0f * 3.0f * (FLT_EPSILON * 0.5f) / (1.0f - 3.0f * (FLT_EPSILON * 0.5f));
+
 file_internal void hit_rec_set_face_normal(HitRecord *record, struct Ray *ray);
+file_internal void hit_rec_from_sphere(HitRecord *record, struct Ray *ray, v3 center, r32 radius, r32 t);
+// Reconstructs point, normal and material of the closest hit
+file_internal void hit_rec_resolve(HitRecord *record, Hit *hit, struct Ray *ray, struct Scene *scene);
 
 file_internal bool hit_sphere(v3 *center, r32 radius, struct Ray *r);
 
@@ -25,25 +44,26 @@ file_internal bool intersect_ray_scene(HitRecord    *record,
                                        struct Scene *scene,
                                        r32           tmin, 
                                        r32           tmax);
-file_internal bool intersect_ray_primitive(HitRecord        *record,
+// Shadow ray query, true if anything is hit within [tmin, tmax]. Cheaper than the closest
+// hit query as traversal ends at the first occluder and no HitRecord is built.
+file_internal bool intersect_ray_scene_any(struct Ray   *ray,
+                                           struct Scene *scene,
+                                           r32           tmin,
+                                           r32           tmax);
+// Tests primitives[index], on a closer hit fills in *hit and lowers *tmax
+file_internal bool intersect_ray_primitive(Hit              *hit,
                                            struct Ray       *ray,
-                                           struct Primitive *primitive,
+                                           struct Primitive *primitives,
+                                           u32               index,
                                            r32               tmin, 
                                            r32              *tmax);
-file_internal bool intersect_ray_dynamic_sphere(HitRecord                     *record,
-                                                struct Ray                    *ray,
-                                                struct PrimitiveDynamicSphere *sphere,
-                                                r32                            tmin,
-                                                r32                            tmax);
-file_internal bool intersect_ray_sphere(HitRecord              *record, 
-                                        struct Ray             *ray, 
-                                        struct PrimitiveSphere *sphere, 
-                                        r32                     tmin, 
-                                        r32                     tmax);
-
-file_internal bool intersect_ray_aabb(struct Ray *ray, Aabb *aabb, r32 tmin, r32 tmax);
+
+file_internal r32  intersect_ray_aabb_dist(v3 orig, v3 inv_dir, v3 min, v3 max, r32 tmin, r32 tmax);
 
 file_internal void build_surrounding_box(Aabb *result, Aabb *box0, Aabb *box1);
+file_internal void aabb_make_empty(Aabb *aabb);
+file_internal void aabb_grow(Aabb *aabb, Aabb *other);
+file_internal r32  aabb_surface_area(Aabb *aabb);
 file_internal void build_aabb_sphere(Aabb *aabb, struct PrimitiveSphere *sphere, r32 t0, r32 t1);
 file_internal void build_aabb_dyn_sphere(Aabb *aabb, struct PrimitiveDynamicSphere *sphere, r32 t0, r32 t1);
 file_internal void build_aabb_primitive(Aabb *aabb, struct Primitive *primitive, r32 t0, r32 t1);
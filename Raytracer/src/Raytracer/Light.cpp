@@ -0,0 +1,111 @@
+
+file_internal void
+scene_build_lights(Scene *scene)
+{
+    free(scene->lights);
+    scene->lights = 0;
+    scene->lights_count = 0;
+    
+    for (u32 i = 0; i < scene->primitives_count; ++i)
+    {
+        Primitive *prim = &scene->primitives[i];
+        if (prim->type == Primitive_MeshInstance) continue;
+        if (scene->materials[prim->material_id].type != Material_Emissive) continue;
+        
+        if (!scene->lights) scene->lights = (u32*)malloc(sizeof(u32) * scene->primitives_count);
+        scene->lights[scene->lights_count++] = i;
+    }
+}
+
+FORCE_INLINE void
+light_sphere_at(Primitive *prim, r32 time, v3 *center, r32 *radius)
+{
+    if (prim->type == Primitive_DynamicSphere)
+    {
+        *center = get_sphere_center(&prim->dyn_sphere, time);
+        *radius = prim->dyn_sphere.radius;
+    }
+    else
+    {
+        *center = prim->sphere.origin;
+        *radius = prim->sphere.radius;
+    }
+}
+
+// Solid angle of the cone the sphere subtends is 2pi * (1 - cos_max). 1 - cos_max is
+// formed as sin^2 / (1 + cos_max) so small, distant lights keep their precision.
+FORCE_INLINE r32
+light_cone_pdf(r32 sin2_max, r32 cos_max)
+{
+    return (1.0f + cos_max) / (2.0f * MM_PI * sin2_max);
+}
+
+file_internal bool
+light_sample(LightSample *sample, Scene *scene, v3 point, r32 time, Rng *rng)
+{
+    if (scene->lights_count == 0) return false;
+    
+    u32 pick = (u32)(rng_next(rng) * (r32)scene->lights_count);
+    if (pick >= scene->lights_count) pick = scene->lights_count - 1;
+    Primitive *prim = &scene->primitives[scene->lights[pick]];
+    
+    v3 center;
+    r32 radius;
+    light_sphere_at(prim, time, &center, &radius);
+    
+    v3 to_center = v3_sub(center, point);
+    r32 dist_sq = v3_mag_sq(to_center);
+    r32 radius_sq = radius * radius;
+    if (dist_sq <= radius_sq) return false;
+    
+    r32 dist = sqrtf(dist_sq);
+    r32 sin2_max = radius_sq / dist_sq;
+    r32 cos_max  = sqrtf(fmaxf(0.0f, 1.0f - sin2_max));
+    
+    // Uniform direction in the cone around the light's center
+    r32 u1 = rng_next(rng);
+    r32 u2 = rng_next(rng);
+    r32 one_minus_cos = u1 * sin2_max / (1.0f + cos_max);
+    r32 cos_theta = 1.0f - one_minus_cos;
+    r32 sin_theta = sqrtf(fmaxf(0.0f, one_minus_cos * (2.0f - one_minus_cos)));
+    r32 phi = 2.0f * MM_PI * u2;
+    
+    // Orthonormal basis around the center direction (Duff et al. 2017)
+    v3 w = v3_divf(to_center, dist);
+    r32 sign = copysignf(1.0f, w.z);
+    r32 a = -1.0f / (sign + w.z);
+    r32 b = w.x * w.y * a;
+    v3 u = { 1.0f + sign * w.x * w.x * a, sign * b, -sign * w.x };
+    v3 v = { b, sign + w.y * w.y * a, -w.y };
+    
+    sample->dir = v3_add(v3_add(v3_mulf(u, sin_theta * cosf(phi)), v3_mulf(v, sin_theta * sinf(phi))),
+                         v3_mulf(w, cos_theta));
+    
+    // Nearest intersection along the sampled direction
+    r32 proj = dist * cos_theta;
+    sample->dist = proj - sqrtf(fmaxf(0.0f, radius_sq - dist_sq * sin_theta * sin_theta));
+    
+    sample->pdf = light_cone_pdf(sin2_max, cos_max) / (r32)scene->lights_count;
+    sample->radiance = scene->materials[prim->material_id].emissive.radiance;
+    return true;
+}
+
+file_internal r32
+light_pdf(Scene *scene, u32 primitive, v3 point, r32 time)
+{
+    Primitive *prim = &scene->primitives[primitive];
+    if (scene->lights_count == 0 || prim->type == Primitive_MeshInstance) return 0.0f;
+    if (scene->materials[prim->material_id].type != Material_Emissive) return 0.0f;
+    
+    v3 center;
+    r32 radius;
+    light_sphere_at(prim, time, &center, &radius);
+    
+    r32 dist_sq = v3_mag_sq(v3_sub(center, point));
+    r32 radius_sq = radius * radius;
+    if (dist_sq <= radius_sq) return 0.0f;
+    
+    r32 sin2_max = radius_sq / dist_sq;
+    r32 cos_max  = sqrtf(fmaxf(0.0f, 1.0f - sin2_max));
+    return light_cone_pdf(sin2_max, cos_max) / (r32)scene->lights_count;
+}
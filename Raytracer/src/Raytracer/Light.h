@@ -0,0 +1,25 @@
+#ifndef _RAYTRACER_LIGHT_H
+#define _RAYTRACER_LIGHT_H
+
+// Explicit light sampling for next event estimation. The lights are the emissive spheres
+// in Scene::lights; a shading point picks one uniformly and samples the cone of directions
+// it subtends, which covers exactly the part of the sphere visible from the point.
+// Emissive meshes are not in the list and are only found by BSDF sampling.
+
+struct LightSample
+{
+    v3  dir;      // unit direction from the shading point towards the light
+    r32 dist;     // distance to the sampled point on the light's surface
+    r32 pdf;      // solid angle density, including the 1 / lights_count of picking the light
+    v3  radiance;
+};
+
+// Fills in the list of emissive spheres, call once every primitive is in the scene
+file_internal void scene_build_lights(struct Scene *scene);
+// Returns false if no sample could be taken, e.g. the point is inside the chosen light
+file_internal bool light_sample(LightSample *sample, struct Scene *scene, v3 point, r32 time, Rng *rng);
+// Density light_sample would have given a ray from point that hit primitives[primitive].
+// 0 for primitives that are not in the light list.
+file_internal r32  light_pdf(struct Scene *scene, u32 primitive, v3 point, r32 time);
+
+#endif //_RAYTRACER_LIGHT_H
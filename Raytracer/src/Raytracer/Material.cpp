@@ -1,74 +1,118 @@
 
 file_internal bool 
-material_scatter(HitRecord *record, Ray *ray, Ray *scattered_ray, v3 *attentuation)
+material_scatter_lambertian(HitRecord *record, Ray *ray, Ray *scattered_ray, v3 *attentuation, Rng *rng)
 {
-    bool Result = false;
+    v3 ScatterDir = v3_add(record->normal, rng_unit_vector(rng));
+    if (v3_near_zero(ScatterDir))
+    {
+        ScatterDir = record->normal;
+    }
+    
+    scattered_ray->orig = record->point;
+    scattered_ray->dir = ScatterDir;
+    scattered_ray->time = ray->time;
+    *attentuation = record->material->lambertian.albedo;
+    return true;
+}
+
+file_internal bool 
+material_scatter_metal(HitRecord *record, Ray *ray, Ray *scattered_ray, v3 *attentuation, Rng *rng)
+{
+    v3 Reflected = reflect(v3_norm(ray->dir), record->normal);
     
-    switch (record->material.type)
+    scattered_ray->orig = record->point;
+    scattered_ray->dir    = v3_add(Reflected, v3_mulf(rng_in_unit_sphere(rng), record->material->metal.fuzz));
+    scattered_ray->time = ray->time;
+    *attentuation = record->material->metal.albedo;
+    return (v3_dot(scattered_ray->dir, record->normal) > 0.0f);
+}
+
+file_internal bool 
+material_scatter_dielectric(HitRecord *record, Ray *ray, Ray *scattered_ray, v3 *attentuation, Rng *rng)
+{
+    *attentuation = V3_ONE;
+    
+    r32 Ratio = (record->is_front_facing) ? 1.0f / record->material->dielectric.ior : record->material->dielectric.ior;
+    
+    v3 UnitDir = v3_norm(ray->dir);
+    r32 CosTheta = fminf(v3_dot(v3_mulf(UnitDir, -1.0f), record->normal), 1.0f);
+    r32 SinTheta = sqrtf(1.0f - CosTheta * CosTheta);
+    
+    if (Ratio * SinTheta > 1.0f)
     {
-        case Material_Lambertian:
+        v3 Reflected = reflect(UnitDir, record->normal);
+        scattered_ray->orig = record->point;
+        scattered_ray->dir = Reflected;
+        scattered_ray->time = ray->time;
+    }
+    else
+    {
+        r32 ReflectProb = schlick(CosTheta, Ratio);
+        if (rng_next(rng) < ReflectProb)
         {
-            v3 ScatterDir = v3_add(record->normal, random_unit_vector());
-            if (v3_near_zero(ScatterDir))
-            {
-                ScatterDir = record->normal;
-            }
-            
+            v3 Reflected = reflect(UnitDir, record->normal);
             scattered_ray->orig = record->point;
-            scattered_ray->dir = ScatterDir;
+            scattered_ray->dir = Reflected;
             scattered_ray->time = ray->time;
-            *attentuation = record->material.lambertian.albedo;
-            Result = true;
-        } break;
-        
-        case Material_Metal:
+        }
+        else
         {
-            v3 Reflected = reflect(v3_norm(ray->dir), record->normal);
-            
             scattered_ray->orig = record->point;
-            scattered_ray->dir    = v3_add(Reflected, v3_mulf(random_in_unit_sphere(), record->material.metal.fuzz));
+            scattered_ray->dir = refract(UnitDir, record->normal, Ratio);
             scattered_ray->time = ray->time;
-            *attentuation = record->material.metal.albedo;
-            Result = (v3_dot(scattered_ray->dir, record->normal) > 0.0f);
-        } break;
-        
-        case Material_Dielectric:
+        }
+    }
+    
+    return true;
+}
+
+file_internal bool 
+material_scatter_emissive(HitRecord *record, Ray *ray, Ray *scattered_ray, v3 *attentuation, Rng *rng)
+{
+    return false;
+}
+
+file_internal v3
+material_emitted(HitRecord *record)
+{
+    v3 result = V3_ZERO;
+    if (record->material->type == Material_Emissive && record->is_front_facing)
+    {
+        result = record->material->emissive.radiance;
+    }
+    return result;
+}
+
+file_internal v3
+material_albedo(Material *material)
+{
+    v3 result = V3_ONE;
+    switch (material->type)
+    {
+        case Material_Lambertian: result = material->lambertian.albedo; break;
+        case Material_Metal:      result = material->metal.albedo;      break;
+        case Material_Emissive:
         {
-            *attentuation = V3_ONE;
-            
-            r32 Ratio = (record->is_front_facing) ? 1.0f / record->material.dielectric.ior : record->material.dielectric.ior;
-            
-            v3 UnitDir = v3_norm(ray->dir);
-            r32 CosTheta = fminf(v3_dot(v3_mulf(UnitDir, -1.0f), record->normal), 1.0f);
-            r32 SinTheta = sqrtf(1.0f - CosTheta * CosTheta);
-            
-            if (Ratio * SinTheta > 1.0f)
-            {
-                v3 Reflected = reflect(UnitDir, record->normal);
-                scattered_ray->orig = record->point;
-                scattered_ray->dir = Reflected;
-                scattered_ray->time = ray->time;
-            }
-            else
-            {
-                r32 ReflectProb = schlick(CosTheta, Ratio);
-                if (random() < ReflectProb)
-                {
-                    v3 Reflected = reflect(UnitDir, record->normal);
-                    scattered_ray->orig = record->point;
-                    scattered_ray->dir = Reflected;
-                    scattered_ray->time = ray->time;
-                }
-                else
-                {
-                    scattered_ray->orig = record->point;
-                    scattered_ray->dir = refract(UnitDir, record->normal, Ratio);
-                    scattered_ray->time = ray->time;
-                }
-            }
-            
-            Result = true;
-        };
+            v3 radiance = material->emissive.radiance;
+            result = { fast_minf(radiance.r, 1.0f), fast_minf(radiance.g, 1.0f), fast_minf(radiance.b, 1.0f) };
+        } break;
+        default: break; // dielectrics pass light through untinted
+    }
+    return result;
+}
+
+file_internal bool 
+material_scatter(HitRecord *record, Ray *ray, Ray *scattered_ray, v3 *attentuation, Rng *rng)
+{
+    bool Result = false;
+    
+    switch (record->material->type)
+    {
+        case Material_Lambertian: Result = material_scatter_lambertian(record, ray, scattered_ray, attentuation, rng); break;
+        case Material_Metal:      Result = material_scatter_metal(record, ray, scattered_ray, attentuation, rng);      break;
+        case Material_Dielectric: Result = material_scatter_dielectric(record, ray, scattered_ray, attentuation, rng); break;
+        case Material_Emissive:   Result = material_scatter_emissive(record, ray, scattered_ray, attentuation, rng);   break;
+        default: break;
     }
     
     return Result;
@@ -77,6 +121,7 @@ material_scatter(HitRecord *record, Ray *ray, Ray *scattered_ray, v3 *attentuati
 file_internal void 
 make_lambertian(Material *mat, v3 Albedo)
 {
+    memset(mat, 0, sizeof(Material));
     mat->type = Material_Lambertian;
     mat->lambertian.albedo = Albedo;
 }
@@ -84,6 +129,7 @@ make_lambertian(Material *mat, v3 Albedo)
 file_internal void
 make_metal(Material *mat, v3 Albedo, r32 Fuzz)
 {
+    memset(mat, 0, sizeof(Material));
     mat->type = Material_Metal;
     mat->metal.albedo = Albedo;
     mat->metal.fuzz = Fuzz;
@@ -92,6 +138,55 @@ make_metal(Material *mat, v3 Albedo, r32 Fuzz)
 file_internal void 
 make_dielectric(Material *mat, r32 IoR)
 {
+    memset(mat, 0, sizeof(Material));
     mat->type = Material_Dielectric;
     mat->dielectric.ior = IoR;
+}
+
+file_internal void
+make_emissive(Material *mat, v3 Radiance)
+{
+    memset(mat, 0, sizeof(Material));
+    mat->type = Material_Emissive;
+    mat->emissive.radiance = Radiance;
+}
+
+FORCE_INLINE bool
+material_albedo_equal(v3 a, v3 b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+file_internal bool
+material_equal(Material *a, Material *b)
+{
+    if (a->type != b->type) return false;
+    
+    // Only the active member is compared, the rest of the union is undefined
+    switch (a->type)
+    {
+        case Material_Lambertian: return material_albedo_equal(a->lambertian.albedo, b->lambertian.albedo);
+        case Material_Metal:      return material_albedo_equal(a->metal.albedo, b->metal.albedo) && a->metal.fuzz == b->metal.fuzz;
+        case Material_Dielectric: return a->dielectric.ior == b->dielectric.ior;
+        case Material_Emissive:   return material_albedo_equal(a->emissive.radiance, b->emissive.radiance);
+        default:                  return false;
+    }
+}
+
+file_internal u64
+material_hash(Material *material)
+{
+    // Same as material_equal, only the active member is hashed. -0 and +0 compare equal
+    // but hash differently, which at worst keeps a duplicate material.
+    u32 size;
+    switch (material->type)
+    {
+        case Material_Lambertian: size = sizeof(MaterialLambertian); break;
+        case Material_Metal:      size = sizeof(MaterialMetal);      break;
+        case Material_Dielectric: size = sizeof(MaterialDielectric); break;
+        case Material_Emissive:   size = sizeof(MaterialEmissive);   break;
+        default:                  size = 0;                          break;
+    }
+    
+    return MummurHash64(&material->lambertian, size) ^ ((u64)material->type * 0x9E3779B97F4A7C15ull);
 }
\ No newline at end of file
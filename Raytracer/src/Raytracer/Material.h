@@ -6,6 +6,9 @@ enum MaterialType
     Material_Lambertian,
     Material_Metal,
     Material_Dielectric,
+    Material_Emissive,
+    
+    Material_Count,
 };
 
 struct MaterialLambertian 
@@ -24,6 +27,12 @@ struct MaterialDielectric
     r32 ior; // index of refraction
 };
 
+// Area light. Emits from its front face and absorbs everything that reaches it.
+struct MaterialEmissive
+{
+    v3 radiance;
+};
+
 struct Material
 {
     MaterialType type;
@@ -32,9 +41,26 @@ struct Material
         MaterialLambertian lambertian;
         MaterialMetal      metal;
         MaterialDielectric dielectric;
+        MaterialEmissive   emissive;
     };
 };
 
-file_internal bool material_scatter(struct HitRecord *record, struct Ray *ray, struct Ray *scattered_ray, v3 *attentuation);
+typedef bool (*material_scatter_pfn)(struct HitRecord *record, struct Ray *ray, struct Ray *scattered_ray, v3 *attentuation, Rng *rng);
+
+file_internal bool material_scatter(struct HitRecord *record, struct Ray *ray, struct Ray *scattered_ray, v3 *attentuation, Rng *rng);
+// Per-material scatter functions, used directly by the wavefront kernels
+file_internal bool material_scatter_lambertian(struct HitRecord *record, struct Ray *ray, struct Ray *scattered_ray, v3 *attentuation, Rng *rng);
+file_internal bool material_scatter_metal(struct HitRecord *record, struct Ray *ray, struct Ray *scattered_ray, v3 *attentuation, Rng *rng);
+file_internal bool material_scatter_dielectric(struct HitRecord *record, struct Ray *ray, struct Ray *scattered_ray, v3 *attentuation, Rng *rng);
+
+file_internal bool material_scatter_emissive(struct HitRecord *record, struct Ray *ray, struct Ray *scattered_ray, v3 *attentuation, Rng *rng);
+// Radiance leaving the hit point towards the ray's origin
+file_internal v3   material_emitted(struct HitRecord *record);
+// Surface color as seen by the denoiser, in [0, 1]
+file_internal v3   material_albedo(Material *material);
+
+file_internal bool material_equal(Material *a, Material *b);
+// Equal materials hash equally, see scene_add_material
+file_internal u64  material_hash(Material *material);
 
 #endif //_RAYTRACER_MATERIAL_H
@@ -0,0 +1,473 @@
+
+// Per ray setup for the watertight ray/triangle test (Woop, Benthin and Wald, 2013). The
+// ray is sheared so it points down +z, and the hit test reduces to 2D edge functions that
+// agree on shared edges, so rays can no longer slip through the seams between triangles.
+struct TriangleRay
+{
+    v3  orig;
+    i32 kx, ky, kz;
+    r32 sx, sy, sz;
+};
+
+FORCE_INLINE v3
+m4_transform_point(m4 *m, v3 p)
+{
+    return {
+        m->p[0][0] * p.x + m->p[1][0] * p.y + m->p[2][0] * p.z + m->p[3][0],
+        m->p[0][1] * p.x + m->p[1][1] * p.y + m->p[2][1] * p.z + m->p[3][1],
+        m->p[0][2] * p.x + m->p[1][2] * p.y + m->p[2][2] * p.z + m->p[3][2],
+    };
+}
+
+FORCE_INLINE v3
+m4_transform_vector(m4 *m, v3 v)
+{
+    return {
+        m->p[0][0] * v.x + m->p[1][0] * v.y + m->p[2][0] * v.z,
+        m->p[0][1] * v.x + m->p[1][1] * v.y + m->p[2][1] * v.z,
+        m->p[0][2] * v.x + m->p[1][2] * v.y + m->p[2][2] * v.z,
+    };
+}
+
+// Normals go through the inverse transpose, i.e. the transpose of world_to_object
+FORCE_INLINE v3
+m4_transform_normal(m4 *world_to_object, v3 n)
+{
+    return {
+        world_to_object->p[0][0] * n.x + world_to_object->p[0][1] * n.y + world_to_object->p[0][2] * n.z,
+        world_to_object->p[1][0] * n.x + world_to_object->p[1][1] * n.y + world_to_object->p[1][2] * n.z,
+        world_to_object->p[2][0] * n.x + world_to_object->p[2][1] * n.y + world_to_object->p[2][2] * n.z,
+    };
+}
+
+file_internal m4
+m4_affine_inverse(m4 m)
+{
+    // Inverse of the upper 3x3 through its cofactors, then the translation is undone
+    r32 a = m.p[0][0], b = m.p[1][0], c = m.p[2][0];
+    r32 d = m.p[0][1], e = m.p[1][1], f = m.p[2][1];
+    r32 g = m.p[0][2], h = m.p[1][2], i = m.p[2][2];
+
+    r32 co0 = e * i - f * h;
+    r32 co1 = f * g - d * i;
+    r32 co2 = d * h - e * g;
+    r32 det = a * co0 + b * co1 + c * co2;
+    Assert(det != 0.0f);
+    r32 inv_det = 1.0f / det;
+
+    m4 result = M4_IDENTITY;
+    result.p[0][0] = co0 * inv_det;
+    result.p[1][0] = (c * h - b * i) * inv_det;
+    result.p[2][0] = (b * f - c * e) * inv_det;
+    result.p[0][1] = co1 * inv_det;
+    result.p[1][1] = (a * i - c * g) * inv_det;
+    result.p[2][1] = (c * d - a * f) * inv_det;
+    result.p[0][2] = co2 * inv_det;
+    result.p[1][2] = (b * g - a * h) * inv_det;
+    result.p[2][2] = (a * e - b * d) * inv_det;
+
+    v3 translation = { m.p[3][0], m.p[3][1], m.p[3][2] };
+    v3 inv_translation = m4_transform_vector(&result, translation);
+    result.p[3][0] = -inv_translation.x;
+    result.p[3][1] = -inv_translation.y;
+    result.p[3][2] = -inv_translation.z;
+    return result;
+}
+
+file_internal void
+triangle_ray_setup(TriangleRay *tri_ray, Ray *ray)
+{
+    v3 abs_dir = { fabsf(ray->dir.x), fabsf(ray->dir.y), fabsf(ray->dir.z) };
+
+    i32 kz = 0;
+    if (abs_dir.y > abs_dir.p[kz]) kz = 1;
+    if (abs_dir.z > abs_dir.p[kz]) kz = 2;
+    i32 kx = (kz + 1) % 3;
+    i32 ky = (kx + 1) % 3;
+
+    // Keep the winding order when the dominant axis points backwards
+    if (ray->dir.p[kz] < 0.0f)
+    {
+        i32 tmp = kx;
+        kx = ky;
+        ky = tmp;
+    }
+
+    tri_ray->orig = ray->orig;
+    tri_ray->kx = kx;
+    tri_ray->ky = ky;
+    tri_ray->kz = kz;
+    tri_ray->sx = ray->dir.p[kx] / ray->dir.p[kz];
+    tri_ray->sy = ray->dir.p[ky] / ray->dir.p[kz];
+    tri_ray->sz = 1.0f / ray->dir.p[kz];
+}
+
+// Two sided. On a hit returns t and the barycentric weights of the second and third vertex.
+file_internal bool
+intersect_ray_triangle(TriangleRay *tri_ray, v3 v0, v3 v1, v3 v2, r32 tmin, r32 tmax, r32 *t, r32 *b1, r32 *b2)
+{
+    i32 kx = tri_ray->kx, ky = tri_ray->ky, kz = tri_ray->kz;
+
+    v3 A = v3_sub(v0, tri_ray->orig);
+    v3 B = v3_sub(v1, tri_ray->orig);
+    v3 C = v3_sub(v2, tri_ray->orig);
+
+    r32 ax = A.p[kx] - tri_ray->sx * A.p[kz];
+    r32 ay = A.p[ky] - tri_ray->sy * A.p[kz];
+    r32 bx = B.p[kx] - tri_ray->sx * B.p[kz];
+    r32 by = B.p[ky] - tri_ray->sy * B.p[kz];
+    r32 cx = C.p[kx] - tri_ray->sx * C.p[kz];
+    r32 cy = C.p[ky] - tri_ray->sy * C.p[kz];
+
+    r32 U = cx * by - cy * bx;
+    r32 V = ax * cy - ay * cx;
+    r32 W = bx * ay - by * ax;
+
+    // An edge function of exactly zero is where float rounding could open a crack, so
+    // those rays are resolved in double precision
+    if (U == 0.0f || V == 0.0f || W == 0.0f)
+    {
+        U = (r32)((r64)cx * (r64)by - (r64)cy * (r64)bx);
+        V = (r32)((r64)ax * (r64)cy - (r64)ay * (r64)cx);
+        W = (r32)((r64)bx * (r64)ay - (r64)by * (r64)ax);
+    }
+
+    if ((U < 0.0f || V < 0.0f || W < 0.0f) && (U > 0.0f || V > 0.0f || W > 0.0f))
+        return false;
+
+    r32 det = U + V + W;
+    if (det == 0.0f) return false;
+
+    r32 az = tri_ray->sz * A.p[kz];
+    r32 bz = tri_ray->sz * B.p[kz];
+    r32 cz = tri_ray->sz * C.p[kz];
+    r32 T  = U * az + V * bz + W * cz;
+
+    r32 inv_det = 1.0f / det;
+    r32 hit_t = T * inv_det;
+    if (hit_t <= tmin || hit_t >= tmax) return false;
+
+    *t  = hit_t;
+    *b1 = V * inv_det;
+    *b2 = W * inv_det;
+    return true;
+}
+
+file_internal bool
+intersect_ray_mesh_instance(Hit *hit, Ray *ray, Primitive *prim, r32 tmin, r32 *tmax)
+{
+    MeshInstance *instance = prim->mesh_instance.instance;
+    Mesh *mesh = instance->mesh;
+
+    // The direction is not renormalized, so t means the same distance in both spaces
+    Ray local;
+    local.orig = m4_transform_point(&instance->world_to_object, ray->orig);
+    local.dir  = m4_transform_vector(&instance->world_to_object, ray->dir);
+    local.time = ray->time;
+
+    TriangleRay tri_ray;
+    triangle_ray_setup(&tri_ray, &local);
+
+    r32 closest = *tmax;
+    return bvh_traverse(&mesh->blas, &local, tmin, &closest, [&](u32 triangle, r32 *tri_tmax) {
+        u32 *idx = mesh->indices + 3 * triangle;
+        r32 t, b1, b2;
+        if (intersect_ray_triangle(&tri_ray, mesh->vertices[idx[0]], mesh->vertices[idx[1]], mesh->vertices[idx[2]],
+                                   tmin, *tri_tmax, &t, &b1, &b2))
+        {
+            *tri_tmax    = t;
+            hit->t       = t;
+            hit->element = triangle;
+            hit->b1      = b1;
+            hit->b2      = b2;
+            return true;
+        }
+        return false;
+    });
+}
+
+file_internal void
+hit_rec_from_mesh_instance(HitRecord *record, Ray *ray, PrimitiveMeshInstance *mesh_instance, Hit *hit)
+{
+    MeshInstance *instance = mesh_instance->instance;
+    Mesh *mesh = instance->mesh;
+
+    u32 *idx = mesh->indices + 3 * hit->element;
+    v3 v0 = mesh->vertices[idx[0]];
+    v3 normal = v3_cross(v3_sub(mesh->vertices[idx[1]], v0), v3_sub(mesh->vertices[idx[2]], v0));
+
+    record->t      = hit->t;
+    record->point  = ray_move_along(ray, hit->t);
+    record->normal = v3_norm(m4_transform_normal(&instance->world_to_object, normal));
+    hit_rec_set_face_normal(record, ray);
+}
+
+file_internal void
+build_aabb_mesh_instance(Aabb *aabb, PrimitiveMeshInstance *mesh_instance, r32 t0, r32 t1)
+{
+    *aabb = mesh_instance->instance->bounds;
+}
+
+file_internal void
+mesh_init(Mesh *mesh, u32 vertex_count, u32 triangle_count)
+{
+    memset(mesh, 0, sizeof(Mesh));
+    mesh->vertex_count   = vertex_count;
+    mesh->triangle_count = triangle_count;
+
+    u64 vertex_size = sizeof(v3) * (u64)vertex_count;
+    u64 index_size  = sizeof(u32) * 3 * (u64)triangle_count;
+    if (vertex_size + index_size == 0) return;
+
+    mesh->backing  = PlatformAlloc(vertex_size + index_size);
+    mesh->vertices = (v3*)mesh->backing;
+    mesh->indices  = (u32*)((u8*)mesh->backing + vertex_size);
+}
+
+file_internal void
+mesh_free(Mesh *mesh)
+{
+    bvh_free(&mesh->blas);
+    if (mesh->backing) PlatformFree(mesh->backing);
+    memset(mesh, 0, sizeof(Mesh));
+}
+
+file_internal void
+mesh_build_blas(Mesh *mesh)
+{
+    Aabb *boxes = (Aabb*)PlatformAlloc(sizeof(Aabb) * (u64)fast_max(1, mesh->triangle_count));
+    for (u32 tri = 0; tri < mesh->triangle_count; ++tri)
+    {
+        u32 *idx = mesh->indices + 3 * tri;
+        v3 v0 = mesh->vertices[idx[0]];
+        v3 v1 = mesh->vertices[idx[1]];
+        v3 v2 = mesh->vertices[idx[2]];
+
+        boxes[tri].min = { fminf(v0.x, fminf(v1.x, v2.x)), fminf(v0.y, fminf(v1.y, v2.y)), fminf(v0.z, fminf(v1.z, v2.z)) };
+        boxes[tri].max = { fmaxf(v0.x, fmaxf(v1.x, v2.x)), fmaxf(v0.y, fmaxf(v1.y, v2.y)), fmaxf(v0.z, fmaxf(v1.z, v2.z)) };
+    }
+
+    bvh_build_from_boxes(&mesh->blas, boxes, mesh->triangle_count);
+    PlatformFree(boxes);
+}
+
+//~ OBJ loading
+
+FORCE_INLINE char*
+obj_skip_blank(char *at, char *end)
+{
+    while (at < end && (*at == ' ' || *at == '\t')) ++at;
+    return at;
+}
+
+FORCE_INLINE char*
+obj_skip_token(char *at, char *end)
+{
+    while (at < end && *at != ' ' && *at != '\t' && *at != '\r' && *at != '\n') ++at;
+    return at;
+}
+
+// Walks the file once. With a null mesh only the vertex and triangle totals are counted,
+// otherwise the (already sized) buffers are filled in. Polygons are fan triangulated and
+// only the position index of each "v/vt/vn" corner is used.
+file_internal bool
+obj_parse(char *text, u32 size, Mesh *mesh, u32 *vertex_count, u32 *triangle_count)
+{
+    char *at  = text;
+    char *end = text + size;
+
+    u32 vertices  = 0;
+    u32 triangles = 0;
+
+    while (at < end)
+    {
+        char *line_end = at;
+        while (line_end < end && *line_end != '\n') ++line_end;
+
+        at = obj_skip_blank(at, line_end);
+        if (line_end - at >= 2 && at[0] == 'v' && (at[1] == ' ' || at[1] == '\t'))
+        {
+            if (mesh)
+            {
+                v3 *vertex = &mesh->vertices[vertices];
+                at += 2;
+                for (u32 c = 0; c < 3; ++c)
+                {
+                    vertex->p[c] = strtof(at, &at);
+                }
+            }
+            ++vertices;
+        }
+        else if (line_end - at >= 2 && at[0] == 'f' && (at[1] == ' ' || at[1] == '\t'))
+        {
+            u32 corners = 0;
+            u32 first = 0, prev = 0;
+
+            at += 2;
+            for (;;)
+            {
+                at = obj_skip_blank(at, line_end);
+                if (at >= line_end || !(*at == '-' || (*at >= '0' && *at <= '9'))) break;
+
+                char *next;
+                i64 index = strtol(at, &next, 10);
+                at = obj_skip_token(next, line_end);
+
+                if (mesh)
+                {
+                    // Indices are one based, negative ones count back from the last vertex
+                    i64 resolved = (index < 0) ? (i64)vertices + index : index - 1;
+                    if (resolved < 0 || resolved >= (i64)vertices)
+                    {
+                        LogError("OBJ face references vertex %lld, only %d vertices are defined", index, vertices);
+                        return false;
+                    }
+
+                    u32 vertex = (u32)resolved;
+                    if (corners == 0)
+                    {
+                        first = vertex;
+                    }
+                    else if (corners >= 2)
+                    {
+                        u32 *tri = mesh->indices + 3 * (triangles + corners - 2);
+                        tri[0] = first;
+                        tri[1] = prev;
+                        tri[2] = vertex;
+                    }
+                    prev = vertex;
+                }
+                ++corners;
+            }
+
+            if (corners >= 3) triangles += corners - 2;
+        }
+
+        at = line_end + 1;
+    }
+
+    *vertex_count   = vertices;
+    *triangle_count = triangles;
+    return true;
+}
+
+file_internal bool
+mesh_load_obj(Mesh *mesh, const char *file_path)
+{
+    memset(mesh, 0, sizeof(Mesh));
+
+    u8 *buffer;
+    u32 size;
+    if (PlatformReadFileToBuffer(file_path, &buffer, &size) != PlatformError_Success)
+    {
+        LogError("Unable to read mesh %s", file_path);
+        return false;
+    }
+    buffer[size] = 0;
+
+    // First pass sizes the buffers so the second can write every vertex and index in
+    // place, without growing anything per triangle
+    u32 vertex_count, triangle_count;
+    obj_parse((char*)buffer, size, 0, &vertex_count, &triangle_count);
+    mesh_init(mesh, vertex_count, triangle_count);
+
+    bool result = obj_parse((char*)buffer, size, mesh, &vertex_count, &triangle_count);
+    MemFree(buffer);
+
+    if (!result)
+    {
+        mesh_free(mesh);
+        return false;
+    }
+
+    mesh_build_blas(mesh);
+    return true;
+}
+
+file_internal bool
+mesh_load_binary(Mesh *mesh, const char *file_path)
+{
+    memset(mesh, 0, sizeof(Mesh));
+
+    u8 *buffer;
+    u32 size;
+    if (PlatformReadFileToBuffer(file_path, &buffer, &size) != PlatformError_Success)
+    {
+        LogError("Unable to read mesh %s", file_path);
+        return false;
+    }
+
+    MeshBinaryHeader *header = (MeshBinaryHeader*)buffer;
+    bool valid = size >= sizeof(MeshBinaryHeader)
+        && header->magic == MESH_BINARY_MAGIC
+        && header->version == MESH_BINARY_VERSION
+        && size == sizeof(MeshBinaryHeader)
+                   + sizeof(v3) * (u64)header->vertex_count
+                   + sizeof(u32) * 3 * (u64)header->triangle_count;
+    if (!valid)
+    {
+        LogError("%s is not a version %d binary mesh", file_path, MESH_BINARY_VERSION);
+        MemFree(buffer);
+        return false;
+    }
+
+    mesh_init(mesh, header->vertex_count, header->triangle_count);
+    memcpy(mesh->backing, header + 1, size - sizeof(MeshBinaryHeader));
+    MemFree(buffer);
+
+    for (u32 i = 0; i < 3 * mesh->triangle_count; ++i)
+    {
+        if (mesh->indices[i] >= mesh->vertex_count)
+        {
+            LogError("%s references vertex %d, only %d vertices are defined", file_path, mesh->indices[i], mesh->vertex_count);
+            mesh_free(mesh);
+            return false;
+        }
+    }
+
+    mesh_build_blas(mesh);
+    return true;
+}
+
+file_internal bool
+mesh_write_binary(Mesh *mesh, const char *file_path)
+{
+    MeshBinaryHeader header;
+    header.magic          = MESH_BINARY_MAGIC;
+    header.version        = MESH_BINARY_VERSION;
+    header.vertex_count   = mesh->vertex_count;
+    header.triangle_count = mesh->triangle_count;
+
+    u64 body_size = sizeof(v3) * (u64)mesh->vertex_count + sizeof(u32) * 3 * (u64)mesh->triangle_count;
+
+    // Written with a single call, the vertex and index buffers are already contiguous
+    u8 *file = (u8*)PlatformAlloc(sizeof(header) + body_size);
+    memcpy(file, &header, sizeof(header));
+    if (body_size > 0) memcpy(file + sizeof(header), mesh->backing, body_size);
+
+    PlatformErrorType err = PlatformWriteBufferToFile(file_path, file, sizeof(header) + body_size);
+    PlatformFree(file);
+
+    return err == PlatformError_Success;
+}
+
+file_internal void
+mesh_instance_init(MeshInstance *instance, Mesh *mesh, m4 object_to_world)
+{
+    instance->mesh            = mesh;
+    instance->object_to_world = object_to_world;
+    instance->world_to_object = m4_affine_inverse(object_to_world);
+
+    // World bounds from the eight corners of the object space root box
+    aabb_make_empty(&instance->bounds);
+    if (mesh->blas.nodes_count == 0) return;
+
+    v3 box[2] = { mesh->blas.nodes[0].min, mesh->blas.nodes[0].max };
+    for (u32 corner = 0; corner < 8; ++corner)
+    {
+        v3 p = { box[corner & 1].x, box[(corner >> 1) & 1].y, box[(corner >> 2) & 1].z };
+        Aabb point;
+        point.min = point.max = m4_transform_point(&object_to_world, p);
+        aabb_grow(&instance->bounds, &point);
+    }
+}
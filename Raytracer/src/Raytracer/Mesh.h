@@ -0,0 +1,59 @@
+#ifndef _RAYTRACER_MESH_H
+#define _RAYTRACER_MESH_H
+
+// Indexed triangle meshes. Each mesh owns a bottom level BVH over its triangles in object
+// space. A MeshInstance places a mesh in the world with an affine transform and is added
+// to the scene as a primitive, so the scene BVH acts as the top level tree over instances.
+
+constexpr u32 MESH_BINARY_MAGIC   = 0x4853454D; // "MESH"
+constexpr u32 MESH_BINARY_VERSION = 1;
+
+// Binary mesh file: the header, then vertex_count v3 positions, then 3 * triangle_count
+// u32 indices. It is the in-memory layout, so loading is a single copy.
+struct MeshBinaryHeader
+{
+    u32 magic;
+    u32 version;
+    u32 vertex_count;
+    u32 triangle_count;
+};
+
+struct Mesh
+{
+    v3  *vertices;
+    u32 *indices;        // three per triangle
+    u32  vertex_count;
+    u32  triangle_count;
+    Bvh  blas;           // over triangle indices
+    void *backing;       // vertices and indices share one allocation
+};
+
+struct MeshInstance
+{
+    Mesh *mesh;
+    m4    object_to_world; // must be affine
+    m4    world_to_object;
+    Aabb  bounds;          // world space
+};
+
+file_internal void mesh_init(Mesh *mesh, u32 vertex_count, u32 triangle_count);
+file_internal void mesh_free(Mesh *mesh);
+// Builds the triangle BVH, call after the vertex and index buffers are filled in
+file_internal void mesh_build_blas(Mesh *mesh);
+
+// Both loaders build the BVH on success. On failure the mesh is left empty.
+file_internal bool mesh_load_obj(Mesh *mesh, const char *file_path);
+file_internal bool mesh_load_binary(Mesh *mesh, const char *file_path);
+file_internal bool mesh_write_binary(Mesh *mesh, const char *file_path);
+
+file_internal void mesh_instance_init(MeshInstance *instance, Mesh *mesh, m4 object_to_world);
+
+file_internal bool intersect_ray_mesh_instance(Hit              *hit,
+                                               struct Ray       *ray,
+                                               struct Primitive *prim,
+                                               r32               tmin,
+                                               r32              *tmax);
+file_internal void hit_rec_from_mesh_instance(HitRecord *record, struct Ray *ray, struct PrimitiveMeshInstance *mesh_instance, Hit *hit);
+file_internal void build_aabb_mesh_instance(Aabb *aabb, struct PrimitiveMeshInstance *mesh_instance, r32 t0, r32 t1);
+
+#endif //_RAYTRACER_MESH_H
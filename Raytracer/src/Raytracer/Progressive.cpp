@@ -0,0 +1,389 @@
+
+FORCE_INLINE u32
+morton_compact_bits(u32 x)
+{
+    x &= 0x55555555;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0F0F0F0F;
+    x = (x | (x >> 4)) & 0x00FF00FF;
+    x = (x | (x >> 8)) & 0x0000FFFF;
+    return x;
+}
+
+file_internal void
+rt_progressive_init(RtProgressive *progressive, RaytracerSettings *settings)
+{
+    *progressive = {};
+    progressive->settings = settings;
+
+    u32 tiles_x = (settings->width  + RT_TILE_SIZE - 1) / RT_TILE_SIZE;
+    u32 tiles_y = (settings->height + RT_TILE_SIZE - 1) / RT_TILE_SIZE;
+    u32 tiles_count = tiles_x * tiles_y;
+
+    u32 pixels = settings->width * settings->height;
+    progressive->tiles      = (RtTile*)PlatformAlloc(sizeof(RtTile) * tiles_count);
+    progressive->jobs       = (RtTileJob*)PlatformAlloc(sizeof(RtTileJob) * tiles_count);
+    progressive->accum      = (v3*)PlatformAlloc(sizeof(v3) * pixels);
+    progressive->lum_sum    = (r32*)PlatformAlloc(sizeof(r32) * pixels);
+    progressive->lum_sq_sum = (r32*)PlatformAlloc(sizeof(r32) * pixels);
+    memset(progressive->accum,      0, sizeof(v3)  * pixels);
+    memset(progressive->lum_sum,    0, sizeof(r32) * pixels);
+    memset(progressive->lum_sq_sum, 0, sizeof(r32) * pixels);
+
+    if (settings->denoise || settings->albedo || settings->normal)
+    {
+        progressive->albedo_sum = (v3*)PlatformAlloc(sizeof(v3) * pixels);
+        progressive->normal_sum = (v3*)PlatformAlloc(sizeof(v3) * pixels);
+        memset(progressive->albedo_sum, 0, sizeof(v3) * pixels);
+        memset(progressive->normal_sum, 0, sizeof(v3) * pixels);
+    }
+
+    if (settings->denoise)
+    {
+        denoiser_init(&progressive->denoiser, settings->width, settings->height);
+    }
+
+    // Walk the Morton curve over the power of two square that covers the tile grid and
+    // keep the codes that land inside it. Neighbouring jobs then touch neighbouring parts
+    // of the scene, and edge tiles are simply clipped to the image.
+    u32 side = 1;
+    while (side < tiles_x || side < tiles_y) side <<= 1;
+
+    for (u32 code = 0; code < side * side; ++code)
+    {
+        u32 tx = morton_compact_bits(code);
+        u32 ty = morton_compact_bits(code >> 1);
+        if (tx >= tiles_x || ty >= tiles_y) continue;
+
+        RtTile *tile = &progressive->tiles[progressive->tiles_count++];
+        tile->x0 = tx * RT_TILE_SIZE;
+        tile->y0 = ty * RT_TILE_SIZE;
+        tile->x1 = fast_min(tile->x0 + RT_TILE_SIZE, settings->width);
+        tile->y1 = fast_min(tile->y0 + RT_TILE_SIZE, settings->height);
+        tile->spp = 0;
+        tile->converged = false;
+        tile->rays = 0;
+    }
+
+    progressive->active_tiles = progressive->tiles_count;
+}
+
+file_internal void
+rt_progressive_free(RtProgressive *progressive)
+{
+    PlatformFree(progressive->tiles);
+    PlatformFree(progressive->jobs);
+    PlatformFree(progressive->accum);
+    PlatformFree(progressive->lum_sum);
+    PlatformFree(progressive->lum_sq_sum);
+    PlatformFree(progressive->albedo_sum);
+    PlatformFree(progressive->normal_sum);
+    if (progressive->denoiser.backing) denoiser_free(&progressive->denoiser);
+    *progressive = {};
+}
+
+// Mean relative standard error of the pixel estimates in the tile
+file_internal r32
+rt_tile_error(RtProgressive *progressive, RtTile *tile)
+{
+    RaytracerSettings *settings = progressive->settings;
+    r32 inv_n = 1.0f / (r32)tile->spp;
+
+    r32 error = 0.0f;
+    for (u32 y = tile->y0; y < tile->y1; ++y)
+    {
+        for (u32 x = tile->x0; x < tile->x1; ++x)
+        {
+            u32 p = y * settings->width + x;
+            r32 mean     = progressive->lum_sum[p] * inv_n;
+            r32 variance = progressive->lum_sq_sum[p] * inv_n - mean * mean;
+            if (variance < 0.0f) variance = 0.0f;
+
+            // The small bias keeps near black pixels from demanding samples forever
+            error += sqrtf(variance * inv_n) / (mean + 1e-3f);
+        }
+    }
+
+    u32 pixels = (tile->x1 - tile->x0) * (tile->y1 - tile->y0);
+    return error / (r32)pixels;
+}
+
+FORCE_INLINE void
+rt_store_aov(r32 *aov, u32 pixel, v3 value)
+{
+    aov[pixel * 3 + 0] = value.x;
+    aov[pixel * 3 + 1] = value.y;
+    aov[pixel * 3 + 2] = value.z;
+}
+
+// Traces the tile one pixel at a time through ray_color
+file_internal void
+rt_progressive_trace(RtProgressive *progressive, RtTileJob *job)
+{
+    RaytracerSettings *settings = progressive->settings;
+    Camera *camera = settings->camera;
+    Scene  *scene  = settings->scene;
+    RtTile *tile   = job->tile;
+
+    for (u32 y = tile->y0; y < tile->y1; ++y)
+    {
+        i32 j = (i32)settings->height - 1 - (i32)y;
+
+        for (u32 x = tile->x0; x < tile->x1; ++x)
+        {
+            i32 i = (i32)x;
+            u32 p = y * settings->width + x;
+
+            v3  color   = progressive->accum[p];
+            r32 lum     = progressive->lum_sum[p];
+            r32 lum_sq  = progressive->lum_sq_sum[p];
+
+            RayAov aov_sum = {};
+            if (progressive->albedo_sum)
+            {
+                aov_sum.albedo = progressive->albedo_sum[p];
+                aov_sum.normal = progressive->normal_sum[p];
+            }
+
+            // Samples are numbered per pixel, so a finished tile is bit-identical to
+            // rendering all of its samples in one go
+            for (u32 s = tile->spp; s < job->target_spp; ++s)
+            {
+                Rng rng;
+                rt_pixel_rng(&rng, settings, i, j, s);
+
+                r32 u = (r32)(i + rng_next(&rng)) / (r32)(settings->width - 1);
+                r32 v = (r32)(j + rng_next(&rng)) / (r32)(settings->height - 1);
+
+                Ray ray{};
+                camera_get_ray(&ray, camera, u, v, &rng);
+
+                RayAov aov = {};
+                v3 sample = ray_color(&ray, scene, settings->depth, &rng, progressive->albedo_sum ? &aov : 0);
+                if (progressive->albedo_sum)
+                {
+                    aov_sum.albedo = v3_add(aov_sum.albedo, aov.albedo);
+                    aov_sum.normal = v3_add(aov_sum.normal, aov.normal);
+                }
+
+                r32 l = rt_luminance(sample);
+                color   = v3_add(color, sample);
+                lum    += l;
+                lum_sq += l * l;
+            }
+
+            progressive->accum[p]      = color;
+            progressive->lum_sum[p]    = lum;
+            progressive->lum_sq_sum[p] = lum_sq;
+
+            rt_store_pixel(settings->image, (i32)p * 3, color, job->target_spp);
+
+            if (progressive->albedo_sum)
+            {
+                progressive->albedo_sum[p] = aov_sum.albedo;
+                progressive->normal_sum[p] = aov_sum.normal;
+
+                r32 inv_n = 1.0f / (r32)job->target_spp;
+                if (settings->albedo) rt_store_aov(settings->albedo, p, v3_mulf(aov_sum.albedo, inv_n));
+                if (settings->normal) rt_store_aov(settings->normal, p, v3_mulf(aov_sum.normal, inv_n));
+            }
+        }
+    }
+}
+
+// Traces the whole tile as one wavefront batch, then resolves it. There are no AOVs on
+// this path.
+file_internal void
+rt_progressive_trace_wavefront(RtProgressive *progressive, RtTileJob *job)
+{
+    RaytracerSettings *settings = progressive->settings;
+    RtTile *tile = job->tile;
+
+    u32 first = tile->y0 * settings->width + tile->x0;
+    wavefront_trace_rect(settings, tile->x0, tile->y0, tile->x1, tile->y1, tile->spp, job->target_spp,
+                         progressive->accum + first, progressive->lum_sum + first,
+                         progressive->lum_sq_sum + first, settings->width);
+
+    for (u32 y = tile->y0; y < tile->y1; ++y)
+    {
+        for (u32 x = tile->x0; x < tile->x1; ++x)
+        {
+            u32 p = y * settings->width + x;
+            rt_store_pixel(settings->image, (i32)p * 3, progressive->accum[p], job->target_spp);
+        }
+    }
+}
+
+file_internal void
+rt_progressive_tile(void *args)
+{
+    RtTileJob *job = (RtTileJob*)args;
+    RtProgressive *progressive = job->progressive;
+    RtTile *tile = job->tile;
+
+    if (progressive->cancel)
+    {
+        PlatformAtomicDec(&progressive->pending);
+        return;
+    }
+
+    RaytracerSettings *settings = progressive->settings;
+    u64 rays_before = tls_rays_traced;
+
+    if (settings->wavefront && !progressive->albedo_sum) rt_progressive_trace_wavefront(progressive, job);
+    else                                                 rt_progressive_trace(progressive, job);
+
+    tile->spp   = job->target_spp;
+    tile->rays += tls_rays_traced - rays_before;
+
+    if (settings->noise_threshold > 0.0f && tile->spp >= RT_MIN_CONVERGE_SPP &&
+        rt_tile_error(progressive, tile) < settings->noise_threshold)
+    {
+        tile->converged = true;
+        PlatformAtomicDec(&progressive->active_tiles);
+    }
+
+    PlatformAtomicDec(&progressive->pending);
+}
+
+file_internal void
+rt_progressive_render(RtProgressive *progressive)
+{
+    RaytracerSettings *settings = progressive->settings;
+    if (settings->samples == 0) return;
+
+    u32 target_spp = 1;
+    for (;;)
+    {
+        u32 job_count = 0;
+        for (u32 t = 0; t < progressive->tiles_count; ++t)
+        {
+            RtTile *tile = &progressive->tiles[t];
+            if (tile->converged || tile->spp >= target_spp) continue;
+
+            RtTileJob *job = &progressive->jobs[job_count++];
+            job->progressive = progressive;
+            job->tile        = tile;
+            job->tiles_count = 1;
+            job->target_spp  = target_spp;
+        }
+
+        if (job_count > 0)
+        {
+            progressive->pending = job_count;
+            PlatformAsyncTaskBatch(rt_progressive_tile, progressive->jobs, sizeof(RtTileJob), job_count);
+            PlatformAwaitCounter(&progressive->pending);
+
+            if (settings->denoise) rt_progressive_denoise(progressive);
+
+            // Every tile of this pass has been resolved into settings->image
+            PlatformAtomicInc(&progressive->published_pass);
+            LogInfo("Progressive pass: %d spp, %d/%d tiles active", target_spp,
+                    progressive->active_tiles, progressive->tiles_count);
+        }
+
+        if (target_spp >= settings->samples || progressive->active_tiles == 0 || progressive->cancel)
+            break;
+
+        target_spp = (target_spp > settings->samples / RT_PASS_GROWTH)
+            ? settings->samples : target_spp * RT_PASS_GROWTH;
+    }
+}
+
+// Tiles may have stopped at different sample counts, each is loaded at its own
+file_internal void
+rt_progressive_denoise_load(void *args)
+{
+    RtTileJob *job = (RtTileJob*)args;
+    RtProgressive *progressive = job->progressive;
+    u32 width = progressive->settings->width;
+
+    for (RtTile *tile = job->tile; tile < job->tile + job->tiles_count; ++tile)
+    {
+        r32 inv_n = (tile->spp > 0) ? 1.0f / (r32)tile->spp : 0.0f; // a cancelled first pass
+
+        for (u32 y = tile->y0; y < tile->y1; ++y)
+        {
+            for (u32 x = tile->x0; x < tile->x1; ++x)
+            {
+                u32 p = y * width + x;
+                r32 mean     = progressive->lum_sum[p] * inv_n;
+                r32 variance = progressive->lum_sq_sum[p] * inv_n - mean * mean;
+                if (variance < 0.0f) variance = 0.0f;
+
+                denoiser_set_pixel(&progressive->denoiser, p,
+                                   v3_mulf(progressive->accum[p], inv_n),
+                                   variance * inv_n,
+                                   v3_mulf(progressive->albedo_sum[p], inv_n),
+                                   progressive->normal_sum[p]);
+            }
+        }
+    }
+
+    PlatformAtomicDec(&progressive->pending);
+}
+
+file_internal void
+rt_progressive_denoise_store(void *args)
+{
+    RtTileJob *job = (RtTileJob*)args;
+    RtProgressive *progressive = job->progressive;
+    RaytracerSettings *settings = progressive->settings;
+
+    for (RtTile *tile = job->tile; tile < job->tile + job->tiles_count; ++tile)
+    {
+        for (u32 y = tile->y0; y < tile->y1; ++y)
+        {
+            for (u32 x = tile->x0; x < tile->x1; ++x)
+            {
+                u32 p = y * settings->width + x;
+                rt_store_pixel(settings->image, (i32)p * 3, denoiser_get_pixel(&progressive->denoiser, p), 1);
+            }
+        }
+    }
+
+    PlatformAtomicDec(&progressive->pending);
+}
+
+file_internal void
+rt_progressive_denoise(RtProgressive *progressive)
+{
+    if (!progressive->denoiser.backing) return;
+
+    Timer timer;
+    timer_begin(&timer);
+
+    // Loading and storing a tile is only a copy, a job takes a run of Morton ordered tiles.
+    // That also keeps both batches far below the size of the Win32 pool queue.
+    u32 job_count = 0;
+    for (u32 t = 0; t < progressive->tiles_count; t += RT_DENOISE_TILES)
+    {
+        RtTileJob *job = &progressive->jobs[job_count++];
+        job->progressive = progressive;
+        job->tile        = &progressive->tiles[t];
+        job->tiles_count = fast_min(RT_DENOISE_TILES, progressive->tiles_count - t);
+    }
+
+    progressive->pending = job_count;
+    PlatformAsyncTaskBatch(rt_progressive_denoise_load, progressive->jobs, sizeof(RtTileJob), job_count);
+    PlatformAwaitCounter(&progressive->pending);
+
+    denoiser_run(&progressive->denoiser);
+
+    progressive->pending = job_count;
+    PlatformAsyncTaskBatch(rt_progressive_denoise_store, progressive->jobs, sizeof(RtTileJob), job_count);
+    PlatformAwaitCounter(&progressive->pending);
+
+    progressive->denoise_ms = timer_mili_seconds_elapsed(&timer);
+}
+
+file_internal u64
+rt_progressive_rays_traced(RtProgressive *progressive)
+{
+    u64 rays = 0;
+    for (u32 t = 0; t < progressive->tiles_count; ++t)
+    {
+        rays += progressive->tiles[t].rays;
+    }
+    return rays;
+}
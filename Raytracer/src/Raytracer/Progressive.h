@@ -0,0 +1,66 @@
+#ifndef _RAYTRACER_PROGRESSIVE_H
+#define _RAYTRACER_PROGRESSIVE_H
+
+// Progressive tile scheduler. The frame is cut into small tiles walked in Morton order,
+// and rendered in passes of growing sample counts (1, 4, 16, ... up to settings->samples)
+// into an accumulation buffer. After every pass a tile estimates its own noise level and
+// drops out of later passes once it has converged, so cheap sky tiles stop early and the
+// remaining passes are spent on the noisy ones. Every pass resolves into settings->image
+// and bumps published_pass so a viewer can pick up the preview.
+
+constexpr u32 RT_TILE_SIZE        = 16;  // tile edge in pixels
+constexpr u32 RT_PASS_GROWTH      = 4;   // each pass targets this many times the previous spp
+constexpr u32 RT_MIN_CONVERGE_SPP = 16;  // a tile is never stopped before this many samples
+constexpr u32 RT_DENOISE_TILES    = 64;  // tiles loaded into or stored from the denoiser per job
+
+struct RtTile
+{
+    u32 x0, y0, x1, y1; // pixel rect in image rows (top down), max exclusive
+    u32 spp;            // samples accumulated so far
+    b8  converged;
+    u64 rays;           // scene queries traced for this tile, camera and bounce rays
+};
+
+struct RtTileJob
+{
+    struct RtProgressive *progressive;
+    RtTile               *tile;
+    u32                   tiles_count; // tiles from tile on, only the denoise jobs take more than one
+    u32                   target_spp;
+};
+
+struct RtProgressive
+{
+    RaytracerSettings *settings;
+
+    RtTile    *tiles;        // Morton ordered
+    RtTileJob *jobs;
+    u32        tiles_count;
+
+    v3        *accum;        // per pixel radiance sum
+    r32       *lum_sum;      // per pixel luminance sum and sum of squares, for the
+    r32       *lum_sq_sum;   // variance estimate
+    v3        *albedo_sum;   // per pixel first hit AOV sums, only allocated when the
+    v3        *normal_sum;   // denoiser or the AOV outputs need them
+
+    Denoiser   denoiser;
+    r32        denoise_ms;   // time spent denoising the last pass
+
+    volatile u32 pending;        // jobs left in the current pass
+    volatile u32 published_pass; // incremented after every completed pass
+    volatile u32 active_tiles;   // tiles that have not converged yet
+    volatile u32 cancel;
+};
+
+file_internal void rt_progressive_init(RtProgressive *progressive, RaytracerSettings *settings);
+file_internal void rt_progressive_free(RtProgressive *progressive);
+// Blocks until every tile converged or reached settings->samples. The calling thread helps
+// render through PlatformAwaitCounter.
+file_internal void rt_progressive_render(RtProgressive *progressive);
+// Filters the accumulated image and overwrites settings->image with the result. Called
+// after every pass when settings->denoise is set.
+file_internal void rt_progressive_denoise(RtProgressive *progressive);
+// Rays traced over every tile so far, only exact once the render has returned
+file_internal u64  rt_progressive_rays_traced(RtProgressive *progressive);
+
+#endif //_RAYTRACER_PROGRESSIVE_H
@@ -14,8 +14,57 @@ ray_at(Ray *ray, r32 t)
     return v3_add(ray->orig, v3_mulf(ray->dir, t));
 }
 
-file_internal v3 
-ray_color(Ray *ray, struct Scene *scene, u32 depth)
+file_internal v3
+ray_sky_color(v3 dir)
+{
+    v3 unit_dir = v3_norm(dir);
+    r32 t = 0.5f * (unit_dir.y + 1.0f);
+    
+    v3 white = { 0.5f, 0.5f, 0.5f };
+    v3 blue  = {  0.5f, 0.7f, 1.0f };
+    
+    return v3_add(v3_mulf(white, (1.0f - t)), v3_mulf(blue, t));
+}
+
+// Power heuristic weight (beta = 2) of a sample taken by the strategy with density pdf
+FORCE_INLINE r32
+ray_mis_weight(r32 pdf, r32 other_pdf)
+{
+    r32 a = pdf * pdf;
+    return a / (a + other_pdf * other_pdf);
+}
+
+// Next event estimation at a lambertian hit: one shadow ray towards a sampled light,
+// weighted against the chance the cosine lobe would have found the same direction.
+file_internal v3
+ray_sample_direct(HitRecord *record, Ray *ray, Scene *scene, Rng *rng)
+{
+    v3 result = V3_ZERO;
+    
+    LightSample light;
+    if (!light_sample(&light, scene, record->point, ray->time, rng)) return result;
+    
+    r32 cos_theta = v3_dot(light.dir, record->normal);
+    if (cos_theta <= 0.0f) return result;
+    
+    // Stop short of the light so the light itself does not count as an occluder
+    Ray shadow = { record->point, light.dir, ray->time };
+    if (intersect_ray_scene_any(&shadow, scene, 0.001f, light.dist * 0.999f)) return result;
+    
+    r32 bsdf_pdf = cos_theta / MM_PI;
+    r32 weight = ray_mis_weight(light.pdf, bsdf_pdf);
+    
+    // albedo / pi * radiance * cos / pdf
+    v3 brdf = v3_mulf(record->material->lambertian.albedo, 1.0f / MM_PI);
+    result = v3_mulf(v3_mul(brdf, light.radiance), cos_theta * weight / light.pdf);
+    return result;
+}
+
+// bsdf_pdf is the solid angle density the previous bounce sampled ray->dir with, 0 for
+// camera rays and specular bounces. Emitters found by a sampled lambertian bounce share
+// the light with next event estimation, the rest are counted in full.
+file_internal v3
+ray_color_path(Ray *ray, struct Scene *scene, u32 depth, Rng *rng, r32 bsdf_pdf, RayAov *aov)
 {
     v3 result = V3_ZERO;
     
@@ -24,25 +73,56 @@ ray_color(Ray *ray, struct Scene *scene, u32 depth)
         HitRecord record{};
         if (intersect_ray_scene(&record, ray, scene, 0.001f, R32_MAX))
         {
+            if (aov)
+            {
+                aov->albedo = material_albedo(record.material);
+                aov->normal = record.normal;
+            }
+            
+            v3 emitted = material_emitted(&record);
+            if (bsdf_pdf > 0.0f && record.material->type == Material_Emissive)
+            {
+                r32 pdf = light_pdf(scene, record.primitive, ray->orig, ray->time);
+                emitted = v3_mulf(emitted, ray_mis_weight(bsdf_pdf, pdf));
+            }
+            
             Ray scattered{};
             v3 attent;
             
-            if (material_scatter(&record, ray, &scattered, &attent))
+            if (material_scatter(&record, ray, &scattered, &attent, rng))
             {
-                result = v3_mul(ray_color(&scattered, scene, depth - 1), attent);
+                // Only sample lights when the bounce can still reach one, so both strategies
+                // cover the same paths
+                v3 direct = V3_ZERO;
+                r32 next_pdf = 0.0f;
+                if (scene->lights_count > 0 && depth > 1 && record.material->type == Material_Lambertian)
+                {
+                    direct = ray_sample_direct(&record, ray, scene, rng);
+                    next_pdf = fmaxf(v3_dot(v3_norm(scattered.dir), record.normal), 0.0f) / MM_PI;
+                }
+                
+                result = v3_mul(ray_color_path(&scattered, scene, depth - 1, rng, next_pdf, 0), attent);
+                result = v3_add(result, direct);
             }
+            
+            result = v3_add(result, emitted);
         }
         else
         {
-            v3 unit_dir = v3_norm(ray->dir);
-            r32 t = 0.5f * (unit_dir.y + 1.0f);
-            
-            v3 white = { 0.5f, 0.5f, 0.5f };
-            v3 blue  = {  0.5f, 0.7f, 1.0f };
-            
-            result = v3_add(v3_mulf(white, (1.0f - t)), v3_mulf(blue, t));
+            result = v3_mulf(ray_sky_color(ray->dir), scene->sky_scale);
+            if (aov)
+            {
+                aov->albedo = V3_ONE;
+                aov->normal = v3_mulf(v3_norm(ray->dir), -1.0f);
+            }
         }
     }
     
     return result;
 }
+
+file_internal v3 
+ray_color(Ray *ray, struct Scene *scene, u32 depth, Rng *rng, RayAov *aov)
+{
+    return ray_color_path(ray, scene, depth, rng, 0.0f, aov);
+}
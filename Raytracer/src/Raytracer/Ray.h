@@ -8,8 +8,17 @@ struct Ray
     r32 time;
 };
 
+// Features of the first hit along a camera ray, guiding the denoiser
+struct RayAov
+{
+    v3 albedo;
+    v3 normal; // facing the camera, misses store the reversed ray direction
+};
+
 file_internal v3 ray_move_along(Ray *ray, r32 t);
 file_internal v3 ray_at(Ray *ray, r32 t);
-file_internal v3 ray_color(Ray *ray, struct Scene *scene, u32 depth);
+file_internal v3 ray_sky_color(v3 dir);
+// aov, if given, receives the first hit's features
+file_internal v3 ray_color(Ray *ray, struct Scene *scene, u32 depth, Rng *rng, RayAov *aov = 0);
 
 #endif //_RAYTRACER_RAY_H
@@ -1,7 +1,45 @@
 
+file_internal void
+rt_pixel_rng(Rng *rng, RaytracerSettings *settings, i32 i, i32 j, u32 sample)
+{
+    // Keyed on the image pixel rather than the job, so the output does not depend on
+    // how the image was split up or which thread rendered it
+    u32 pixel = (u32)j * settings->width + (u32)i;
+    rng_seed(rng, settings->seed, pixel, sample);
+}
+
+file_internal void
+rt_store_pixel(r32 *image, i32 idx, v3 color, u32 samples)
+{
+    r32 scale = 1.0f / (r32)samples;
+    color = v3_mulf(color, scale);
+    
+    // gamma correction. Values above 1 are kept for the float formats, the image writer
+    // clamps when it quantizes.
+    color.r = sqrtf(color.r);
+    color.g = sqrtf(color.g);
+    color.b = sqrtf(color.b);
+    
+    image[idx+0] = color.r;
+    image[idx+1] = color.g;
+    image[idx+2] = color.b;
+}
+
+FORCE_INLINE r32
+rt_luminance(v3 color)
+{
+    return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+}
+
 file_internal void 
 rt_entry(RaytracerSettings *settings)
 {
+    if (settings->wavefront)
+    {
+        wavefront_render_region(settings, 0, settings->width, settings->height - 1, 0);
+        return;
+    }
+    
     Camera *camera = settings->camera;
     r32 *image = settings->image;
     Scene *scene = settings->scene;
@@ -20,36 +58,18 @@ rt_entry(RaytracerSettings *settings)
             v3 color = V3_ZERO;
             for (u32 s = 0; s < settings->samples; ++s)
             {
-                r32 u = (r32)(i + random()) / (r32)(settings->width - 1);
-                r32 v = (r32)(j + random()) / (r32)(settings->height - 1);
+                Rng rng;
+                rt_pixel_rng(&rng, settings, i, j, s);
+                
+                r32 u = (r32)(i + rng_next(&rng)) / (r32)(settings->width - 1);
+                r32 v = (r32)(j + rng_next(&rng)) / (r32)(settings->height - 1);
                 
                 Ray ray;
-                camera_get_ray(&ray, camera, u, v);
-                color = v3_add(color, ray_color(&ray, scene, settings->depth));
+                camera_get_ray(&ray, camera, u, v, &rng);
+                color = v3_add(color, ray_color(&ray, scene, settings->depth, &rng));
             }
             
-            r32 scale = 1.0f / (r32)settings->samples;
-            color = v3_mulf(color, scale);
-            
-            // gamma correctioni
-            color.r = sqrtf(color.r);
-            color.g = sqrtf(color.b);
-            color.b = sqrtf(color.g);
-            
-            color.r = fast_clampf(0.0f, 0.9999f, color.r);
-            color.g = fast_clampf(0.0f, 0.9999f, color.g);
-            color.b = fast_clampf(0.0f, 0.9999f, color.b);
-            
-#if 0
-            image[idx++] = color.r;
-            image[idx++] = color.g;
-            image[idx++] = color.b;
-#else
-            image[idx+0] = color.r;
-            image[idx+1] = color.g;
-            image[idx+2] = color.b;
-#endif
-            
+            rt_store_pixel(image, idx, color, settings->samples);
         }
     }
     
@@ -59,8 +79,7 @@ rt_entry(RaytracerSettings *settings)
 file_internal void 
 rt_async(void *args)
 {
-    RtJob *job = (RtJob*)args;;
-    LogInfo("Beginning Raytracing job...");
+    RtJob *job = (RtJob*)args;
     
     RaytracerSettings *settings = job->settings;
     Camera *camera = settings->camera;
@@ -75,6 +94,13 @@ rt_async(void *args)
     i32 stop_j = fast_clamp(0, settings->height, start_j - scan_y);
     i32 stop_i = fast_clamp(0, settings->width,  start_i + scan_x);
     
+    if (settings->wavefront)
+    {
+        wavefront_render_region(settings, start_i, stop_i, start_j, stop_j);
+        PlatformAtomicDec(job->counter);
+        return;
+    }
+    
     i32 idx = 0;
     for (i32 j = start_j; j >= stop_j; --j)
     {
@@ -91,84 +117,20 @@ rt_async(void *args)
             v3 color = V3_ZERO;
             for (u32 s = 0; s < settings->samples; ++s)
             {
-                r32 u = (r32)(i + random()) / (r32)(settings->width - 1);
-                r32 v = (r32)(j + random()) / (r32)(settings->height - 1);
+                Rng rng;
+                rt_pixel_rng(&rng, settings, i, j, s);
+                
+                r32 u = (r32)(i + rng_next(&rng)) / (r32)(settings->width - 1);
+                r32 v = (r32)(j + rng_next(&rng)) / (r32)(settings->height - 1);
                 
                 Ray ray{};
-                camera_get_ray(&ray, camera, u, v);
-                color = v3_add(color, ray_color(&ray, scene, settings->depth));
+                camera_get_ray(&ray, camera, u, v, &rng);
+                color = v3_add(color, ray_color(&ray, scene, settings->depth, &rng));
             }
             
-            r32 scale = 1.0f / (r32)settings->samples;
-            color = v3_mulf(color, scale);
-            
-            // gamma correctioni
-            color.r = sqrtf(color.r);
-            color.g = sqrtf(color.b);
-            color.b = sqrtf(color.g);
-            
-            color.r = fast_clampf(0.0f, 0.9999f, color.r);
-            color.g = fast_clampf(0.0f, 0.9999f, color.g);
-            color.b = fast_clampf(0.0f, 0.9999f, color.b);
-            
-            image[idx+0] = color.r;
-            image[idx+1] = color.g;
-            image[idx+2] = color.b;
+            rt_store_pixel(image, idx, color, settings->samples);
         }
     }
     
     PlatformAtomicDec(job->counter);
-    LogInfo("Finished job...");
-}
-
-
-file_internal void 
-image_to_ppm(r32 *image, u32 width, u32 height)
-{
-    u32 count = 3 * width * height;
-    int exp_size = sizeof(u8) * count + 512;
-    
-    PrettyBuffer buffer;
-    pb_init(&buffer, exp_size);
-    pb_write(&buffer, "P3\n%d %d\n255\n", width, height);
-    
-#if 1
-    
-    int idx = 0;
-    for (i32 j = 0; j < height; ++j)
-    {
-        for (i32 i = 0; i < width; ++i)
-        {
-            
-            int r = static_cast<int>(255.999 * image[idx + 0]);
-            int g = static_cast<int>(255.999 * image[idx + 1]);
-            int b = static_cast<int>(255.999 * image[idx + 2]);
-            
-            pb_write(&buffer, "%d %d %d\n", r, g, b);
-            idx += 3;
-        }
-    }
-    
-#else
-    
-    for (int j = height-1; j >= 0; --j) {
-        for (int i = 0; i < width; ++i) {
-            auto r = double(i) / (width-1);
-            auto g = double(j) / (height-1);
-            auto b = 0.25;
-            
-            int ir = static_cast<int>(255.999 * r);
-            int ig = static_cast<int>(255.999 * g);
-            int ib = static_cast<int>(255.999 * b);
-            
-            pb_write(&buffer, "%d %d %d\n", ir, ig, ib);
-        }
-    }
-    
-#endif
-    
-    PlatformErrorType err = PlatformWriteBufferToFile("image.ppm", (u8*)buffer.start, buffer.size);
-    assert(err == PlatformError_Success);
-    
-    pb_free(&buffer);
 }
@@ -7,7 +7,13 @@ typedef struct
     u32            height;
     u32            samples;
     u32            depth;
+    u32            seed;      // same seed and settings give a bit-identical image
+    b8             wavefront; // trace breadth-first batches instead of recursing per sample
+    r32            noise_threshold; // progressive tiles stop below this relative error, 0 disables
+    b8             denoise;   // progressive passes are denoised before they are published
     r32           *image;
+    r32           *albedo;    // optional first hit AOVs written by the progressive path,
+    r32           *normal;    // 3 floats per pixel like image
     struct Scene  *scene;
     struct Camera *camera;
 } RaytracerSettings;
@@ -21,7 +27,8 @@ struct RtJob
 };
 
 file_internal void rt_entry(RaytracerSettings *settings);
+file_internal void rt_pixel_rng(Rng *rng, RaytracerSettings *settings, i32 i, i32 j, u32 sample);
+file_internal void rt_store_pixel(r32 *image, i32 idx, v3 color, u32 samples);
 file_internal void rt_async(void *args);
-file_internal void rt_to_ppm(r32 *image, u32 width, u32 height);
 
 #endif //_RAYTRACER_H
@@ -5,6 +5,17 @@ scene_init(Scene *scene, u32 cap)
     scene->primitives_cap = cap;
     scene->primitives_count = 0;
     scene->primitives = (Primitive*)malloc(sizeof(Primitive) * cap);
+    
+    scene->materials_cap = 16;
+    scene->materials_count = 0;
+    scene->materials = (Material*)malloc(sizeof(Material) * scene->materials_cap);
+    
+    scene->material_slots_cap = 2 * scene->materials_cap;
+    scene->material_slots = (u32*)calloc(scene->material_slots_cap, sizeof(u32));
+    
+    scene->lights = 0;
+    scene->lights_count = 0;
+    scene->sky_scale = 1.0f;
 }
 
 file_internal void 
@@ -14,6 +25,19 @@ scene_free(Scene *scene)
     scene->primitives = 0;
     scene->primitives_cap = 0;
     scene->primitives_count = 0;
+    
+    free(scene->materials);
+    scene->materials = 0;
+    scene->materials_cap = 0;
+    scene->materials_count = 0;
+    
+    free(scene->material_slots);
+    scene->material_slots = 0;
+    scene->material_slots_cap = 0;
+    
+    free(scene->lights);
+    scene->lights = 0;
+    scene->lights_count = 0;
 }
 
 file_internal void 
@@ -21,73 +45,115 @@ scene_add(Scene *scene, struct Primitive *primitive)
 {
     if (scene->primitives_count + 1 >= scene->primitives_cap)
     {
-        u32 cap = scene->primitives_cap * 2;
-        Primitive* prims = (Primitive*)malloc(sizeof(Primitive) * cap);
-        for (u32 i = 0; i < scene->primitives_count; ++i)
-            prims[i] = scene->primitives[i];
-        scene->primitives_cap = cap;
+        scene->primitives_cap *= 2;
+        scene->primitives = (Primitive*)realloc(scene->primitives, sizeof(Primitive) * scene->primitives_cap);
     }
     
     scene->primitives[scene->primitives_count++] = *primitive;
 }
 
+file_internal u32 *
+scene_find_material_slot(Scene *scene, Material *material)
+{
+    u32 mask = scene->material_slots_cap - 1;
+    u32 slot = (u32)material_hash(material) & mask;
+    while (scene->material_slots[slot] != 0)
+    {
+        if (material_equal(&scene->materials[scene->material_slots[slot] - 1], material)) break;
+        slot = (slot + 1) & mask;
+    }
+    
+    return &scene->material_slots[slot];
+}
+
+file_internal u32 
+scene_add_material(Scene *scene, Material *material)
+{
+    u32 *slot = scene_find_material_slot(scene, material);
+    if (*slot != 0) return *slot - 1;
+    
+    if (scene->materials_count == scene->materials_cap)
+    {
+        scene->materials_cap *= 2;
+        scene->materials = (Material*)realloc(scene->materials, sizeof(Material) * scene->materials_cap);
+        
+        // Keep the slots at most half full, every material is unique so there is nothing to compare
+        free(scene->material_slots);
+        scene->material_slots_cap = 2 * scene->materials_cap;
+        scene->material_slots = (u32*)calloc(scene->material_slots_cap, sizeof(u32));
+        for (u32 i = 0; i < scene->materials_count; ++i)
+        {
+            *scene_find_material_slot(scene, &scene->materials[i]) = i + 1;
+        }
+        
+        slot = scene_find_material_slot(scene, material);
+    }
+    
+    scene->materials[scene->materials_count] = *material;
+    *slot = scene->materials_count + 1;
+    return scene->materials_count++;
+}
+
 file_internal void 
-build_random_scene(Scene *scene, b8 motion_blur)
+build_random_scene(Scene *scene, b8 motion_blur, u32 seed)
 {
     const int count = 3;
     
+    Rng rng;
+    rng_seed(&rng, seed, 0);
+    
     Material mat_ground, mat_reuse;
     Primitive sphere_reuse, dyn_reuse;
     
     make_lambertian(&mat_ground, { 0.5f, 0.5f, 0.5f });
-    make_sphere(&sphere_reuse, { 0, -1000, 0 }, 1000, mat_ground);
+    make_sphere(&sphere_reuse, { 0, -1000, 0 }, 1000, scene_add_material(scene, &mat_ground));
     scene_add(scene, &sphere_reuse);
     
     for (i32 a = -count; a < count; ++a)
     {
         for (i32 b = -count; b < count; ++b)
         {
-            r32 ChooseMat = random();
-            v3 Center = { a * 0.9f * random(), 0.2f, b + 0.9f * random() };
+            r32 ChooseMat = rng_next(&rng);
+            v3 Center = { a * 0.9f * rng_next(&rng), 0.2f, b + 0.9f * rng_next(&rng) };
             
             v3 Point = { 4, 0.2f, 0 };
             if (v3_mag(v3_sub(Center, Point)) > 0.9f)
             {
                 if (ChooseMat < 0.8f)
                 {
-                    v3 Albedo = v3_mul(v3_random(), v3_random());
+                    v3 Albedo = v3_mul(rng_v3(&rng), rng_v3(&rng));
                     make_lambertian(&mat_reuse, Albedo);
                     if (motion_blur)
                     {
                         // dynamic spheres for motion blur
-                        v3 RandY = { 0, random_clamped(0, 0.5f), 0 };
+                        v3 RandY = { 0, rng_clamped(&rng, 0, 0.5f), 0 };
                         v3 Center2 = v3_add(Center, RandY);
-                        make_dynamic_sphere(&dyn_reuse, Center, Center2, 0.0f, 1.0f, 0.2f, mat_reuse);
+                        make_dynamic_sphere(&dyn_reuse, Center, Center2, 0.0f, 1.0f, 0.2f, scene_add_material(scene, &mat_reuse));
                         scene_add(scene, &dyn_reuse);
                     }
                     else
                     {
-                        make_sphere(&sphere_reuse, Center, 0.2f, mat_reuse);
+                        make_sphere(&sphere_reuse, Center, 0.2f, scene_add_material(scene, &mat_reuse));
                         scene_add(scene, &sphere_reuse);
                     }
                 }
                 else if (ChooseMat < 0.95f)
                 {
                     v3 Albedo = {
-                        0.5f * (1.0f + random()),
-                        0.5f * (1.0f + random()),
-                        0.5f * (1.0f + random())
+                        0.5f * (1.0f + rng_next(&rng)),
+                        0.5f * (1.0f + rng_next(&rng)),
+                        0.5f * (1.0f + rng_next(&rng))
                     };
                     
-                    r32 Fuzz = random_clamped(0.0f, 0.5f);
+                    r32 Fuzz = rng_clamped(&rng, 0.0f, 0.5f);
                     make_metal(&mat_reuse, Albedo, Fuzz);
-                    make_sphere(&sphere_reuse, Center, 0.2f, mat_reuse);
+                    make_sphere(&sphere_reuse, Center, 0.2f, scene_add_material(scene, &mat_reuse));
                     scene_add(scene, &sphere_reuse);
                 }
                 else
                 {
                     make_dielectric(&mat_reuse, 1.5f);
-                    make_sphere(&sphere_reuse, Center, 0.2f, mat_reuse);
+                    make_sphere(&sphere_reuse, Center, 0.2f, scene_add_material(scene, &mat_reuse));
                     scene_add(scene, &sphere_reuse);
                 }
             }
@@ -95,16 +161,36 @@ build_random_scene(Scene *scene, b8 motion_blur)
     }
     
     make_dielectric(&mat_reuse, 1.5f);
-    make_sphere(&sphere_reuse, { 0, 1, 0 }, 1.0f, mat_reuse);
+    make_sphere(&sphere_reuse, { 0, 1, 0 }, 1.0f, scene_add_material(scene, &mat_reuse));
     scene_add(scene, &sphere_reuse);
     
     make_lambertian(&mat_reuse, { 0.4f, 0.2f, 0.1f });
-    make_sphere(&sphere_reuse, { -4.0f, 1.0f, 0.0f }, 1.0f, mat_reuse);
+    make_sphere(&sphere_reuse, { -4.0f, 1.0f, 0.0f }, 1.0f, scene_add_material(scene, &mat_reuse));
     scene_add(scene, &sphere_reuse);
     
     make_metal(&mat_reuse, { 0.7f, 0.6f, 0.5f }, 0.0f);
-    make_sphere(&sphere_reuse, { 4.0f, 1.0f, 0.0f }, 1.0f, mat_reuse);
+    make_sphere(&sphere_reuse, { 4.0f, 1.0f, 0.0f }, 1.0f, scene_add_material(scene, &mat_reuse));
     scene_add(scene, &sphere_reuse);
     
-    scene->bvh_tree = 0;
+    scene->bvh = 0;
+}
+
+file_internal void
+build_lights_scene(Scene *scene, u32 seed)
+{
+    build_random_scene(scene, false, seed);
+    
+    Material mat_light;
+    Primitive light;
+    
+    // A warm key light above the three large spheres and a small cool fill to the side
+    make_emissive(&mat_light, { 10.0f, 8.5f, 6.0f });
+    make_sphere(&light, { 1.0f, 4.0f, 2.5f }, 0.75f, scene_add_material(scene, &mat_light));
+    scene_add(scene, &light);
+    
+    make_emissive(&mat_light, { 2.0f, 3.0f, 6.0f });
+    make_sphere(&light, { -2.5f, 0.4f, 2.0f }, 0.4f, scene_add_material(scene, &mat_light));
+    scene_add(scene, &light);
+    
+    scene->sky_scale = 0.05f;
 }
\ No newline at end of file
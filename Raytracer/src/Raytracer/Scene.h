@@ -7,14 +7,33 @@ struct Scene
     u32               primitives_count;
     u32               primitives_cap;
     
+    // Deduplicated material table, primitives refer to entries by index
+    Material         *materials;
+    u32               materials_count;
+    u32               materials_cap;
+    // Open addressed, holds material id + 1 and 0 for an empty slot. Power of two sized.
+    u32              *material_slots;
+    u32               material_slots_cap;
+    
+    // Emissive spheres sampled by next event estimation, see scene_build_lights
+    u32              *lights;
+    u32               lights_count;
+    
+    // Scales the sky gradient, 0 leaves the scene lit by its emitters alone
+    r32               sky_scale;
+    
     // Optional
-    struct Primitive *bvh_tree; 
+    struct Bvh       *bvh;
 };
 
 file_internal void scene_init(Scene *scene, u32 cap);
 file_internal void scene_free(Scene *scene);
 file_internal void scene_add(Scene *scene, struct Primitive *primitive);
-file_internal void build_random_scene(Scene *scene, b8 motion_blur);
+// Returns the id of an equal material already in the table, or adds it
+file_internal u32  scene_add_material(Scene *scene, Material *material);
+file_internal void build_random_scene(Scene *scene, b8 motion_blur, u32 seed);
+// The random scene at dusk, lit mostly by a few emissive spheres
+file_internal void build_lights_scene(Scene *scene, u32 seed);
 
 
 #endif //_RAYTRACER_SCENE_H
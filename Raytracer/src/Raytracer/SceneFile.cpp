@@ -0,0 +1,442 @@
+
+FORCE_INLINE u64
+scene_file_align(u64 offset)
+{
+    return (offset + SCENE_FILE_ALIGNMENT - 1) & ~(SCENE_FILE_ALIGNMENT - 1);
+}
+
+// Wide node and delta sizes for a SIMD level, 0 for the scalar kernel
+file_internal void
+scene_file_wide_sizes(SimdLevel level, u64 *node_size, u64 *delta_size)
+{
+    switch (level)
+    {
+        case SimdLevel_AVX2: *node_size = sizeof(Bvh8Node); *delta_size = sizeof(BvhWideDeltas<8>); break;
+        case SimdLevel_SSE:  *node_size = sizeof(Bvh4Node); *delta_size = sizeof(BvhWideDeltas<4>); break;
+        default:             *node_size = 0;                *delta_size = 0;                        break;
+    }
+}
+
+file_internal bool
+scene_file_write(const char *file_path, Scene *scene, Bvh *bvh, CameraCreateInfo *camera)
+{
+    for (u32 i = 0; i < scene->primitives_count; ++i)
+    {
+        if (scene->primitives[i].type == Primitive_MeshInstance)
+        {
+            LogError("Unable to write %s, mesh instances cannot be stored in a scene file", file_path);
+            return false;
+        }
+    }
+
+    SceneFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic            = SCENE_FILE_MAGIC;
+    header.version          = SCENE_FILE_VERSION;
+    header.primitive_size   = sizeof(Primitive);
+    header.material_size    = sizeof(Material);
+    header.node_size        = sizeof(BvhNode);
+    header.primitives_count = scene->primitives_count;
+    header.materials_count  = scene->materials_count;
+    header.lights_count     = scene->lights_count;
+    header.nodes_count      = bvh->nodes_count;
+    header.wide_nodes_count = bvh->wide_nodes_count;
+    header.simd_level       = bvh->simd_level;
+    header.sky_scale        = scene->sky_scale;
+    header.time0            = bvh->time0;
+    header.inv_duration     = bvh->inv_duration;
+    header.camera           = *camera;
+
+    u64 wide_node_size, wide_delta_size;
+    scene_file_wide_sizes(bvh->simd_level, &wide_node_size, &wide_delta_size);
+
+    const void *sources[SceneFileSection_Count];
+    u64 sizes[SceneFileSection_Count];
+    sources[SceneFileSection_Primitives]     = scene->primitives;
+    sizes[SceneFileSection_Primitives]       = sizeof(Primitive) * (u64)scene->primitives_count;
+    sources[SceneFileSection_Materials]      = scene->materials;
+    sizes[SceneFileSection_Materials]        = sizeof(Material) * (u64)scene->materials_count;
+    sources[SceneFileSection_Lights]         = scene->lights;
+    sizes[SceneFileSection_Lights]           = sizeof(u32) * (u64)scene->lights_count;
+    sources[SceneFileSection_BvhNodes]       = bvh->nodes;
+    sizes[SceneFileSection_BvhNodes]         = sizeof(BvhNode) * (u64)bvh->nodes_count;
+    sources[SceneFileSection_BvhPrimIndices] = bvh->prim_indices;
+    sizes[SceneFileSection_BvhPrimIndices]   = sizeof(u32) * (u64)bvh->prim_count;
+    sources[SceneFileSection_BvhEndBounds]   = bvh->end_bounds;
+    sizes[SceneFileSection_BvhEndBounds]     = bvh->end_bounds ? sizeof(Aabb) * (u64)bvh->nodes_count : 0;
+    sources[SceneFileSection_BvhWideNodes]   = bvh->wide_nodes;
+    sizes[SceneFileSection_BvhWideNodes]     = wide_node_size * bvh->wide_nodes_count;
+    sources[SceneFileSection_BvhWideDeltas]  = bvh->wide_deltas;
+    sizes[SceneFileSection_BvhWideDeltas]    = bvh->wide_deltas ? wide_delta_size * bvh->wide_nodes_count : 0;
+    sources[SceneFileSection_BvhSpheres]     = bvh->spheres.x;
+    sizes[SceneFileSection_BvhSpheres]       = bvh->spheres.x ? sizeof(r32) * 4 * bvh_spheres_stride(bvh->prim_count) : 0;
+
+    u64 file_size = scene_file_align(sizeof(header));
+    for (u32 i = 0; i < SceneFileSection_Count; ++i)
+    {
+        if (sizes[i] == 0) continue;
+        header.sections[i].offset = file_size;
+        header.sections[i].size   = sizes[i];
+        file_size = scene_file_align(file_size + sizes[i]);
+    }
+
+    // PlatformAlloc returns zeroed pages, so the padding between sections is written as zeros
+    u8 *file = (u8*)PlatformAlloc(file_size);
+    memcpy(file, &header, sizeof(header));
+    for (u32 i = 0; i < SceneFileSection_Count; ++i)
+    {
+        if (sizes[i] > 0) memcpy(file + header.sections[i].offset, sources[i], sizes[i]);
+    }
+
+    PlatformErrorType err = PlatformWriteBufferToFile(file_path, file, file_size);
+    PlatformFree(file);
+
+    return err == PlatformError_Success;
+}
+
+// Checks the header against this build and every section against the file size. The
+// section contents are trusted, reading them here would fault in the whole file.
+file_internal bool
+scene_file_validate(SceneFileHeader *header, u64 file_size)
+{
+    if (file_size < sizeof(SceneFileHeader)) return false;
+
+    bool valid = header->magic == SCENE_FILE_MAGIC
+        && header->version == SCENE_FILE_VERSION
+        && header->primitive_size == sizeof(Primitive)
+        && header->material_size == sizeof(Material)
+        && header->node_size == sizeof(BvhNode)
+        && header->simd_level < SimdLevel_Count;
+    if (!valid) return false;
+
+    u64 wide_node_size, wide_delta_size;
+    scene_file_wide_sizes((SimdLevel)header->simd_level, &wide_node_size, &wide_delta_size);
+
+    u64 expected[SceneFileSection_Count];
+    expected[SceneFileSection_Primitives]     = sizeof(Primitive) * (u64)header->primitives_count;
+    expected[SceneFileSection_Materials]      = sizeof(Material) * (u64)header->materials_count;
+    expected[SceneFileSection_Lights]         = sizeof(u32) * (u64)header->lights_count;
+    expected[SceneFileSection_BvhNodes]       = sizeof(BvhNode) * (u64)header->nodes_count;
+    expected[SceneFileSection_BvhPrimIndices] = sizeof(u32) * (u64)header->primitives_count;
+    expected[SceneFileSection_BvhWideNodes]   = wide_node_size * header->wide_nodes_count;
+    expected[SceneFileSection_BvhSpheres]     = wide_node_size ? sizeof(r32) * 4 * bvh_spheres_stride(header->primitives_count) : 0;
+
+    // Only present for motion trees
+    SceneFileSection *end_bounds = &header->sections[SceneFileSection_BvhEndBounds];
+    expected[SceneFileSection_BvhEndBounds]  = end_bounds->size ? sizeof(Aabb) * (u64)header->nodes_count : 0;
+    expected[SceneFileSection_BvhWideDeltas] = end_bounds->size ? wide_delta_size * header->wide_nodes_count : 0;
+
+    for (u32 i = 0; i < SceneFileSection_Count; ++i)
+    {
+        SceneFileSection *section = &header->sections[i];
+        if (section->size != expected[i]) return false;
+        if (section->size == 0) continue;
+
+        if (section->offset % SCENE_FILE_ALIGNMENT != 0 || section->offset < sizeof(SceneFileHeader)) return false;
+        if (section->offset > file_size || section->size > file_size - section->offset) return false;
+    }
+
+    return true;
+}
+
+FORCE_INLINE void*
+scene_file_section(SceneFile *file, SceneFileSectionType type)
+{
+    SceneFileSection *section = &((SceneFileHeader*)file->mapping.data)->sections[type];
+    return section->size ? file->mapping.data + section->offset : 0;
+}
+
+file_internal bool
+scene_file_load(SceneFile *file, const char *file_path)
+{
+    memset(file, 0, sizeof(SceneFile));
+
+    if (PlatformMapFile(file_path, &file->mapping) != PlatformError_Success)
+    {
+        LogError("Unable to map scene %s", file_path);
+        return false;
+    }
+
+    SceneFileHeader *header = (SceneFileHeader*)file->mapping.data;
+    if (!scene_file_validate(header, file->mapping.size))
+    {
+        LogError("%s is not a version %d scene file for this build", file_path, SCENE_FILE_VERSION);
+        PlatformUnmapFile(&file->mapping);
+        return false;
+    }
+
+    file->camera = header->camera;
+
+    // The caps match the counts, the arrays cannot grow
+    Scene *scene = &file->scene;
+    scene->primitives       = (Primitive*)scene_file_section(file, SceneFileSection_Primitives);
+    scene->primitives_count = header->primitives_count;
+    scene->primitives_cap   = header->primitives_count;
+    scene->materials        = (Material*)scene_file_section(file, SceneFileSection_Materials);
+    scene->materials_count  = header->materials_count;
+    scene->materials_cap    = header->materials_count;
+    scene->material_slots     = 0;
+    scene->material_slots_cap = 0;
+    scene->lights           = (u32*)scene_file_section(file, SceneFileSection_Lights);
+    scene->lights_count     = header->lights_count;
+    scene->sky_scale        = header->sky_scale;
+    scene->bvh              = &file->bvh;
+
+    Bvh *bvh = &file->bvh;
+    bvh->nodes        = (BvhNode*)scene_file_section(file, SceneFileSection_BvhNodes);
+    bvh->prim_indices = (u32*)scene_file_section(file, SceneFileSection_BvhPrimIndices);
+    bvh->nodes_count  = header->nodes_count;
+    bvh->prim_count   = header->primitives_count;
+    bvh->end_bounds   = (Aabb*)scene_file_section(file, SceneFileSection_BvhEndBounds);
+    bvh->time0        = header->time0;
+    bvh->inv_duration = header->inv_duration;
+
+    SimdLevel level = simd_detect_level();
+    if (header->simd_level == (u32)level)
+    {
+        bvh->simd_level       = level;
+        bvh->wide_nodes       = scene_file_section(file, SceneFileSection_BvhWideNodes);
+        bvh->wide_deltas      = scene_file_section(file, SceneFileSection_BvhWideDeltas);
+        bvh->wide_nodes_count = header->wide_nodes_count;
+
+        r32 *spheres = (r32*)scene_file_section(file, SceneFileSection_BvhSpheres);
+        if (spheres)
+        {
+            u64 stride = bvh_spheres_stride(bvh->prim_count);
+            bvh->spheres.x         = spheres;
+            bvh->spheres.y         = spheres + stride;
+            bvh->spheres.z         = spheres + stride * 2;
+            bvh->spheres.radius_sq = spheres + stride * 3;
+        }
+    }
+    else
+    {
+        // Written on a machine with a different vector width, only the wide copy is rebuilt
+        LogWarn("%s was built for %s, rebuilding the wide tree for %s", file_path,
+                simd_level_name((SimdLevel)header->simd_level), simd_level_name(level));
+        bvh_set_simd_level(bvh, scene->primitives, level);
+        file->owns_wide = true;
+    }
+
+    return true;
+}
+
+file_internal void
+scene_file_close(SceneFile *file)
+{
+    if (file->owns_wide) bvh_set_simd_level(&file->bvh, 0, SimdLevel_Scalar);
+    PlatformUnmapFile(&file->mapping);
+    memset(file, 0, sizeof(SceneFile));
+}
+
+//~ JSON
+
+file_internal bool
+scene_json_number(cJSON *object, const char *name, r32 *result)
+{
+    cJSON *item = cJSON_GetObjectItemCaseSensitive(object, name);
+    if (!item) return true;
+    if (!cJSON_IsNumber(item)) return false;
+    *result = (r32)item->valuedouble;
+    return true;
+}
+
+file_internal bool
+scene_json_v3(cJSON *object, const char *name, v3 *result)
+{
+    cJSON *item = cJSON_GetObjectItemCaseSensitive(object, name);
+    if (!item) return true;
+    if (!cJSON_IsArray(item) || cJSON_GetArraySize(item) != 3) return false;
+
+    r32 values[3];
+    u32 i = 0;
+    cJSON *value;
+    cJSON_ArrayForEach(value, item)
+    {
+        if (!cJSON_IsNumber(value)) return false;
+        values[i++] = (r32)value->valuedouble;
+    }
+    *result = { values[0], values[1], values[2] };
+    return true;
+}
+
+file_internal bool
+scene_json_material(cJSON *object, Material *material)
+{
+    cJSON *type = cJSON_GetObjectItemCaseSensitive(object, "type");
+    if (!cJSON_IsString(type)) return false;
+
+    v3  color = { 0.5f, 0.5f, 0.5f };
+    r32 fuzz  = 0.0f;
+    r32 ior   = 1.5f;
+
+    if (strcmp(type->valuestring, "lambertian") == 0)
+    {
+        if (!scene_json_v3(object, "albedo", &color)) return false;
+        make_lambertian(material, color);
+    }
+    else if (strcmp(type->valuestring, "metal") == 0)
+    {
+        if (!scene_json_v3(object, "albedo", &color) || !scene_json_number(object, "fuzz", &fuzz)) return false;
+        make_metal(material, color, fuzz);
+    }
+    else if (strcmp(type->valuestring, "dielectric") == 0)
+    {
+        if (!scene_json_number(object, "ior", &ior)) return false;
+        make_dielectric(material, ior);
+    }
+    else if (strcmp(type->valuestring, "emissive") == 0)
+    {
+        color = V3_ONE;
+        if (!scene_json_v3(object, "radiance", &color)) return false;
+        make_emissive(material, color);
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// material_ids maps the JSON material index to the deduplicated scene material
+file_internal bool
+scene_json_primitive(cJSON *object, Primitive *primitive, u32 *material_ids, u32 materials_count)
+{
+    cJSON *type     = cJSON_GetObjectItemCaseSensitive(object, "type");
+    cJSON *material = cJSON_GetObjectItemCaseSensitive(object, "material");
+    if (!cJSON_IsString(type) || !cJSON_IsNumber(material)) return false;
+    if (material->valueint < 0 || (u32)material->valueint >= materials_count) return false;
+
+    u32 material_id = material_ids[material->valueint];
+    r32 radius = 1.0f;
+    if (!scene_json_number(object, "radius", &radius)) return false;
+
+    if (strcmp(type->valuestring, "sphere") == 0)
+    {
+        v3 center = V3_ZERO;
+        if (!scene_json_v3(object, "center", &center)) return false;
+        make_sphere(primitive, center, radius, material_id);
+    }
+    else if (strcmp(type->valuestring, "dynamic_sphere") == 0)
+    {
+        v3  center0 = V3_ZERO, center1 = V3_ZERO;
+        r32 time0 = 0.0f, time1 = 1.0f;
+        bool ok = scene_json_v3(object, "center0", &center0)
+            && scene_json_v3(object, "center1", &center1)
+            && scene_json_number(object, "time0", &time0)
+            && scene_json_number(object, "time1", &time1)
+            && time1 > time0;
+        if (!ok) return false;
+        make_dynamic_sphere(primitive, center0, center1, time0, time1, radius, material_id);
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+file_internal bool
+scene_json_camera(cJSON *object, CameraCreateInfo *camera)
+{
+    return scene_json_v3(object, "look_from", &camera->look_from)
+        && scene_json_v3(object, "look_at", &camera->look_at)
+        && scene_json_v3(object, "up", &camera->up)
+        && scene_json_number(object, "vfov", &camera->vfov)
+        && scene_json_number(object, "aperture", &camera->aperture)
+        && scene_json_number(object, "focus_dist", &camera->focus_dist)
+        && scene_json_number(object, "time0", &camera->t0)
+        && scene_json_number(object, "time1", &camera->t1);
+}
+
+file_internal bool
+scene_load_json(Scene *scene, CameraCreateInfo *camera, const char *file_path)
+{
+    camera->look_from    = { 13, 2, 3 };
+    camera->look_at      = V3_ZERO;
+    camera->up           = { 0, 1, 0 };
+    camera->vfov         = 20;
+    camera->aspect_ratio = 16.0f / 9.0f;
+    camera->aperture     = 0.1f;
+    camera->focus_dist   = 10.0f;
+    camera->t0           = 0.0f;
+    camera->t1           = 1.0f;
+
+    u8 *buffer;
+    u32 size;
+    if (PlatformReadFileToBuffer(file_path, &buffer, &size) != PlatformError_Success)
+    {
+        LogError("Unable to read scene %s", file_path);
+        return false;
+    }
+
+    cJSON *root = cJSON_ParseWithLength((const char*)buffer, size);
+    MemFree(buffer);
+    if (!root)
+    {
+        LogError("Unable to parse scene %s near: %.32s", file_path, cJSON_GetErrorPtr());
+        return false;
+    }
+
+    bool result = false;
+    u32 *material_ids = 0;
+
+    cJSON *camera_json = cJSON_GetObjectItemCaseSensitive(root, "camera");
+    cJSON *materials   = cJSON_GetObjectItemCaseSensitive(root, "materials");
+    cJSON *primitives  = cJSON_GetObjectItemCaseSensitive(root, "primitives");
+    if (!cJSON_IsArray(materials) || !cJSON_IsArray(primitives))
+    {
+        LogError("%s needs a materials and a primitives array", file_path);
+        goto done;
+    }
+    if (camera_json && !scene_json_camera(camera_json, camera))
+    {
+        LogError("%s has an invalid camera", file_path);
+        goto done;
+    }
+    if (!scene_json_number(root, "sky_scale", &scene->sky_scale))
+    {
+        LogError("%s has an invalid sky_scale", file_path);
+        goto done;
+    }
+
+    {
+        u32 materials_count = (u32)cJSON_GetArraySize(materials);
+        material_ids = (u32*)malloc(sizeof(u32) * (materials_count + 1));
+
+        u32 index = 0;
+        cJSON *item;
+        cJSON_ArrayForEach(item, materials)
+        {
+            Material material;
+            if (!scene_json_material(item, &material))
+            {
+                LogError("%s: invalid material %d", file_path, index);
+                goto done;
+            }
+            material_ids[index++] = scene_add_material(scene, &material);
+        }
+
+        index = 0;
+        cJSON_ArrayForEach(item, primitives)
+        {
+            Primitive primitive;
+            if (!scene_json_primitive(item, &primitive, material_ids, materials_count))
+            {
+                LogError("%s: invalid primitive %d", file_path, index);
+                goto done;
+            }
+            scene_add(scene, &primitive);
+            ++index;
+        }
+    }
+
+    result = true;
+
+done:
+    free(material_ids);
+    cJSON_Delete(root);
+    return result;
+}
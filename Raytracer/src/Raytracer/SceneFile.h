@@ -0,0 +1,83 @@
+#ifndef _RAYTRACER_SCENE_FILE_H
+#define _RAYTRACER_SCENE_FILE_H
+
+// Binary scene file (.rts). Every section is the in-memory array it replaces, aligned so
+// the SIMD kernels can load straight from the mapping: loading maps the file and points
+// the Scene and Bvh at it, nothing is parsed, copied or rebuilt. The struct sizes are
+// checked on load, a file only loads into a build with the same layouts (and endianness).
+//
+// Scenes are authored as JSON (scene_load_json), built once and written out with
+// scene_file_write. Mesh instances hold pointers and cannot be stored.
+
+constexpr u32 SCENE_FILE_MAGIC     = 0x53435452; // "RTCS"
+constexpr u32 SCENE_FILE_VERSION   = 1;
+constexpr u64 SCENE_FILE_ALIGNMENT = 64;         // section alignment, a cache line
+
+enum SceneFileSectionType
+{
+    SceneFileSection_Primitives,
+    SceneFileSection_Materials,
+    SceneFileSection_Lights,
+    SceneFileSection_BvhNodes,
+    SceneFileSection_BvhPrimIndices,
+    SceneFileSection_BvhEndBounds,   // motion trees only
+    SceneFileSection_BvhWideNodes,   // Bvh4Node or Bvh8Node, see SceneFileHeader::simd_level
+    SceneFileSection_BvhWideDeltas,  // motion trees only
+    SceneFileSection_BvhSpheres,     // the x, y, z, radius_sq arrays as one block
+
+    SceneFileSection_Count,
+};
+
+struct SceneFileSection
+{
+    u64 offset; // from the start of the file, 0 for an empty section
+    u64 size;
+};
+
+struct SceneFileHeader
+{
+    u32 magic;
+    u32 version;
+    u32 primitive_size;
+    u32 material_size;
+    u32 node_size;
+
+    u32 primitives_count;
+    u32 materials_count;
+    u32 lights_count;
+    u32 nodes_count;
+    u32 wide_nodes_count;
+    u32 simd_level;    // level the wide sections were built for
+    r32 sky_scale;
+    r32 time0;         // shutter the motion tree was built over
+    r32 inv_duration;
+
+    CameraCreateInfo camera;
+
+    SceneFileSection sections[SceneFileSection_Count];
+};
+
+struct SceneFile
+{
+    PlatformFileMapping mapping;
+
+    // Views into the mapping, read only. Do not scene_add, scene_free or bvh_free them.
+    Scene               scene;
+    Bvh                 bvh;
+    CameraCreateInfo    camera;
+
+    // Set when the CPU does not support the stored SIMD level and the wide tree was rebuilt
+    b8                  owns_wide;
+};
+
+// Writes the scene, its lights and the tree built over it. Call scene_build_lights first.
+file_internal bool scene_file_write(const char *file_path, Scene *scene, Bvh *bvh, CameraCreateInfo *camera);
+// The returned scene's bvh points at file->bvh
+file_internal bool scene_file_load(SceneFile *file, const char *file_path);
+file_internal void scene_file_close(SceneFile *file);
+
+// Fills an initialized scene from a JSON description, the camera's fields default to the
+// values of the built in scenes. See the README for the format.
+file_internal bool scene_load_json(Scene *scene, CameraCreateInfo *camera, const char *file_path);
+
+#endif //_RAYTRACER_SCENE_FILE_H
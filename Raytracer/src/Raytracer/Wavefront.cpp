@@ -0,0 +1,308 @@
+
+// Buffers of the tiles this thread traces, kept for the life of the thread
+file_global thread_local Wavefront tls_wavefront = {};
+
+file_internal void
+ray_queue_carve(RayQueue *queue, r32 **cursor, u32 capacity)
+{
+    r32 **fields[] = {
+        &queue->orig_x, &queue->orig_y, &queue->orig_z,
+        &queue->dir_x,  &queue->dir_y,  &queue->dir_z,
+        &queue->time,
+        &queue->throughput_r, &queue->throughput_g, &queue->throughput_b,
+    };
+
+    for (u32 i = 0; i < ARRAYCOUNT(fields); ++i)
+    {
+        *fields[i] = *cursor;
+        *cursor += capacity;
+    }
+
+    u32 **streams[] = { &queue->path, &queue->rng_key, &queue->rng_counter };
+    for (u32 i = 0; i < ARRAYCOUNT(streams); ++i)
+    {
+        *streams[i] = (u32*)*cursor;
+        *cursor += capacity;
+    }
+    queue->count = 0;
+}
+
+// A tile's pass is often far below a full batch, the buffers are sized to the paths and
+// only grow when a later call needs more
+file_internal void
+wavefront_init(Wavefront *wavefront, u32 capacity)
+{
+    // 13 four byte streams per queue, the hit records, the path radiance and three index
+    // arrays. The hit records go first, they are the only ones that hold pointers.
+    u64 queue_size    = sizeof(r32) * 13 * capacity;
+    u64 hits_size     = sizeof(HitRecord) * capacity;
+    u64 radiance_size = sizeof(v3) * capacity;
+    u64 index_size    = sizeof(u32) * capacity;
+
+    wavefront->backing  = PlatformAlloc(hits_size + 2 * queue_size + radiance_size + 3 * index_size);
+    wavefront->capacity = capacity;
+
+    wavefront->hits = (HitRecord*)wavefront->backing;
+
+    r32 *cursor = (r32*)(wavefront->hits + capacity);
+    ray_queue_carve(&wavefront->queues[0], &cursor, capacity);
+    ray_queue_carve(&wavefront->queues[1], &cursor, capacity);
+
+    wavefront->radiance = (v3*)cursor;
+    wavefront->hit_ray  = (u32*)(wavefront->radiance + capacity);
+    wavefront->sorted   = wavefront->hit_ray + capacity;
+    wavefront->pixel    = wavefront->sorted + capacity;
+    wavefront->hit_count = 0;
+}
+
+file_internal void
+wavefront_free(Wavefront *wavefront)
+{
+    PlatformFree(wavefront->backing);
+    wavefront->backing = 0;
+}
+
+FORCE_INLINE void
+ray_queue_load(RayQueue *queue, u32 idx, Ray *ray)
+{
+    ray->orig = { queue->orig_x[idx], queue->orig_y[idx], queue->orig_z[idx] };
+    ray->dir  = { queue->dir_x[idx],  queue->dir_y[idx],  queue->dir_z[idx]  };
+    ray->time = queue->time[idx];
+}
+
+FORCE_INLINE void
+ray_queue_push(RayQueue *queue, Ray *ray, v3 throughput, u32 path, Rng *rng)
+{
+    u32 idx = queue->count++;
+    queue->orig_x[idx] = ray->orig.x;
+    queue->orig_y[idx] = ray->orig.y;
+    queue->orig_z[idx] = ray->orig.z;
+    queue->dir_x[idx]  = ray->dir.x;
+    queue->dir_y[idx]  = ray->dir.y;
+    queue->dir_z[idx]  = ray->dir.z;
+    queue->time[idx]   = ray->time;
+    queue->throughput_r[idx] = throughput.r;
+    queue->throughput_g[idx] = throughput.g;
+    queue->throughput_b[idx] = throughput.b;
+    queue->path[idx]   = path;
+    queue->rng_key[idx]     = rng->key;
+    queue->rng_counter[idx] = rng->counter;
+}
+
+// Intersects every ray in the queue. Misses deposit the sky color straight into the
+// path's radiance, hits are kept and counted per material for the sort. Emitters
+// deposit their radiance here as well; the wavefront path has no next event estimation,
+// so they are only found by BSDF sampling and count in full.
+file_internal void
+wavefront_intersect(Wavefront *wavefront, RayQueue *queue, Scene *scene, u32 *material_counts)
+{
+    wavefront->hit_count = 0;
+    for (u32 r = 0; r < queue->count; ++r)
+    {
+        Ray ray;
+        ray_queue_load(queue, r, &ray);
+
+        v3 throughput = { queue->throughput_r[r], queue->throughput_g[r], queue->throughput_b[r] };
+        v3 *radiance = &wavefront->radiance[queue->path[r]];
+
+        HitRecord *record = &wavefront->hits[wavefront->hit_count];
+        if (intersect_ray_scene(record, &ray, scene, 0.001f, R32_MAX))
+        {
+            wavefront->hit_ray[wavefront->hit_count++] = r;
+            material_counts[record->material->type]++;
+
+            if (record->material->type == Material_Emissive)
+            {
+                *radiance = v3_add(*radiance, v3_mul(material_emitted(record), throughput));
+            }
+        }
+        else
+        {
+            v3 sky = v3_mulf(ray_sky_color(ray.dir), scene->sky_scale);
+            *radiance = v3_add(*radiance, v3_mul(sky, throughput));
+        }
+    }
+}
+
+// Counting sort of the hits by material so every shading kernel runs over one range
+file_internal void
+wavefront_sort_hits(Wavefront *wavefront, u32 *material_counts, u32 *material_offsets)
+{
+    u32 offset = 0;
+    for (u32 m = 0; m < Material_Count; ++m)
+    {
+        material_offsets[m] = offset;
+        offset += material_counts[m];
+    }
+
+    u32 cursor[Material_Count];
+    memcpy(cursor, material_offsets, sizeof(cursor));
+
+    for (u32 h = 0; h < wavefront->hit_count; ++h)
+    {
+        wavefront->sorted[cursor[wavefront->hits[h].material->type]++] = h;
+    }
+}
+
+template<material_scatter_pfn Scatter> file_internal void
+wavefront_shade(Wavefront *wavefront, RayQueue *in, RayQueue *out, u32 begin, u32 end)
+{
+    for (u32 s = begin; s < end; ++s)
+    {
+        u32 h = wavefront->sorted[s];
+        u32 r = wavefront->hit_ray[h];
+
+        Ray ray;
+        ray_queue_load(in, r, &ray);
+
+        Rng rng;
+        rng.key     = in->rng_key[r];
+        rng.counter = in->rng_counter[r];
+
+        Ray scattered;
+        v3 attenuation;
+        if (Scatter(&wavefront->hits[h], &ray, &scattered, &attenuation, &rng))
+        {
+            v3 throughput = { in->throughput_r[r], in->throughput_g[r], in->throughput_b[r] };
+            ray_queue_push(out, &scattered, v3_mul(throughput, attenuation), in->path[r], &rng);
+        }
+    }
+}
+
+file_internal void
+wavefront_trace_rect(RaytracerSettings *settings, u32 x0, u32 y0, u32 x1, u32 y1,
+                     u32 first_sample, u32 end_sample,
+                     v3 *accum, r32 *lum_sum, r32 *lum_sq_sum, u32 pitch)
+{
+    Camera *camera = settings->camera;
+    Scene  *scene  = settings->scene;
+
+    u32 cols    = x1 - x0;
+    u32 samples = end_sample - first_sample;
+    u64 path_count = (u64)cols * (y1 - y0) * samples;
+    if (path_count == 0) return;
+
+    // Each worker keeps its buffers for every tile and pass it traces, they only grow
+    u32 capacity = (path_count < WAVEFRONT_BATCH_SIZE) ? (u32)path_count : WAVEFRONT_BATCH_SIZE;
+    Wavefront *wavefront = &tls_wavefront;
+    if (wavefront->capacity < capacity)
+    {
+        if (wavefront->backing) wavefront_free(wavefront);
+        wavefront_init(wavefront, capacity);
+    }
+
+    // Paths are numbered pixel major, path / samples gives the rect pixel
+    u64 next_path = 0;
+
+    while (next_path < path_count)
+    {
+        RayQueue *in  = &wavefront->queues[0];
+        RayQueue *out = &wavefront->queues[1];
+
+        //~ Generate camera rays
+
+        in->count = 0;
+        while (in->count < wavefront->capacity && next_path < path_count)
+        {
+            u32 pixel = (u32)(next_path / samples);
+            u32 x = x0 + pixel % cols;
+            u32 y = y0 + pixel / cols;
+            i32 i = (i32)x;
+            i32 j = (i32)settings->height - 1 - (i32)y;
+
+            Rng rng;
+            rt_pixel_rng(&rng, settings, i, j, first_sample + (u32)(next_path % samples));
+
+            r32 u = (r32)(i + rng_next(&rng)) / (r32)(settings->width - 1);
+            r32 v = (r32)(j + rng_next(&rng)) / (r32)(settings->height - 1);
+
+            Ray ray{};
+            camera_get_ray(&ray, camera, u, v, &rng);
+
+            u32 path = in->count;
+            wavefront->radiance[path] = V3_ZERO;
+            wavefront->pixel[path]    = (y - y0) * pitch + (x - x0);
+            ray_queue_push(in, &ray, V3_ONE, path, &rng);
+            ++next_path;
+        }
+        u32 batch_count = in->count;
+
+        //~ Advance every path one bounce at a time
+
+        for (u32 bounce = 0; bounce < settings->depth && in->count > 0; ++bounce)
+        {
+            u32 material_counts[Material_Count] = {};
+            u32 material_offsets[Material_Count];
+
+            wavefront_intersect(wavefront, in, scene, material_counts);
+            wavefront_sort_hits(wavefront, material_counts, material_offsets);
+
+            out->count = 0;
+            for (u32 m = 0; m < Material_Count; ++m)
+            {
+                u32 begin = material_offsets[m];
+                u32 end   = begin + material_counts[m];
+                if (begin == end) continue;
+
+                switch ((MaterialType)m)
+                {
+                    case Material_Lambertian: wavefront_shade<material_scatter_lambertian>(wavefront, in, out, begin, end); break;
+                    case Material_Metal:      wavefront_shade<material_scatter_metal>(wavefront, in, out, begin, end);      break;
+                    case Material_Dielectric: wavefront_shade<material_scatter_dielectric>(wavefront, in, out, begin, end); break;
+                    default: break; // emitters absorb, their paths end here
+                }
+            }
+
+            RayQueue *tmp = in;
+            in  = out;
+            out = tmp;
+        }
+
+        // Paths still alive after the last bounce contribute nothing, as in ray_color
+
+        //~ Add the finished paths to their pixels, a pixel's samples are in slot order
+
+        for (u32 path = 0; path < batch_count; ++path)
+        {
+            u32 p = wavefront->pixel[path];
+            v3 sample = wavefront->radiance[path];
+            accum[p] = v3_add(accum[p], sample);
+
+            if (lum_sum)
+            {
+                r32 l = rt_luminance(sample);
+                lum_sum[p]    += l;
+                lum_sq_sum[p] += l * l;
+            }
+        }
+    }
+
+}
+
+file_internal void
+wavefront_render_region(RaytracerSettings *settings, i32 start_i, i32 stop_i, i32 start_j, i32 stop_j)
+{
+    u32 cols = (u32)(stop_i - start_i);
+    u32 rows = (u32)(start_j - stop_j + 1);
+    if (cols == 0 || rows == 0 || settings->samples == 0) return;
+
+    v3 *accum = (v3*)PlatformAlloc(sizeof(v3) * cols * rows);
+    memset(accum, 0, sizeof(v3) * cols * rows);
+
+    u32 y0 = settings->height - 1 - (u32)start_j;
+    wavefront_trace_rect(settings, (u32)start_i, y0, (u32)stop_i, y0 + rows,
+                         0, settings->samples, accum, 0, 0, cols);
+
+    //~ Resolve into the image
+
+    for (u32 p = 0; p < cols * rows; ++p)
+    {
+        i32 i = start_i + (i32)(p % cols);
+        i32 j = start_j - (i32)(p / cols);
+        i32 real_row = settings->height - 1 - j;
+
+        rt_store_pixel(settings->image, ((real_row * settings->width) + i) * 3, accum[p], settings->samples);
+    }
+
+    PlatformFree(accum);
+}
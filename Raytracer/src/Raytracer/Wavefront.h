@@ -0,0 +1,58 @@
+#ifndef _RAYTRACER_WAVEFRONT_H
+#define _RAYTRACER_WAVEFRONT_H
+
+// Breadth-first path tracing. Instead of recursing through ray_color per sample, a batch
+// of camera paths is advanced one bounce at a time: every ray in the queue is intersected,
+// the hits are sorted by material, and each material runs its scatter kernel over one
+// contiguous range, writing the surviving paths into the next bounce's queue.
+//
+// There is no next event estimation, emitters are only found by BSDF sampling, and no
+// first hit AOVs are recorded. The progressive tiles fall back to ray_color when the
+// denoiser or the AOV outputs need them.
+
+constexpr u32 WAVEFRONT_BATCH_SIZE = 1 << 14; // paths in flight per batch
+
+// SoA queue of the paths alive at the current bounce
+struct RayQueue
+{
+    r32 *orig_x, *orig_y, *orig_z;
+    r32 *dir_x,  *dir_y,  *dir_z;
+    r32 *time;
+    r32 *throughput_r, *throughput_g, *throughput_b;
+    u32 *path;  // batch slot of the path, indexes Wavefront::radiance
+    u32 *rng_key, *rng_counter; // each path carries its own generator
+    u32  count;
+};
+
+struct Wavefront
+{
+    RayQueue   queues[2]; // current and next bounce, swapped every bounce
+    HitRecord *hits;      // closest hits of the current bounce, in queue order
+    u32       *hit_ray;   // queue index of the ray that produced hits[i]
+    u32       *sorted;    // hit indices sorted by material type
+    u32        hit_count;
+
+    v3        *radiance;  // per batch slot, what the path gathered so far
+    u32       *pixel;     // per batch slot, the rect pixel the path belongs to
+    u32        capacity;  // paths per batch, at most WAVEFRONT_BATCH_SIZE
+
+    void      *backing;
+};
+
+// Traces the samples [first_sample, end_sample) of every pixel in the rect [x0, x1) x
+// [y0, y1) (image rows, top down) and adds them to accum. lum_sum and lum_sq_sum are
+// optional and get the sum of each sample's luminance and of its square. The buffers point
+// at the rect's first pixel and their rows are pitch pixels apart. Samples are added in
+// order, so the sums match tracing them one pixel at a time.
+file_internal void wavefront_trace_rect(RaytracerSettings *settings,
+                                        u32 x0, u32 y0, u32 x1, u32 y1,
+                                        u32 first_sample, u32 end_sample,
+                                        v3 *accum, r32 *lum_sum, r32 *lum_sq_sum, u32 pitch);
+
+// Renders the rows [stop_j, start_j] (top down) and columns [start_i, stop_i) of the
+// image, matching the regions walked by rt_entry and rt_async.
+file_internal void wavefront_render_region(RaytracerSettings *settings,
+                                           i32 start_i, i32 stop_i,
+                                           i32 start_j, i32 stop_j);
+
+#endif //_RAYTRACER_WAVEFRONT_H
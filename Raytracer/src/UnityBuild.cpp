@@ -40,38 +40,69 @@
 #include "Platform/HostWindow.h"
 #include "Platform/PrettyBuffer.h"
 #include "Platform/UniformBuffer.h"
+#include "Platform/JobProfiler.h"
+#if defined(_WIN32)
 #include "Platform/FileManager.h"
+#endif
 //#include "Platform/ControlBindings.h"
 
 #include "Core/SysMemory.c"
 #include "Platform/PrettyBuffer.c"
 #include "Platform/UniformBuffer.c"
+#include "Platform/JobProfiler.c"
 
+#include "cjson/cJSON.h"
+#include "cjson/cJSON.c"
+
+#if defined(_WIN32)
 #include "Renderer/ShaderCommon.h"
 #include "Renderer/DX11/DX11Common.h"
 #include "Renderer/DX11/DX11Texture.h"
 #include "Renderer/DX11/DX11RenderTarget.h"
 /* DX11Renderer.c defined in Platform.c */
 #include "Renderer/DX11/DX11Renderer.h"
+#endif
 
 // RAYTRACER
 
 #include "Raytracer/Material.h"
 #include "Raytracer/Intersection.h"
 #include "Raytracer/Primitive.h"
+#include "Raytracer/BvhSimd.h"
+#include "Raytracer/Bvh.h"
+#include "Raytracer/Mesh.h"
 #include "Raytracer/Ray.h"
 #include "Raytracer/Scene.h"
+#include "Raytracer/Light.h"
 #include "Raytracer/Camera.h"
+#include "Raytracer/SceneFile.h"
 #include "Raytracer/Raytracer.h"
+#include "Raytracer/Wavefront.h"
+#include "Raytracer/Denoise.h"
+#include "Raytracer/Progressive.h"
+#include "Raytracer/Interactive.h"
+#include "Raytracer/ImageWriter.h"
+#if defined(_WIN32)
 #include "Raytracer/RaytracerRenderer.h"
+#endif
 
 #include "Raytracer/Material.cpp"
 #include "Raytracer/Primitive.cpp"
+#include "Raytracer/Bvh.cpp"
+#include "Raytracer/BvhSimd.cpp"
 #include "Raytracer/Ray.cpp"
 #include "Raytracer/Intersection.cpp"
+#include "Raytracer/Mesh.cpp"
 #include "Raytracer/Scene.cpp"
+#include "Raytracer/Light.cpp"
 #include "Raytracer/Camera.cpp"
+#include "Raytracer/SceneFile.cpp"
 #include "Raytracer/Raytracer.cpp"
+#include "Raytracer/Wavefront.cpp"
+#include "Raytracer/Denoise.cpp"
+#include "Raytracer/Progressive.cpp"
+#include "Raytracer/Interactive.cpp"
+#include "Raytracer/ImageWriter.cpp"
 
 // Platform Source
 
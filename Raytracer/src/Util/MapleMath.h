@@ -85,6 +85,12 @@ typedef Mat3       m3;
 typedef Mat4       m4;
 typedef Quaternion qt;
 
+typedef struct
+{
+    u32 key;
+    u32 counter;
+} Rng;
+
 #define V2_ZERO { 0.0f, 0.0f }
 #define V3_ZERO { 0.0f, 0.0f, 0.0f}
 #define V4_ZERO { 0.0f, 0.0f, 0.0f, 0.0f }
@@ -185,15 +191,22 @@ r32 clamp(r32 min, r32 max, r32 val);
 r32 smoothstep(r32 v0, r32 v1, r32 t);
 r32 smootherstep(r32 v0, r32 v1, r32 t);
 
-static r32 random();
-static r32 random_clamped(r32 Min, r32 Max);
-static i32 random_int_clamped(i32 Min, i32 Max);
-static v3 v3_random();
-static v3 v3_random_clamped(r32 Min, r32 Max);
-static v3 random_in_unit_sphere();
-static v3 random_in_hemisphere(v3 Normal);
-static v3 random_unit_vector();
-static v3 random_in_unit_disc();
+// Random numbers. Rng is counter based: every draw hashes (key, counter), so a generator
+// is two integers with no shared state and any stream (e.g. a pixel and sample index) can
+// be seeded directly. The same seed and stream always produce the same sequence.
+static u32 rng_hash(u32 x);
+static void rng_seed(Rng *rng, u32 seed, u32 stream, u32 substream = 0);
+static u32 rng_next_u32(Rng *rng);
+static r32 rng_next(Rng *rng); // [0, 1)
+static void rng_fill8(Rng *rng, r32 out[8]);
+static r32 rng_clamped(Rng *rng, r32 Min, r32 Max);
+static i32 rng_int_clamped(Rng *rng, i32 Min, i32 Max);
+static v3 rng_v3(Rng *rng);
+static v3 rng_v3_clamped(Rng *rng, r32 Min, r32 Max);
+static v3 rng_in_unit_sphere(Rng *rng);
+static v3 rng_in_hemisphere(Rng *rng, v3 Normal);
+static v3 rng_unit_vector(Rng *rng);
+static v3 rng_in_unit_disc(Rng *rng);
 static r32 schlick(r32 cosine, r32 ref_idx);
 static v3 refract(v3 uv, v3 n, r32 ratio);
 static v3 reflect(v3 v, v3 normal);
@@ -1054,57 +1067,92 @@ v3 v3_compute_normal(v3 a, v3 b, v3 c)
     return v3_norm(v3_cross(ba, ca));
 }
 
-static r32 random()
+static u32 rng_hash(u32 x)
+{
+    // Integer finalizer with constant shifts only, so it maps directly onto SIMD lanes
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static void rng_seed(Rng *rng, u32 seed, u32 stream, u32 substream)
+{
+    rng->key     = rng_hash(rng_hash(rng_hash(seed) ^ stream) ^ substream);
+    rng->counter = 0;
+}
+
+static u32 rng_next_u32(Rng *rng)
 {
-    return rand() / (RAND_MAX + 1.0f);
+    return rng_hash(rng_hash(rng->counter++) ^ rng->key);
+}
+
+static r32 rng_next(Rng *rng)
+{
+    // Top 24 bits give every representable float in [0, 1) at 2^-24 spacing
+    return (r32)(rng_next_u32(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+static void rng_fill8(Rng *rng, r32 out[8])
+{
+    // Lanes only depend on their own counter, so this loop vectorizes to 8-wide integer ops
+    u32 base = rng->counter;
+    for (u32 i = 0; i < 8; ++i)
+    {
+        u32 x = rng_hash(rng_hash(base + i) ^ rng->key);
+        out[i] = (r32)(x >> 8) * (1.0f / 16777216.0f);
+    }
+    rng->counter = base + 8;
 }
 
-static r32 random_clamped(r32 Min, r32 Max)
+static r32 rng_clamped(Rng *rng, r32 Min, r32 Max)
 {
-    return Min + (Max - Min) * random();
+    return Min + (Max - Min) * rng_next(rng);
 }
 
-static i32 random_int_clamped(i32 Min, i32 Max)
+static i32 rng_int_clamped(Rng *rng, i32 Min, i32 Max)
 {
-    i32 Rand = rand();
-    return Min + Rand % (Max - Min);
+    u32 Rand = rng_next_u32(rng);
+    return Min + (i32)(Rand % (u32)(Max - Min));
 }
 
-static v3 v3_random()
+static v3 rng_v3(Rng *rng)
 {
     v3 Result;
     
-    Result.x = random();
-    Result.y = random();
-    Result.z = random();
+    Result.x = rng_next(rng);
+    Result.y = rng_next(rng);
+    Result.z = rng_next(rng);
     
     return Result;
 }
 
-static v3 v3_random_clamped(r32 Min, r32 Max)
+static v3 rng_v3_clamped(Rng *rng, r32 Min, r32 Max)
 {
     v3 Result;
     
-    Result.x = random_clamped(Min, Max);
-    Result.y = random_clamped(Min, Max);
-    Result.z = random_clamped(Min, Max);
+    Result.x = rng_clamped(rng, Min, Max);
+    Result.y = rng_clamped(rng, Min, Max);
+    Result.z = rng_clamped(rng, Min, Max);
     
     return Result;
 }
 
-static v3 random_in_unit_sphere()
+static v3 rng_in_unit_sphere(Rng *rng)
 {
     while (true)
     {
-        v3 Ran = v3_random_clamped(-1.0f, 1.0f);
+        v3 Ran = rng_v3_clamped(rng, -1.0f, 1.0f);
         if (v3_mag_sq(Ran) >= 1.0f) continue;
         return Ran;
     }
 }
 
-static v3 random_in_hemisphere(v3 Normal)
+static v3 rng_in_hemisphere(Rng *rng, v3 Normal)
 {
-    v3 RandomInSphere = random_in_unit_sphere();
+    v3 RandomInSphere = rng_in_unit_sphere(rng);
     if (v3_dot(RandomInSphere, Normal) > 0.0f)
     {
         return RandomInSphere;
@@ -1115,19 +1163,19 @@ static v3 random_in_hemisphere(v3 Normal)
     }
 }
 
-static v3 random_unit_vector()
+static v3 rng_unit_vector(Rng *rng)
 {
-    r32 A = random_clamped(0, 2 * MM_PI);
-    r32 Z = random_clamped(-1, 1);
+    r32 A = rng_clamped(rng, 0, 2 * MM_PI);
+    r32 Z = rng_clamped(rng, -1, 1);
     r32 R = sqrtf(1 - Z * Z);
     return { R * cosf(A), R * sinf(A), Z };
 }
 
-static v3 random_in_unit_disc()
+static v3 rng_in_unit_disc(Rng *rng)
 {
     while (true)
     {
-        v3 Ran = { random_clamped(-1, 1), random_clamped(-1, 1), 0};
+        v3 Ran = { rng_clamped(rng, -1, 1), rng_clamped(rng, -1, 1), 0};
         if (v3_mag_sq(Ran) >= 1.0f) continue;
         return Ran;
     }